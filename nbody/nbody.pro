@@ -19,15 +19,24 @@ SOURCES	+= \
 	nbody_engine.cpp \
 	nbody_engine_ah.cpp \
 	nbody_engine_block.cpp \
+	nbody_engine_fmm.cpp \
 	nbody_engine_openmp.cpp \
+	nbody_engine_simd.cpp \
 	nbody_engine_simple.cpp \
 	nbody_engine_simple_bh.cpp \
+	nbody_engine_tiled.cpp \
 	nbody_engines.cpp \
 	nbody_extrapolator.cpp \
+	nbody_force_law.cpp \
 	nbody_solver.cpp \
+	nbody_solver_abm.cpp \
 	nbody_solver_adams.cpp \
+	nbody_solver_block_step.cpp \
 	nbody_solver_bulirsch_stoer.cpp \
 	nbody_solver_euler.cpp \
+	nbody_solver_forest_ruth.cpp \
+	nbody_solver_hermite.cpp \
+	nbody_solver_leapfrog.cpp \
 	nbody_solver_midpoint.cpp \
 	nbody_solver_midpoint_stetter.cpp \
 	nbody_solver_rk_butcher.cpp \
@@ -41,11 +50,16 @@ SOURCES	+= \
 	nbody_solver_rkfeagin14.cpp \
 	nbody_solver_rkgl.cpp \
 	nbody_solver_rklc.cpp \
-	nbody_solver_stormer.cpp \
+	nbody_solver_rkn4.cpp \
+	nbody_solver_rkn64.cpp \
+	nbody_solver_symplectic.cpp \
 	nbody_solver_trapeze.cpp \
+	nbody_solver_wisdom_holman.cpp \
+	nbody_solver_yoshida.cpp \
 	nbody_solvers.cpp \
 	nbody_space_heap.cpp \
 	nbody_space_heap_stackless.cpp \
+	nbody_space_order.cpp \
 	nbody_space_tree.cpp \
 	nbody_data_stream.cpp \
 	nbody_data_stream_reader.cpp
@@ -60,15 +74,24 @@ HEADERS	+= \
 	nbody_engine.h \
 	nbody_engine_ah.h \
 	nbody_engine_block.h \
+	nbody_engine_fmm.h \
 	nbody_engine_openmp.h \
+	nbody_engine_simd.h \
 	nbody_engine_simple.h \
 	nbody_engine_simple_bh.h \
+	nbody_engine_tiled.h \
 	nbody_engines.h \
 	nbody_extrapolator.h \
+	nbody_force_law.h \
 	nbody_solver.h \
+	nbody_solver_abm.h \
 	nbody_solver_adams.h \
+	nbody_solver_block_step.h \
 	nbody_solver_bulirsch_stoer.h \
 	nbody_solver_euler.h \
+	nbody_solver_forest_ruth.h \
+	nbody_solver_hermite.h \
+	nbody_solver_leapfrog.h \
 	nbody_solver_midpoint.h \
 	nbody_solver_midpoint_stetter.h \
 	nbody_solver_rk_butcher.h \
@@ -82,12 +105,17 @@ HEADERS	+= \
 	nbody_solver_rkfeagin14.h \
 	nbody_solver_rkgl.h \
 	nbody_solver_rklc.h \
-	nbody_solver_stormer.h \
+	nbody_solver_rkn4.h \
+	nbody_solver_rkn64.h \
+	nbody_solver_symplectic.h \
 	nbody_solver_trapeze.h \
+	nbody_solver_wisdom_holman.h \
+	nbody_solver_yoshida.h \
 	nbody_solvers.h \
 	nbody_space_heap.h \
 	nbody_space_heap_stackless.h \
 	nbody_space_heap_func.h \
+	nbody_space_order.h \
 	nbody_space_tree.h \
 	nbody_step_visitor.h \
 	vertex.h \
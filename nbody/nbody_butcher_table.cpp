@@ -8,6 +8,11 @@ nbody_butcher_table::~nbody_butcher_table()
 {
 }
 
+size_t nbody_butcher_table::get_error_order() const
+{
+	return 0;
+}
+
 nbody_butcher_table_rk4::nbody_butcher_table_rk4()
 {
 }
@@ -56,3 +61,102 @@ bool nbody_butcher_table_rk4::is_embedded() const
 {
 	return false;
 }
+
+nbody_butcher_table_rkn::nbody_butcher_table_rkn()
+{
+}
+
+nbody_butcher_table_rkn::~nbody_butcher_table_rkn()
+{
+}
+
+size_t nbody_butcher_table_rkn::get_error_order() const
+{
+	return 0;
+}
+
+nbody_butcher_table_rkn_induced::nbody_butcher_table_rkn_induced(const nbody_butcher_table* t) :
+	m_steps(t->get_steps()),
+	m_implicit(t->is_implicit()),
+	m_embedded(t->is_embedded()),
+	m_error_order(t->get_error_order())
+{
+	const nbcoord_t**	a = t->get_a();
+	const nbcoord_t*	b1 = t->get_b1();
+	const nbcoord_t*	b2 = t->get_b2();
+	const nbcoord_t*	c = t->get_c();
+	// Rows of explicit tables are defined only below diagonal
+	auto				rk_a = [a, this](size_t i, size_t j) { return (m_implicit || j < i) ? a[i][j] : 0_f; };
+
+	m_a_data.assign(m_steps * m_steps, 0);
+	m_a.resize(m_steps);
+	m_b1.assign(m_steps, 0);
+	m_b2.assign(m_steps, 0);
+	m_bv1.assign(b1, b1 + m_steps);
+	m_bv2.assign(b2, b2 + m_steps);
+	m_c.assign(c, c + m_steps);
+
+	for(size_t i = 0; i != m_steps; ++i)
+	{
+		m_a[i] = m_a_data.data() + i * m_steps;
+		for(size_t n = 0; n != m_steps; ++n)
+		{
+			for(size_t j = 0; j != m_steps; ++j)
+			{
+				m_a_data[i * m_steps + j] += rk_a(i, n) * rk_a(n, j);
+			}
+			m_b1[n] += b1[i] * rk_a(i, n);
+			m_b2[n] += b2[i] * rk_a(i, n);
+		}
+	}
+}
+
+size_t nbody_butcher_table_rkn_induced::get_steps() const
+{
+	return m_steps;
+}
+
+const nbcoord_t** nbody_butcher_table_rkn_induced::get_a() const
+{
+	return const_cast<const nbcoord_t**>(m_a.data());
+}
+
+const nbcoord_t* nbody_butcher_table_rkn_induced::get_b1() const
+{
+	return m_b1.data();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn_induced::get_b2() const
+{
+	return m_b2.data();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn_induced::get_bv1() const
+{
+	return m_bv1.data();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn_induced::get_bv2() const
+{
+	return m_bv2.data();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn_induced::get_c() const
+{
+	return m_c.data();
+}
+
+bool nbody_butcher_table_rkn_induced::is_implicit() const
+{
+	return m_implicit;
+}
+
+bool nbody_butcher_table_rkn_induced::is_embedded() const
+{
+	return m_embedded;
+}
+
+size_t nbody_butcher_table_rkn_induced::get_error_order() const
+{
+	return m_error_order;
+}
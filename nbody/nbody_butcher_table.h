@@ -1,6 +1,7 @@
 #ifndef NBODY_BUTCHER_TABLE_H
 #define NBODY_BUTCHER_TABLE_H
 
+#include <vector>
 #include "nbtype.h"
 #include "nbody_export.h"
 
@@ -17,6 +18,8 @@ public:
 
 	virtual bool is_implicit() const = 0;
 	virtual bool is_embedded() const = 0;
+	//! Order of embedded error estimate (lower order of embedded pair), 0 if it is unknown
+	virtual size_t get_error_order() const;
 };
 
 /*!
@@ -36,4 +39,64 @@ public:
 	bool is_embedded() const override;
 };
 
+/*!
+   \brief Butcher table for Runge-Kutta-Nystrom method for y" = f(t, y) with y = [x, v]
+
+   Stages are accelerations only:
+   k[i] = f(t + c[i]*dt, x + c[i]*dt*v + dt^2*Sum(a[i][j]*k[j]))
+   Step is x += dt*v + dt^2*Sum(b[j]*k[j]), v += dt*Sum(bv[j]*k[j]),
+   b1/bv1 are weights of embedded (error estimation) method, b2/bv2 are weights of main method.
+*/
+class NBODY_DLL nbody_butcher_table_rkn
+{
+public:
+	nbody_butcher_table_rkn();
+	virtual ~nbody_butcher_table_rkn();
+	virtual size_t get_steps() const = 0;
+	virtual const nbcoord_t** get_a() const = 0;
+	virtual const nbcoord_t* get_b1() const = 0;
+	virtual const nbcoord_t* get_b2() const = 0;
+	virtual const nbcoord_t* get_bv1() const = 0;
+	virtual const nbcoord_t* get_bv2() const = 0;
+	virtual const nbcoord_t* get_c() const = 0;
+
+	virtual bool is_implicit() const = 0;
+	virtual bool is_embedded() const = 0;
+	//! Order of embedded error estimate (lower order of embedded pair), 0 if it is unknown
+	virtual size_t get_error_order() const;
+};
+
+/*!
+   \brief Runge-Kutta-Nystrom table of Runge-Kutta method applied to [x, v] system
+
+   a = A*A, b = b*A, bv = b. It gives the same solution as the first order method.
+*/
+class NBODY_DLL nbody_butcher_table_rkn_induced : public nbody_butcher_table_rkn
+{
+	size_t							m_steps;
+	std::vector<nbcoord_t>			m_a_data;
+	std::vector<const nbcoord_t*>	m_a;
+	std::vector<nbcoord_t>			m_b1;
+	std::vector<nbcoord_t>			m_b2;
+	std::vector<nbcoord_t>			m_bv1;
+	std::vector<nbcoord_t>			m_bv2;
+	std::vector<nbcoord_t>			m_c;
+	bool							m_implicit;
+	bool							m_embedded;
+	size_t							m_error_order;
+public:
+	explicit nbody_butcher_table_rkn_induced(const nbody_butcher_table* t);
+
+	size_t get_steps() const override;
+	const nbcoord_t** get_a() const override;
+	const nbcoord_t* get_b1() const override;
+	const nbcoord_t* get_b2() const override;
+	const nbcoord_t* get_bv1() const override;
+	const nbcoord_t* get_bv2() const override;
+	const nbcoord_t* get_c() const override;
+	bool is_implicit() const override;
+	bool is_embedded() const override;
+	size_t get_error_order() const override;
+};
+
 #endif // NBODY_BUTCHER_TABLE_H
@@ -10,6 +10,7 @@ nbody_engine::memory::~memory()
 
 nbody_engine::nbody_engine():
 	m_compute_count(0),
+	m_active_compute_count(0),
 	m_ode_order(eode_first_order)
 {
 }
@@ -101,6 +102,165 @@ void nbody_engine::fmaddn(memory* a, const memory* b, const memory_array& c,
 	}
 }
 
+void nbody_engine::fmaddn_second_order(memory* a, const memory* b, const memory_array& c, const nbcoord_t& e,
+									   const nbcoord_t* dx, const nbcoord_t* dv, size_t csize)
+{
+	if(csize > c.size())
+	{
+		qDebug() << "csize > c.size()";
+		return;
+	}
+
+	// Generic implementation through host memory
+	size_t					half = problem_size() / 2;
+	std::vector<nbcoord_t>	y(2 * half, 0);
+	std::vector<nbcoord_t>	acc(half);
+
+	if(b != NULL)
+	{
+		read_buffer(y.data(), b);
+	}
+
+	nbcoord_t*	x = y.data();
+	nbcoord_t*	v = y.data() + half;
+
+	for(size_t i = 0; i != half; ++i)
+	{
+		x[i] += v[i] * e;
+	}
+	for(size_t k = 0; k != csize; ++k)
+	{
+		read_buffer(acc.data(), c[k]);
+		for(size_t i = 0; i != half; ++i)
+		{
+			x[i] += acc[i] * dx[k];
+			v[i] += acc[i] * dv[k];
+		}
+	}
+	write_buffer(a, y.data());
+}
+
+void nbody_engine::fweighted_rms(const memory* a, const memory* y, const nbcoord_t& atol, const nbcoord_t& rtol,
+								 nbcoord_t& result)
+{
+	// Generic implementation through host memory
+	size_t					count = problem_size();
+	std::vector<nbcoord_t>	ha(count);
+	std::vector<nbcoord_t>	hy(count);
+
+	read_buffer(ha.data(), a);
+	read_buffer(hy.data(), y);
+
+	nbcoord_t	sum = 0;
+	for(size_t i = 0; i != count; ++i)
+	{
+		const nbcoord_t	e = ha[i] / (atol + rtol * fabs(hy[i]));
+		sum += e * e;
+	}
+	result = sqrt(sum / static_cast<nbcoord_t>(count));
+}
+
+void nbody_engine::fdot(const memory* a, const memory* b, nbcoord_t& result)
+{
+	// Generic implementation through host memory
+	size_t					count = problem_size();
+	std::vector<nbcoord_t>	ha(count);
+	std::vector<nbcoord_t>	hb(count);
+
+	read_buffer(ha.data(), a);
+	read_buffer(hb.data(), b);
+
+	result = 0;
+	for(size_t i = 0; i != count; ++i)
+	{
+		result += ha[i] * hb[i];
+	}
+}
+
+nbody_engine* nbody_engine::clone()
+{
+	return NULL;
+}
+
+const nbody_engine::memory* nbody_engine::get_mass()
+{
+	return NULL;
+}
+
+bool nbody_engine::is_second_order_supported() const
+{
+	return false;
+}
+
+void nbody_engine::fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+								   const std::vector<size_t>& active)
+{
+	if(get_ode_order() != eode_second_order)
+	{
+		qDebug() << "fcompute_active requires second order ODE";
+		return;
+	}
+
+	// Generic implementation computes all bodies and keeps accelerations of active ones
+	size_t					half = problem_size() / 2;
+	size_t					count = half / 3;
+	memory*					all = create_buffer(sizeof(nbcoord_t) * half);
+	std::vector<nbcoord_t>	all_acc(half);
+	std::vector<nbcoord_t>	acc(half);
+
+	fcompute(t, y, all);
+	read_buffer(all_acc.data(), all);
+	read_buffer(acc.data(), f);
+	free_buffer(all);
+
+	for(size_t i : active)
+	{
+		for(size_t d = 0; d != 3; ++d)
+		{
+			acc[i + d * count] = all_acc[i + d * count];
+		}
+	}
+	write_buffer(f, acc.data());
+}
+
+void nbody_engine::fcompute_with_jerk(const nbcoord_t& t, const memory* y, memory* f, memory* jerk)
+{
+	Q_UNUSED(t);
+	Q_UNUSED(y);
+	Q_UNUSED(f);
+	Q_UNUSED(jerk);
+	qDebug() << "fcompute_with_jerk is not supported by" << type_name();
+}
+
+void nbody_engine::kick_active(memory* y, const memory* f, const std::vector<size_t>& active,
+							   const std::vector<nbcoord_t>& dt)
+{
+	if(active.size() != dt.size())
+	{
+		qDebug() << "active.size() != dt.size()";
+		return;
+	}
+
+	// Generic implementation through host memory
+	size_t					half = problem_size() / 2;
+	size_t					count = half / 3;
+	std::vector<nbcoord_t>	state(2 * half);
+	std::vector<nbcoord_t>	acc(half);
+
+	read_buffer(state.data(), y);
+	read_buffer(acc.data(), f);
+
+	nbcoord_t*	v = state.data() + half;
+	for(size_t n = 0; n != active.size(); ++n)
+	{
+		for(size_t d = 0; d != 3; ++d)
+		{
+			v[active[n] + d * count] += acc[active[n] + d * count] * dt[n];
+		}
+	}
+	write_buffer(y, state.data());
+}
+
 void nbody_engine::print_info() const
 {
 }
@@ -110,6 +270,18 @@ void nbody_engine::advise_compute_count()
 	m_compute_count++;
 }
 
+void nbody_engine::advise_compute_count(size_t active_count)
+{
+	size_t	count = problem_size() / 6;
+
+	m_active_compute_count += active_count;
+	if(count != 0)
+	{
+		m_compute_count += m_active_compute_count / count;
+		m_active_compute_count %= count;
+	}
+}
+
 size_t nbody_engine::get_compute_count() const
 {
 	return m_compute_count;
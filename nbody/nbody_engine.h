@@ -7,15 +7,20 @@
 enum e_ode_order
 {
 	eode_first_order = 1,	// y' = f(t, y)
-	eode_second_order = 1,	// y" = f(t, y)
+	eode_second_order = 2,	// y" = f(t, y)
 };
 
 /*!
 	Compute engine for ODE y' = f(t, y) or y" = f(t, y)
+
+	State is y = [x, v], both halves have problem_size() / 2 values.
+	For first order ODE fcompute returns f = [v, a] of problem_size() values,
+	for second order ODE it returns accelerations f = [a] only (problem_size() / 2 values).
 */
 class NBODY_DLL nbody_engine
 {
 	size_t	m_compute_count;
+	size_t	m_active_compute_count;
 	e_ode_order	m_ode_order;
 	nbody_engine(const nbody_engine&) = delete;
 	nbody_engine& operator = (const nbody_engine&) = delete;
@@ -55,6 +60,19 @@ public:
 	virtual void set_step(size_t s) = 0;
 	//! Compute f( t, y )
 	virtual void fcompute(const nbcoord_t& t, const memory* y, memory* f) = 0;
+	/*!
+		Compute accelerations of 'active' bodies only (second order ODE).
+		'f' has problem_size() / 2 values, accelerations of other bodies are not changed.
+		Generic implementation computes all bodies with fcompute.
+	*/
+	virtual void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+								 const std::vector<size_t>& active);
+	/*!
+		Compute accelerations 'f' and their time derivatives (jerks) 'jerk' of all bodies
+		at state 'y' in single pass. 'f' and 'jerk' have problem_size() / 2 values [x, y, z].
+		Result does not depend on ODE order. Generic implementation is not supported.
+	*/
+	virtual void fcompute_with_jerk(const nbcoord_t& t, const memory* y, memory* f, memory* jerk);
 
 	virtual memory* create_buffer(size_t) = 0;
 	virtual void free_buffer(memory*) = 0;
@@ -79,12 +97,51 @@ public:
 	//! a[i] = b[i] + sum( c[k][i]*d[k], k=[0...dsize) )
 	virtual void fmaddn(memory* a, const memory* b, const memory_array& c,
 						const nbcoord_t* d, size_t dsize);
+	/*!
+		Second order ODE step, a = [ax, av], b = [bx, bv] are states and c[k] are accelerations:
+		ax[i] = bx[i] + bv[i]*e + sum( c[k][i]*dx[k], k=[0...csize) )
+		av[i] = bv[i] + sum( c[k][i]*dv[k], k=[0...csize) )
+		'b' may be NULL (zero state), 'a' may be equal to 'b'
+	*/
+	virtual void fmaddn_second_order(memory* a, const memory* b, const memory_array& c, const nbcoord_t& e,
+									 const nbcoord_t* dx, const nbcoord_t* dv, size_t csize);
+	//! Second order ODE kick of 'active' bodies: v[i] += f[i]*dt[n], i = active[n]
+	virtual void kick_active(memory* y, const memory* f, const std::vector<size_t>& active,
+							 const std::vector<nbcoord_t>& dt);
 	//! @result = max( fabs(a[k]), k=[0...asize) )
 	virtual void fmaxabs(const memory* a, nbcoord_t& result) = 0;
+	/*!
+		Weighted RMS norm of error estimate 'a' of state 'y':
+		@result = sqrt( sum( (a[k]/(atol + rtol*fabs(y[k])))^2, k=[0...asize) )/asize )
+	*/
+	virtual void fweighted_rms(const memory* a, const memory* y, const nbcoord_t& atol, const nbcoord_t& rtol,
+							   nbcoord_t& result);
+	//! @result = sum( a[k]*b[k], k=[0...asize) )
+	virtual void fdot(const memory* a, const memory* b, nbcoord_t& result);
+	/*!
+		Create engine for concurrent computations on the same bodies.
+		Clone shares masses and force law with this engine and has private state y, time and buffers,
+		buffers of clone and this engine may be mixed in buffer operations of both engines.
+		Clone must be deleted before this engine.
+		Generic implementation is not supported and returns NULL.
+	*/
+	virtual nbody_engine* clone();
+	/*!
+		Body masses in engine's body order (bodies count values), they may be read with read_buffer.
+		Generic implementation returns NULL.
+	*/
+	virtual const memory* get_mass();
+	/*!
+		Engine computes accelerations only (second order ODE, see set_ode_order).
+		Generic implementation is not supported and returns false.
+	*/
+	virtual bool is_second_order_supported() const;
 	//! Print engine info
 	virtual void print_info() const;
 
 	void advise_compute_count();
+	//! Account force computation of 'active_count' bodies, all bodies make one compute
+	void advise_compute_count(size_t active_count);
 	size_t get_compute_count() const;
 	//! Set engine's ODE order
 	void set_ode_order(e_ode_order);
@@ -1,10 +1,191 @@
 #include "nbody_engine_ah.h"
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+/*!
+	Uniform grid with cell size not less than search radius,
+	so neighbours of body are at 3x3x3 cells around body's cell.
+	Bodies are sorted by cells: bodies of cell n are body[start[n]...start[n + 1]).
+ */
+struct cell_grid
+{
+	nbcoord_t				origin[3];
+	nbcoord_t				cell;
+	size_t					dim[3];
+	std::vector<size_t>		start;
+	std::vector<uint32_t>	body;
+
+	size_t coord_index(nbcoord_t x, size_t d) const
+	{
+		const nbcoord_t	i = (x - origin[d]) / cell;
+		return std::min(static_cast<size_t>(std::max(i, static_cast<nbcoord_t>(0))), dim[d] - 1);
+	}
+
+	size_t cell_index(size_t ix, size_t iy, size_t iz) const
+	{
+		return ix + dim[0] * (iy + dim[1] * iz);
+	}
+
+	void build(size_t count, const nbcoord_t* const r[3], nbcoord_t radius)
+	{
+		nbcoord_t	extent[3];
+		for(size_t d = 0; d != 3; ++d)
+		{
+			const auto	minmax = std::minmax_element(r[d], r[d] + count);
+			origin[d] = *minmax.first;
+			extent[d] = *minmax.second - *minmax.first;
+		}
+
+		// Grid is not allowed to be much larger than bodies count
+		const size_t	max_cells = 8 * count + 8;
+		cell = radius;
+		for(;;)
+		{
+			size_t	cells = 1;
+			for(size_t d = 0; d != 3; ++d)
+			{
+				dim[d] = static_cast<size_t>(extent[d] / cell) + 1;
+				cells *= dim[d];
+			}
+			if(cells <= max_cells)
+			{
+				break;
+			}
+			cell *= 2;
+		}
+
+		std::vector<size_t>	body_cell(count);
+		start.assign(dim[0] * dim[1] * dim[2] + 1, 0);
+		for(size_t n = 0; n != count; ++n)
+		{
+			body_cell[n] = cell_index(coord_index(r[0][n], 0), coord_index(r[1][n], 1), coord_index(r[2][n], 2));
+			++start[body_cell[n] + 1];
+		}
+		for(size_t c = 1; c != start.size(); ++c)
+		{
+			start[c] += start[c - 1];
+		}
+		std::vector<size_t>	pos(start.begin(), start.end() - 1);
+		body.resize(count);
+		for(size_t n = 0; n != count; ++n)
+		{
+			body[pos[body_cell[n]]++] = static_cast<uint32_t>(n);
+		}
+	}
+};
+
+//! Neighbours search of single body
+struct adjacent_search
+{
+	size_t					count;
+	const nbcoord_t*		r[3];
+	const nbcoord_t*		mass;
+	//! max_dist + skin
+	nbcoord_t				radius;
+	nbcoord_t				skin;
+	nbcoord_t				min_force;
+	//! nullptr if radius is zero
+	const cell_grid*		grid;
+	/*!
+		Heavy bodies may have neighbours further than 'radius' due to force criterion,
+		they are checked with all bodies
+	 */
+	std::vector<char>		is_heavy;
+	std::vector<uint32_t>	heavy;
+
+	nbcoord_t distance_sqr(size_t body1, size_t body2) const
+	{
+		const nbcoord_t	dx = r[0][body2] - r[0][body1];
+		const nbcoord_t	dy = r[1][body2] - r[1][body1];
+		const nbcoord_t	dz = r[2][body2] - r[2][body1];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	//! r < max(max_dist, sqrt(m1*m2/min_force)) + skin
+	bool is_adjacent(size_t body1, size_t body2, nbcoord_t r2) const
+	{
+		if(r2 < radius * radius || r2 <= skin * skin)
+		{
+			return true;
+		}
+		const nbcoord_t	rf = sqrt(r2) - skin;
+		return mass[body1] * mass[body2] > min_force * rf * rf;
+	}
+
+	//! Neighbours count of 'body1', neighbours are written to 'out' if it is not nullptr
+	size_t collect(size_t body1, uint32_t* out) const
+	{
+		size_t	n = 0;
+		auto	add = [&n, out](size_t body2)
+		{
+			if(out != nullptr)
+			{
+				out[n] = static_cast<uint32_t>(body2);
+			}
+			++n;
+		};
+
+		if(is_heavy[body1])
+		{
+			for(size_t body2 = 0; body2 != count; ++body2)
+			{
+				if(body2 != body1 && is_adjacent(body1, body2, distance_sqr(body1, body2)))
+				{
+					add(body2);
+				}
+			}
+			return n;
+		}
+
+		// Light bodies pair is adjacent only if r < radius
+		if(grid != nullptr)
+		{
+			const size_t	ix = grid->coord_index(r[0][body1], 0);
+			const size_t	iy = grid->coord_index(r[1][body1], 1);
+			const size_t	iz = grid->coord_index(r[2][body1], 2);
+			for(size_t cz = (iz > 0 ? iz - 1 : 0); cz <= std::min(iz + 1, grid->dim[2] - 1); ++cz)
+			{
+				for(size_t cy = (iy > 0 ? iy - 1 : 0); cy <= std::min(iy + 1, grid->dim[1] - 1); ++cy)
+				{
+					for(size_t cx = (ix > 0 ? ix - 1 : 0); cx <= std::min(ix + 1, grid->dim[0] - 1); ++cx)
+					{
+						const size_t	c = grid->cell_index(cx, cy, cz);
+						for(size_t idx = grid->start[c]; idx != grid->start[c + 1]; ++idx)
+						{
+							const size_t	body2 = grid->body[idx];
+							if(body2 != body1 && distance_sqr(body1, body2) < radius * radius)
+							{
+								add(body2);
+							}
+						}
+					}
+				}
+			}
+		}
+		for(size_t body2 : heavy)
+		{
+			const nbcoord_t	r2 = distance_sqr(body1, body2);
+			if(r2 >= radius * radius && is_adjacent(body1, body2, r2))
+			{
+				add(body2);
+			}
+		}
+		return n;
+	}
+};
+
+}//namespace
 
 nbody_engine_ah::nbody_engine_ah(size_t full_recompute_rate,
-								 nbcoord_t max_dist, nbcoord_t min_force) :
+								 nbcoord_t max_dist, nbcoord_t min_force, nbcoord_t skin) :
+	m_full_time(0),
+	m_full_step(0),
 	m_full_recompute_rate(full_recompute_rate),
-	m_max_dist_sqr(max_dist * max_dist),
-	m_min_force_sqr(min_force * min_force)
+	m_max_dist(max_dist),
+	m_min_force(min_force),
+	m_skin(skin)
 {
 }
 
@@ -15,7 +196,6 @@ const char* nbody_engine_ah::type_name() const
 
 void nbody_engine_ah::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
 {
-	Q_UNUSED(t);
 	const smemory*	y = dynamic_cast<const  smemory*>(_y);
 	smemory*		f = dynamic_cast<smemory*>(_f);
 
@@ -30,58 +210,175 @@ void nbody_engine_ah::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
 		return;
 	}
 
-	if(m_data->get_step() % m_full_recompute_rate == 0)
-	{
-		fcompute_full(y, f);
-	}
-	else
+	switch(get_force_law())
 	{
-		fcompute_sparse(y, f);
+	case efl_plummer:
+		fcompute_law(nbody_force_plummer(get_softening()), t, y, f);
+		break;
+	case efl_spline:
+		fcompute_law(nbody_force_spline(get_softening()), t, y, f);
+		break;
+	default:
+		fcompute_law(nbody_force_newton(), t, y, f);
+		break;
 	}
 }
 
-void nbody_engine_ah::fcompute_full(const nbody_engine_simple::smemory* y, nbody_engine_simple::smemory* f)
+void nbody_engine_ah::fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+									  const std::vector<size_t>& active)
 {
-	advise_compute_count();
+	// Far forces are cached per body between full recomputations, so use generic
+	// implementation to keep accelerations of active subset consistent with fcompute
+	nbody_engine::fcompute_active(t, y, f, active);
+}
 
-	size_t				count = m_data->get_count();
+void nbody_engine_ah::print_info() const
+{
+	nbody_engine_simple::print_info();
+	qDebug() << "\tfull_recompute_rate:" << m_full_recompute_rate;
+	qDebug() << "\tmax_dist:" << m_max_dist;
+	qDebug() << "\tmin_force:" << m_min_force;
+	qDebug() << "\tverlet_skin:" << m_skin;
+}
+
+bool nbody_engine_ah::is_full_recompute_required(const smemory* y) const
+{
+	size_t	count = m_data->get_count();
+
+	if(m_adjacent_start.size() != count + 1 ||
+	   m_data->get_step() >= m_full_step + m_full_recompute_rate)
+	{
+		return true;
+	}
+
+	// Neighbour lists stay complete while each body moved less than half of skin
 	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
 	const nbcoord_t*	ry = rx + count;
 	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
+	nbcoord_t			max_shift_sqr = 0;
+
+	#pragma omp parallel for reduction( max : max_shift_sqr )
+	for(size_t n = 0; n < count; ++n)
+	{
+		const nbvertex_t	shift(nbvertex_t(rx[n], ry[n], rz[n]) - m_full_position[n]);
+		max_shift_sqr = std::max(max_shift_sqr, shift.norm());
+	}
+
+	return 4 * max_shift_sqr > m_skin * m_skin;
+}
 
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
+void nbody_engine_ah::build_adjacent(const smemory* y)
+{
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
 	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	const nbcoord_t		max_mass = (count > 0) ? *std::max_element(mass, mass + count) : 0;
+	adjacent_search		search;
+	cell_grid			grid;
 
-	if(m_univerce_force.size() != count)
+	search.count = count;
+	search.r[0] = rx;
+	search.r[1] = rx + count;
+	search.r[2] = rx + 2 * count;
+	search.mass = mass;
+	search.radius = m_max_dist + m_skin;
+	search.skin = m_skin;
+	search.min_force = m_min_force;
+	search.grid = nullptr;
+	search.is_heavy.resize(count);
+	for(size_t n = 0; n != count; ++n)
+	{
+		// Force criterion radius sqrt(m1*m2/min_force) can exceed max_dist
+		search.is_heavy[n] = (mass[n] * max_mass > m_min_force * m_max_dist * m_max_dist);
+		if(search.is_heavy[n])
+		{
+			search.heavy.push_back(static_cast<uint32_t>(n));
+		}
+	}
+	if(search.radius > 0 && search.heavy.size() != count)
+	{
+		grid.build(count, search.r, search.radius);
+		search.grid = &grid;
+	}
+
+	// Two passes: count neighbours, then write them to CSR arrays without reallocations
+	m_adjacent_start.resize(count + 1);
+	m_adjacent_start[0] = 0;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t body1 = 0; body1 < count; ++body1)
 	{
-		m_univerce_force.resize(count);
+		m_adjacent_start[body1 + 1] = search.collect(body1, nullptr);
+	}
+	for(size_t n = 0; n != count; ++n)
+	{
+		m_adjacent_start[n + 1] += m_adjacent_start[n];
 	}
 
-	if(m_adjacent_body.size() != count)
+	m_adjacent_body.resize(m_adjacent_start[count]);
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t body1 = 0; body1 < count; ++body1)
 	{
-		m_adjacent_body.resize(count);
+		uint32_t*	begin = m_adjacent_body.data() + m_adjacent_start[body1];
+		uint32_t*	end = m_adjacent_body.data() + m_adjacent_start[body1 + 1];
+		search.collect(body1, begin);
+		// Sequential access to neighbours at fcompute_sparse
+		std::sort(begin, end);
 	}
 
+	m_full_position.resize(count);
 	for(size_t n = 0; n != count; ++n)
 	{
-		m_univerce_force[n] = nbvertex_t(0, 0, 0);
-		m_adjacent_body[n].resize(0);
+		m_full_position[n] = nbvertex_t(search.r[0][n], search.r[1][n], search.r[2][n]);
 	}
+}
+
+template<class ForceLaw>
+void nbody_engine_ah::fcompute_law(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f)
+{
+	if(is_full_recompute_required(y))
+	{
+		fcompute_full(law, t, y, f);
+	}
+	else
+	{
+		fcompute_sparse(law, t, y, f);
+	}
+}
+
+template<class ForceLaw>
+void nbody_engine_ah::fcompute_full(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f)
+{
+	advise_compute_count();
+	build_adjacent(y);
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+	const nbcoord_t*	vx = rx + 3 * count;
+	const nbcoord_t*	vy = rx + 4 * count;
+	const nbcoord_t*	vz = rx + 5 * count;
+
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	m_univerce_acc.resize(count);
+	m_univerce_acc_rate.resize(count);
 
 	#pragma omp parallel for
 	for(size_t body1 = 0; body1 < count; ++body1)
 	{
 		const nbvertex_t	v1(rx[ body1 ], ry[ body1 ], rz[ body1 ]);
-		nbvertex_t			total_univerce_force;
-		nbvertex_t			total_force;
+		const nbvertex_t	u1(vx[ body1 ], vy[ body1 ], vz[ body1 ]);
+		const uint32_t*		adjacent = m_adjacent_body.data() + m_adjacent_start[body1];
+		const uint32_t*		adjacent_end = m_adjacent_body.data() + m_adjacent_start[body1 + 1];
+		nbvertex_t			total_univerce_acc;
+		nbvertex_t			total_univerce_acc_rate;
+		nbvertex_t			total_acc;
 
 		for(size_t body2 = 0; body2 != count; ++body2)
 		{
@@ -90,31 +387,40 @@ void nbody_engine_ah::fcompute_full(const nbody_engine_simple::smemory* y, nbody
 				continue;
 			}
 
-			const nbvertex_t	v2(rx[ body2 ], ry[ body2 ], rz[ body2 ]);
-			const nbvertex_t	force(m_data->force(v1, v2, mass[body1], mass[body2]));
+			const nbvertex_t	dr(nbvertex_t(rx[ body2 ], ry[ body2 ], rz[ body2 ]) - v1);
+			const nbcoord_t		r2(dr.norm());
+			const nbcoord_t		coeff(mass[body2] * law(r2));
+			const nbvertex_t	acc(dr * coeff);
 
-			if((v1 - v2).norm() < m_max_dist_sqr ||
-			   force.norm() > m_min_force_sqr)
+			// Neighbours are sorted, so they are skipped with single pass
+			if(adjacent != adjacent_end && *adjacent == body2)
 			{
-				m_adjacent_body[ body1 ].push_back(body2);
+				++adjacent;
 			}
 			else
 			{
-				total_univerce_force += force;
+				// d(acc)/dt = m2*(dv*k(r^2) + 2*(dr*dv)*dr*k'(r^2))
+				const nbvertex_t	dv(nbvertex_t(vx[ body2 ], vy[ body2 ], vz[ body2 ]) - u1);
+				const nbcoord_t		rv(2 * (dr * dv) * mass[body2] * law.derivative(r2));
+
+				total_univerce_acc += acc;
+				total_univerce_acc_rate += dv * coeff + dr * rv;
 			}
-			total_force += force;
+			total_acc += acc;
 		}
-		frx[body1] = vx[body1];
-		fry[body1] = vy[body1];
-		frz[body1] = vz[body1];
-		fvx[body1] = total_force.x / mass[body1];
-		fvy[body1] = total_force.y / mass[body1];
-		fvz[body1] = total_force.z / mass[body1];
-		m_univerce_force[body1] = total_univerce_force;
+		fvx[body1] = total_acc.x;
+		fvy[body1] = total_acc.y;
+		fvz[body1] = total_acc.z;
+		m_univerce_acc[body1] = total_univerce_acc;
+		m_univerce_acc_rate[body1] = total_univerce_acc_rate;
 	}
+
+	m_full_time = t;
+	m_full_step = m_data->get_step();
 }
 
-void nbody_engine_ah::fcompute_sparse(const nbody_engine_simple::smemory* y, nbody_engine_simple::smemory* f)
+template<class ForceLaw>
+void nbody_engine_ah::fcompute_sparse(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f)
 {
 	advise_compute_count();
 
@@ -122,39 +428,86 @@ void nbody_engine_ah::fcompute_sparse(const nbody_engine_simple::smemory* y, nbo
 	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
 	const nbcoord_t*	ry = rx + count;
 	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
 
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
 	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	const nbcoord_t		dt = t - m_full_time;
 
 	#pragma omp parallel for
 	for(size_t body1 = 0; body1 < count; ++body1)
 	{
 		const nbvertex_t	v1(rx[ body1 ], ry[ body1 ], rz[ body1 ]);
-		nbvertex_t			total_force(m_univerce_force[body1]);
-		size_t*				body2_indites = m_adjacent_body[ body1 ].data();
-		size_t				body2_count = m_adjacent_body[ body1 ].size();
+		// Univerce force is extrapolated linearly from the last full recompute
+		nbvertex_t			total_acc(m_univerce_acc[body1] + m_univerce_acc_rate[body1] * dt);
+		const uint32_t*		body2_indites = m_adjacent_body.data() + m_adjacent_start[body1];
+		size_t				body2_count = m_adjacent_start[body1 + 1] - m_adjacent_start[body1];
 
 		for(size_t idx = 0; idx != body2_count; ++idx)
 		{
 			size_t				body2(body2_indites[idx]);
-			const nbvertex_t	v2(rx[ body2 ], ry[ body2 ], rz[ body2 ]);
-			const nbvertex_t	force(m_data->force(v1, v2, mass[body1], mass[body2]));
-			total_force += force;
+			const nbvertex_t	dr(nbvertex_t(rx[ body2 ], ry[ body2 ], rz[ body2 ]) - v1);
+			total_acc += dr * (mass[body2] * law(dr.norm()));
 		}
 
-		frx[body1] = vx[body1];
-		fry[body1] = vy[body1];
-		frz[body1] = vz[body1];
-		fvx[body1] = total_force.x / mass[body1];
-		fvy[body1] = total_force.y / mass[body1];
-		fvz[body1] = total_force.z / mass[body1];
+		fvx[body1] = total_acc.x;
+		fvy[body1] = total_acc.y;
+		fvz[body1] = total_acc.z;
 	}
 }
+
+void nbody_engine_ah::bodies_reordered(const std::vector<size_t>& order)
+{
+	size_t	count = order.size();
+
+	if(m_univerce_acc.size() != count || m_adjacent_start.size() != count + 1)
+	{
+		return;
+	}
+
+	std::vector<size_t>	new_index(count);
+	for(size_t i = 0; i != count; ++i)
+	{
+		new_index[order[i]] = i;
+	}
+
+	std::vector< nbvertex_t >	univerce_acc(count);
+	std::vector< nbvertex_t >	univerce_acc_rate(count);
+	std::vector< nbvertex_t >	full_position(count);
+	std::vector<size_t>			adjacent_start(count + 1);
+	std::vector<uint32_t>		adjacent_body(m_adjacent_body.size());
+
+	adjacent_start[0] = 0;
+	for(size_t body1 = 0; body1 != count; ++body1)
+	{
+		const size_t	old_body1 = order[body1];
+		adjacent_start[body1 + 1] = adjacent_start[body1] +
+									m_adjacent_start[old_body1 + 1] - m_adjacent_start[old_body1];
+	}
+
+	#pragma omp parallel for
+	for(size_t body1 = 0; body1 < count; ++body1)
+	{
+		const size_t	old_body1 = order[body1];
+		const uint32_t*	old_adjacent = m_adjacent_body.data() + m_adjacent_start[old_body1];
+		uint32_t*		begin = adjacent_body.data() + adjacent_start[body1];
+		uint32_t*		end = adjacent_body.data() + adjacent_start[body1 + 1];
+
+		univerce_acc[body1] = m_univerce_acc[old_body1];
+		univerce_acc_rate[body1] = m_univerce_acc_rate[old_body1];
+		full_position[body1] = m_full_position[old_body1];
+		for(uint32_t* adjacent = begin; adjacent != end; ++adjacent, ++old_adjacent)
+		{
+			*adjacent = static_cast<uint32_t>(new_index[*old_adjacent]);
+		}
+		// Sequential access to neighbours at fcompute_sparse
+		std::sort(begin, end);
+	}
+
+	m_univerce_acc.swap(univerce_acc);
+	m_univerce_acc_rate.swap(univerce_acc_rate);
+	m_full_position.swap(full_position);
+	m_adjacent_start.swap(adjacent_start);
+	m_adjacent_body.swap(adjacent_body);
+}
@@ -1,6 +1,7 @@
 #ifndef NBODY_ENGINE_AH_H
 #define NBODY_ENGINE_AH_H
 
+#include <cstdint>
 #include "nbody_engine_simple.h"
 
 /*
@@ -8,21 +9,51 @@
 	A. AHMAD AND L. COHEN 1973
 
 	https://courses.physics.ucsd.edu/2016/Winter/physics141/Lectures/Lecture8/AhmadCohen.pdf
+
+	Bodies closer than max(max_dist, sqrt(m1*m2/min_force)) + skin are neighbours,
+	their forces are computed at each call. Acceleration by other bodies (univerce force)
+	is computed at full recompute and linearly extrapolated in time.
+	Neighbours are found with uniform cell grid and stored in CSR arrays.
+	Full recompute is done when some body moved further than skin/2 since
+	the last one (so neighbour lists are still complete), or once per
+	'full_recompute_rate' steps (so univerce force is not too old).
 */
 class NBODY_DLL nbody_engine_ah : public nbody_engine_simple
 {
-	std::vector< std::vector<size_t> >	m_adjacent_body;
-	std::vector< nbvertex_t >			m_univerce_force;
+	//! Neighbours of body n are m_adjacent_body[m_adjacent_start[n]...m_adjacent_start[n + 1]), sorted
+	std::vector<size_t>					m_adjacent_start;
+	std::vector<uint32_t>				m_adjacent_body;
+	//! Acceleration by non-neighbour bodies at the last full recompute
+	std::vector< nbvertex_t >			m_univerce_acc;
+	//! Time derivative of m_univerce_acc
+	std::vector< nbvertex_t >			m_univerce_acc_rate;
+	//! Positions of bodies at the last full recompute
+	std::vector< nbvertex_t >			m_full_position;
+	nbcoord_t							m_full_time;
+	size_t								m_full_step;
 	size_t								m_full_recompute_rate;
-	nbcoord_t							m_max_dist_sqr;
-	nbcoord_t							m_min_force_sqr;
+	nbcoord_t							m_max_dist;
+	nbcoord_t							m_min_force;
+	nbcoord_t							m_skin;
 public:
-	explicit nbody_engine_ah(size_t full_recompute_rate = 1000, nbcoord_t max_dist = 10, nbcoord_t min_force = 1e-4);
+	explicit nbody_engine_ah(size_t full_recompute_rate = 1000, nbcoord_t max_dist = 10, nbcoord_t min_force = 1e-4,
+							 nbcoord_t skin = 2.5);
 	const char* type_name() const override;
 	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
+	void print_info() const override;
+protected:
+	void bodies_reordered(const std::vector<size_t>& order) override;
 private:
-	void fcompute_full(const smemory* y, smemory* f);
-	void fcompute_sparse(const smemory* y, smemory* f);
+	bool is_full_recompute_required(const smemory* y) const;
+	void build_adjacent(const smemory* y);
+	template<class ForceLaw>
+	void fcompute_law(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f);
+	template<class ForceLaw>
+	void fcompute_full(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f);
+	template<class ForceLaw>
+	void fcompute_sparse(const ForceLaw& law, const nbcoord_t& t, const smemory* y, smemory* f);
 };
 
 #endif // NBODY_ENGINE_SPARSE_H
@@ -1,59 +1,38 @@
 #include "nbody_engine_block.h"
 #include <omp.h>
 #include <QDebug>
+#include <algorithm>
 
-nbody_engine_block::nbody_engine_block()
-{
-}
+namespace {
 
-const char* nbody_engine_block::type_name() const
+/*!
+	Block-by-block force computation of 'count' target bodies 'tx', 'ty', 'tz'.
+	Pairwise terms and per-block partial sums are computed in T, total force is accumulated in nbcoord_t.
+	For T equal to nbcoord_t bodies are summed in the same order as in direct sum.
+	For T narrower than nbcoord_t coordinates are loaded relative to first body of block 'n1',
+	so dx, dy, dz keep their precision for close bodies far from origin.
+	Targets are padded up to multiple of block size, sources rx, ry, rz and mass are padded
+	up to 'padded_count' (multiple of block size) with zero-mass bodies.
+ */
+template<class T>
+void fcompute_block(size_t count, const nbcoord_t* tx, const nbcoord_t* ty, const nbcoord_t* tz,
+					size_t padded_count,
+					const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz, const nbcoord_t* mass,
+					nbcoord_t* fvx, nbcoord_t* fvy, nbcoord_t* fvz)
 {
-	return "nbody_engine_block";
-}
-
-void nbody_engine_block::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
-{
-	Q_UNUSED(t);
-	const smemory*	y = dynamic_cast<const  smemory*>(_y);
-	smemory*		f = dynamic_cast<smemory*>(_f);
-
-	if(y == NULL)
-	{
-		qDebug() << "y is not smemory";
-		return;
-	}
-	if(f == NULL)
-	{
-		qDebug() << "f is not smemory";
-		return;
-	}
-
-	advise_compute_count();
-
-	size_t				count = m_data->get_count();
 	const size_t		block = NBODY_DATA_BLOCK_SIZE;
-
-	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
-	const nbcoord_t*	ry = rx + count;
-	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
-
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
-	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	const bool			shift_origin = sizeof(T) < sizeof(nbcoord_t);
+	const T				min_distance = static_cast<T>(nbody::MinDistance);
 
 	#pragma omp parallel for
 	for(size_t n1 = 0; n1 < count; n1 += block)
 	{
-		nbcoord_t			x1[block];
-		nbcoord_t			y1[block];
-		nbcoord_t			z1[block];
+		const nbcoord_t		ox = shift_origin ? tx[n1] : 0;
+		const nbcoord_t		oy = shift_origin ? ty[n1] : 0;
+		const nbcoord_t		oz = shift_origin ? tz[n1] : 0;
+		T					x1[block];
+		T					y1[block];
+		T					z1[block];
 		nbcoord_t			total_force_x[block];
 		nbcoord_t			total_force_y[block];
 		nbcoord_t			total_force_z[block];
@@ -62,65 +41,388 @@ void nbody_engine_block::fcompute(const nbcoord_t& t, const memory* _y, memory*
 		{
 			size_t local_n1 = b1 + n1;
 
-			x1[b1] = rx[local_n1];
-			y1[b1] = ry[local_n1];
-			z1[b1] = rz[local_n1];
+			x1[b1] = static_cast<T>(tx[local_n1] - ox);
+			y1[b1] = static_cast<T>(ty[local_n1] - oy);
+			z1[b1] = static_cast<T>(tz[local_n1] - oz);
 			total_force_x[b1] = 0;
 			total_force_y[b1] = 0;
 			total_force_z[b1] = 0;
 		}
-		for(size_t n2 = 0; n2 < count; n2 += block)
+		for(size_t n2 = 0; n2 < padded_count; n2 += block)
 		{
-			nbcoord_t			x2[block];
-			nbcoord_t			y2[block];
-			nbcoord_t			z2[block];
-			nbcoord_t			m2[block];
+			T			x2[block];
+			T			y2[block];
+			T			z2[block];
+			T			m2[block];
 
 			for(size_t b2 = 0; b2 != block; ++b2)
 			{
 				size_t local_n2 = b2 + n2;
 
-				x2[b2] = rx[local_n2];
-				y2[b2] = ry[local_n2];
-				z2[b2] = rz[local_n2];
-				m2[b2] = mass[n2 + b2];
+				x2[b2] = static_cast<T>(rx[local_n2] - ox);
+				y2[b2] = static_cast<T>(ry[local_n2] - oy);
+				z2[b2] = static_cast<T>(rz[local_n2] - oz);
+				m2[b2] = static_cast<T>(mass[n2 + b2]);
 			}
 
+			T			partial_x[block];
+			T			partial_y[block];
+			T			partial_z[block];
+
+			// In full precision partial sums continue total ones, so summation order is the same as in direct sum
 			for(size_t b1 = 0; b1 != block; ++b1)
 			{
-				for(size_t b2 = 0; b2 != block; ++b2)
+				partial_x[b1] = shift_origin ? 0 : static_cast<T>(total_force_x[b1]);
+				partial_y[b1] = shift_origin ? 0 : static_cast<T>(total_force_y[b1]);
+				partial_z[b1] = shift_origin ? 0 : static_cast<T>(total_force_z[b1]);
+			}
+
+			// Inner loop runs over independent accumulators, so it is vectorized without -ffast-math
+			for(size_t b2 = 0; b2 != block; ++b2)
+			{
+				for(size_t b1 = 0; b1 != block; ++b1)
 				{
-					nbcoord_t		dx = x1[b1] - x2[b2];
-					nbcoord_t		dy = y1[b1] - y2[b2];
-					nbcoord_t		dz = z1[b1] - z2[b2];
-					nbcoord_t		r2(dx * dx + dy * dy + dz * dz);
-					if(r2 < nbody::MinDistance)
-					{
-						r2 = nbody::MinDistance;
-					}
-					nbcoord_t		r = sqrt(r2);
-					nbcoord_t		coeff = (m2[b2]) / (r * r2);
+					T		dx = x1[b1] - x2[b2];
+					T		dy = y1[b1] - y2[b2];
+					T		dz = z1[b1] - z2[b2];
+					// Branchless clamp keeps loop vectorizable
+					T		r2(std::max(dx * dx + dy * dy + dz * dz, min_distance));
+					T		r = sqrt(r2);
+					T		coeff = (m2[b2]) / (r * r2);
 
 					dx *= coeff;
 					dy *= coeff;
 					dz *= coeff;
 
-					total_force_x[b1] -= dx;
-					total_force_y[b1] -= dy;
-					total_force_z[b1] -= dz;
+					partial_x[b1] -= dx;
+					partial_y[b1] -= dy;
+					partial_z[b1] -= dz;
 				}
 			}
+
+			for(size_t b1 = 0; b1 != block; ++b1)
+			{
+				total_force_x[b1] = shift_origin ? total_force_x[b1] + partial_x[b1] : partial_x[b1];
+				total_force_y[b1] = shift_origin ? total_force_y[b1] + partial_y[b1] : partial_y[b1];
+				total_force_z[b1] = shift_origin ? total_force_z[b1] + partial_z[b1] : partial_z[b1];
+			}
 		}
 
-		for(size_t b1 = 0; b1 != block; ++b1)
+		const size_t	b1_end = std::min(block, count - n1);
+		for(size_t b1 = 0; b1 != b1_end; ++b1)
 		{
 			size_t local_n1 = b1 + n1;
-			frx[local_n1] = vx[local_n1];
-			fry[local_n1] = vy[local_n1];
-			frz[local_n1] = vz[local_n1];
 			fvx[local_n1] = total_force_x[b1];
 			fvy[local_n1] = total_force_y[b1];
 			fvz[local_n1] = total_force_z[b1];
 		}
 	}
 }
+
+/*!
+	Block-by-block accelerations and jerks of all 'count' bodies.
+	'p' is padded SoA [x, y, z, vx, vy, vz, mass] with 'padded_count' values each,
+	padding bodies have zero mass. 'f' and 'jerk' are SoA [x, y, z] with 'count' values each.
+ */
+void fcompute_jerk_block(size_t count, size_t padded_count, const nbcoord_t* p, nbcoord_t* f, nbcoord_t* jerk)
+{
+	const size_t		block = NBODY_DATA_BLOCK_SIZE;
+	const nbcoord_t*	rx = p;
+	const nbcoord_t*	ry = p + padded_count;
+	const nbcoord_t*	rz = p + 2 * padded_count;
+	const nbcoord_t*	vx = p + 3 * padded_count;
+	const nbcoord_t*	vy = p + 4 * padded_count;
+	const nbcoord_t*	vz = p + 5 * padded_count;
+	const nbcoord_t*	mass = p + 6 * padded_count;
+
+	#pragma omp parallel for
+	for(size_t n1 = 0; n1 < count; n1 += block)
+	{
+		nbcoord_t	ax[block];
+		nbcoord_t	ay[block];
+		nbcoord_t	az[block];
+		nbcoord_t	jx[block];
+		nbcoord_t	jy[block];
+		nbcoord_t	jz[block];
+
+		for(size_t b1 = 0; b1 != block; ++b1)
+		{
+			ax[b1] = 0;
+			ay[b1] = 0;
+			az[b1] = 0;
+			jx[b1] = 0;
+			jy[b1] = 0;
+			jz[b1] = 0;
+		}
+		for(size_t n2 = 0; n2 < padded_count; n2 += block)
+		{
+			// Inner loop runs over independent accumulators, so it is vectorized without -ffast-math
+			for(size_t b2 = 0; b2 != block; ++b2)
+			{
+				const size_t	local_n2 = b2 + n2;
+				for(size_t b1 = 0; b1 != block; ++b1)
+				{
+					const size_t	local_n1 = b1 + n1;
+					// dx, r2 terms are shared by acceleration and jerk
+					const nbcoord_t	dx = rx[local_n2] - rx[local_n1];
+					const nbcoord_t	dy = ry[local_n2] - ry[local_n1];
+					const nbcoord_t	dz = rz[local_n2] - rz[local_n1];
+					const nbcoord_t	dvx = vx[local_n2] - vx[local_n1];
+					const nbcoord_t	dvy = vy[local_n2] - vy[local_n1];
+					const nbcoord_t	dvz = vz[local_n2] - vz[local_n1];
+					const nbcoord_t	r2(std::max(dx * dx + dy * dy + dz * dz, nbody::MinDistance));
+					const nbcoord_t	rinv2 = 1 / r2;
+					const nbcoord_t	coeff = mass[local_n2] * rinv2 * sqrt(rinv2);
+					const nbcoord_t	rv = 3 * (dx * dvx + dy * dvy + dz * dvz) * rinv2;
+
+					ax[b1] += dx * coeff;
+					ay[b1] += dy * coeff;
+					az[b1] += dz * coeff;
+					jx[b1] += (dvx - dx * rv) * coeff;
+					jy[b1] += (dvy - dy * rv) * coeff;
+					jz[b1] += (dvz - dz * rv) * coeff;
+				}
+			}
+		}
+
+		const size_t	b1_end = std::min(block, count - n1);
+		for(size_t b1 = 0; b1 != b1_end; ++b1)
+		{
+			size_t local_n1 = b1 + n1;
+			f[local_n1] = ax[b1];
+			f[local_n1 + count] = ay[b1];
+			f[local_n1 + 2 * count] = az[b1];
+			jerk[local_n1] = jx[b1];
+			jerk[local_n1 + count] = jy[b1];
+			jerk[local_n1 + 2 * count] = jz[b1];
+		}
+	}
+}
+
+}//namespace
+
+nbody_engine_block::nbody_engine_block(bool mixed_precision) :
+	nbody_engine_openmp(mixed_precision),
+	m_padded_count(0)
+{
+}
+
+const char* nbody_engine_block::type_name() const
+{
+	return "nbody_engine_block";
+}
+
+bool nbody_engine_block::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	// Block kernels are Newtonian only
+	return law == efl_newton && nbody_engine_openmp::set_force_law(law, softening);
+}
+
+void nbody_engine_block::init(nbody_data* data)
+{
+	nbody_engine_openmp::init(data);
+
+	const size_t		block = NBODY_DATA_BLOCK_SIZE;
+	const size_t		count = m_data->get_count();
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	m_padded_count = block * ((count + block - 1) / block);
+	m_padded.assign(4 * m_padded_count, 0);
+	std::copy(mass, mass + count, m_padded.data() + 3 * m_padded_count);
+}
+
+void nbody_engine_block::bodies_reordered(const std::vector<size_t>& order)
+{
+	Q_UNUSED(order);
+
+	const size_t		count = m_data->get_count();
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	std::copy(mass, mass + count, m_padded.data() + 3 * m_padded_count);
+}
+
+void nbody_engine_block::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	size_t				count = m_data->get_count();
+
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+
+	// Padded SoA copy of coordinates. Padding bodies stay at origin with zero mass,
+	// so force kernel runs over whole blocks without tail handling
+	const size_t		padded_count = m_padded_count;
+	nbcoord_t*			px = m_padded.data();
+	nbcoord_t*			py = px + padded_count;
+	nbcoord_t*			pz = px + 2 * padded_count;
+	const nbcoord_t*	pmass = px + 3 * padded_count;
+
+	#pragma omp parallel for
+	for(size_t n = 0; n < count; ++n)
+	{
+		px[n] = rx[n];
+		py[n] = ry[n];
+		pz[n] = rz[n];
+	}
+
+	if(m_mixed_precision)
+	{
+		fcompute_block<float>(count, px, py, pz, padded_count, px, py, pz, pmass, fvx, fvy, fvz);
+	}
+	else
+	{
+		fcompute_block<nbcoord_t>(count, px, py, pz, padded_count, px, py, pz, pmass, fvx, fvy, fvz);
+	}
+}
+
+void nbody_engine_block::fcompute_active(const nbcoord_t& t, const memory* _y, memory* _f,
+										 const std::vector<size_t>& active)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(get_ode_order() != eode_second_order)
+	{
+		qDebug() << "fcompute_active requires second order ODE";
+		return;
+	}
+
+	advise_compute_count(active.size());
+
+	const size_t		block = NBODY_DATA_BLOCK_SIZE;
+	const size_t		count = m_data->get_count();
+	const size_t		active_count = active.size();
+	const size_t		padded_active = block * ((active_count + block - 1) / block);
+
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+
+	nbcoord_t*			fvx = reinterpret_cast<nbcoord_t*>(f->data());
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+
+	const size_t		padded_count = m_padded_count;
+	nbcoord_t*			px = m_padded.data();
+	nbcoord_t*			py = px + padded_count;
+	nbcoord_t*			pz = px + 2 * padded_count;
+	const nbcoord_t*	pmass = px + 3 * padded_count;
+
+	#pragma omp parallel for
+	for(size_t n = 0; n < count; ++n)
+	{
+		px[n] = rx[n];
+		py[n] = ry[n];
+		pz[n] = rz[n];
+	}
+
+	// Active bodies are gathered to padded SoA targets [x, y, z] and their accelerations [ax, ay, az]
+	m_active.assign(6 * padded_active, 0);
+	nbcoord_t*			ax = m_active.data();
+	nbcoord_t*			ay = ax + padded_active;
+	nbcoord_t*			az = ax + 2 * padded_active;
+	nbcoord_t*			afx = ax + 3 * padded_active;
+	nbcoord_t*			afy = ax + 4 * padded_active;
+	nbcoord_t*			afz = ax + 5 * padded_active;
+
+	for(size_t n = 0; n != active_count; ++n)
+	{
+		ax[n] = rx[active[n]];
+		ay[n] = ry[active[n]];
+		az[n] = rz[active[n]];
+	}
+
+	if(m_mixed_precision)
+	{
+		fcompute_block<float>(active_count, ax, ay, az, padded_count, px, py, pz, pmass, afx, afy, afz);
+	}
+	else
+	{
+		fcompute_block<nbcoord_t>(active_count, ax, ay, az, padded_count, px, py, pz, pmass, afx, afy, afz);
+	}
+
+	for(size_t n = 0; n != active_count; ++n)
+	{
+		fvx[active[n]] = afx[n];
+		fvy[active[n]] = afy[n];
+		fvz[active[n]] = afz[n];
+	}
+}
+
+void nbody_engine_block::fcompute_with_jerk(const nbcoord_t& t, const memory* _y, memory* _f, memory* _jerk)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+	smemory*		jerk = dynamic_cast<smemory*>(_jerk);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(jerk == NULL)
+	{
+		qDebug() << "jerk is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	const size_t		count = m_data->get_count();
+	const size_t		padded_count = m_padded_count;
+	const nbcoord_t*	ry = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	// Padded SoA copy of coordinates, velocities and masses
+	m_padded_jerk.resize(7 * padded_count);
+	std::fill(m_padded_jerk.begin(), m_padded_jerk.end(), 0);
+
+	nbcoord_t*			p = m_padded_jerk.data();
+	for(size_t k = 0; k != 6; ++k)
+	{
+		std::copy(ry + k * count, ry + (k + 1) * count, p + k * padded_count);
+	}
+	std::copy(mass, mass + count, p + 6 * padded_count);
+
+	fcompute_jerk_block(count, padded_count, p,
+						reinterpret_cast<nbcoord_t*>(f->data()),
+						reinterpret_cast<nbcoord_t*>(jerk->data()));
+}
@@ -5,10 +5,24 @@
 
 class NBODY_DLL nbody_engine_block : public nbody_engine_openmp
 {
+	//! Padded SoA copy of rx, ry, rz and mass (padding bodies have zero mass)
+	std::vector<nbcoord_t>	m_padded;
+	size_t					m_padded_count;
+	//! Padded SoA buffer of active bodies coordinates and accelerations for fcompute_active
+	std::vector<nbcoord_t>	m_active;
+	//! Padded SoA buffer of coordinates, velocities and masses for fcompute_with_jerk
+	std::vector<nbcoord_t>	m_padded_jerk;
 public:
-	nbody_engine_block();
+	explicit nbody_engine_block(bool mixed_precision = false);
 	const char* type_name() const override;
+	void init(nbody_data* data) override;
 	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
+	void fcompute_with_jerk(const nbcoord_t& t, const memory* y, memory* f, memory* jerk) override;
+	bool set_force_law(e_force_law law, nbcoord_t softening) override;
+protected:
+	void bodies_reordered(const std::vector<size_t>& order) override;
 };
 
 #endif // NBODY_ENGINE_BLOCK_H
@@ -90,6 +90,11 @@ nbody_engine::memory* nbody_engine_cuda::get_y()
 	return m_y;
 }
 
+const nbody_engine::memory* nbody_engine_cuda::get_mass()
+{
+	return m_mass;
+}
+
 void nbody_engine_cuda::advise_time(const nbcoord_t& dt)
 {
 	m_data->advise_time(dt);
@@ -131,6 +136,11 @@ void nbody_engine_cuda::fcompute(const nbcoord_t& t, const memory* _y, memory* _
 		qDebug() << "f is not smemory";
 		return;
 	}
+	if(get_ode_order() != eode_first_order)
+	{
+		qDebug() << "Second order ODE is not supported";
+		return;
+	}
 
 	advise_compute_count();
 
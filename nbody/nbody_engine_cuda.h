@@ -22,6 +22,7 @@ public:
 	void get_data(nbody_data* data) override;
 	size_t problem_size() const override;
 	memory* get_y() override;
+	const memory* get_mass() override;
 	void advise_time(const nbcoord_t& dt) override;
 	nbcoord_t get_time() const override;
 	void set_time(nbcoord_t t) override;
@@ -44,6 +44,11 @@ void nbody_engine_cuda_bh_tex::fcompute(const nbcoord_t& t, const memory* _y, me
 		qDebug() << "f is not smemory";
 		return;
 	}
+	if(get_ode_order() != eode_first_order)
+	{
+		qDebug() << "Second order ODE is not supported";
+		return;
+	}
 
 	advise_compute_count();
 
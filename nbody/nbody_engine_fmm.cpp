@@ -0,0 +1,628 @@
+#include "nbody_engine_fmm.h"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+#include "nbody_space_heap.h"
+
+namespace {
+
+static constexpr size_t	NO_INDEX = std::numeric_limits<size_t>::max();
+static constexpr size_t	MAX_TASK_DEPTH = 8;
+static constexpr size_t	MAX_TARGET_DEPTH = 8;
+
+nbcoord_t binomial(size_t n, size_t k)
+{
+	nbcoord_t	res = 1;
+	for(size_t i = 1; i <= k; ++i)
+	{
+		res = res * static_cast<nbcoord_t>(n + 1 - i) / static_cast<nbcoord_t>(i);
+	}
+	return res;
+}
+
+}//namespace
+
+nbody_engine_fmm::nbody_engine_fmm(size_t order, nbcoord_t distance_to_node_radius_ratio, size_t leaf_size) :
+	m_order(order),
+	m_distance_to_node_radius_ratio(distance_to_node_radius_ratio),
+	m_leaf_size(std::max(leaf_size, static_cast<size_t>(1))),
+	m_heap(new nbody_space_heap())
+{
+	build_plans();
+}
+
+nbody_engine_fmm::~nbody_engine_fmm()
+{
+	delete m_heap;
+}
+
+const char* nbody_engine_fmm::type_name() const
+{
+	return "nbody_engine_fmm";
+}
+
+bool nbody_engine_fmm::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	// Multipole expansions are Newtonian only
+	return law == efl_newton && nbody_engine_openmp::set_force_law(law, softening);
+}
+
+size_t nbody_engine_fmm::term_index(size_t a, size_t b, size_t c) const
+{
+	if(a + b + c > m_order)
+	{
+		return NO_INDEX;
+	}
+	return m_term_index[(a * (m_order + 1) + b) * (m_order + 1) + c];
+}
+
+bool nbody_engine_fmm::is_bucket(size_t idx) const
+{
+	return m_node_count[idx] <= m_leaf_size;
+}
+
+void nbody_engine_fmm::build_plans()
+{
+	const size_t	p = m_order;
+
+	// Terms sorted by degree, so lower degree terms are computed first
+	m_terms.clear();
+	m_term_index.assign((p + 1) * (p + 1) * (p + 1), NO_INDEX);
+	for(size_t degree = 0; degree <= p; ++degree)
+	{
+		for(size_t a = degree + 1; a-- > 0;)
+		{
+			for(size_t b = degree - a + 1; b-- > 0;)
+			{
+				size_t	c = degree - a - b;
+				m_term_index[(a * (p + 1) + b) * (p + 1) + c] = m_terms.size();
+				m_terms.push_back({a, b, c});
+			}
+		}
+	}
+
+	const size_t	terms = m_terms.size();
+
+	m_mono_parent.assign(terms, NO_INDEX);
+	m_mono_axis.assign(terms, 0);
+	for(size_t t = 1; t != terms; ++t)
+	{
+		const term&	n(m_terms[t]);
+		if(n.a > 0)
+		{
+			m_mono_parent[t] = term_index(n.a - 1, n.b, n.c);
+			m_mono_axis[t] = 0;
+		}
+		else if(n.b > 0)
+		{
+			m_mono_parent[t] = term_index(n.a, n.b - 1, n.c);
+			m_mono_axis[t] = 1;
+		}
+		else
+		{
+			m_mono_parent[t] = term_index(n.a, n.b, n.c - 1);
+			m_mono_axis[t] = 2;
+		}
+	}
+
+	for(size_t axis = 0; axis != 3; ++axis)
+	{
+		m_grad_term[axis].assign(terms, NO_INDEX);
+		for(size_t t = 0; t != terms; ++t)
+		{
+			const term&	k(m_terms[t]);
+			m_grad_term[axis][t] = term_index(k.a + (axis == 0 ? 1 : 0),
+											  k.b + (axis == 1 ? 1 : 0),
+											  k.c + (axis == 2 ? 1 : 0));
+		}
+	}
+
+	// T[k] = D^k(1/r)/k! recurrence:
+	// |k|*r^2*T[k] + (2|k| - 1)*Sum(r_i*T[k - e_i]) + (|k| - 1)*Sum(T[k - 2e_i]) = 0
+	m_derivative.assign(terms, derivative());
+	for(size_t t = 1; t != terms; ++t)
+	{
+		const term&		k(m_terms[t]);
+		const size_t	ki[3] = {k.a, k.b, k.c};
+		const size_t	degree = k.a + k.b + k.c;
+		derivative&		d(m_derivative[t]);
+
+		d.axis_count = 0;
+		d.prev2_count = 0;
+		for(size_t axis = 0; axis != 3; ++axis)
+		{
+			if(ki[axis] > 0)
+			{
+				d.axis[d.axis_count] = axis;
+				d.prev[d.axis_count] = term_index(k.a - (axis == 0 ? 1 : 0),
+												  k.b - (axis == 1 ? 1 : 0),
+												  k.c - (axis == 2 ? 1 : 0));
+				++d.axis_count;
+			}
+			if(ki[axis] > 1)
+			{
+				d.prev2[d.prev2_count] = term_index(k.a - (axis == 0 ? 2 : 0),
+													k.b - (axis == 1 ? 2 : 0),
+													k.c - (axis == 2 ? 2 : 0));
+				++d.prev2_count;
+			}
+		}
+		d.c1 = static_cast<nbcoord_t>(2 * degree - 1) / static_cast<nbcoord_t>(degree);
+		d.c2 = static_cast<nbcoord_t>(degree - 1) / static_cast<nbcoord_t>(degree);
+	}
+
+	// M2L: L[k] += (-1)^|n| * C(n + k, n) * M[n] * T[n + k], |n| + |k| <= p
+	m_m2l.clear();
+	for(size_t tk = 0; tk != terms; ++tk)
+	{
+		const term&	k(m_terms[tk]);
+		for(size_t tn = 0; tn != terms; ++tn)
+		{
+			const term&	n(m_terms[tn]);
+			size_t		tnk = term_index(n.a + k.a, n.b + k.b, n.c + k.c);
+			if(tnk == NO_INDEX)
+			{
+				continue;
+			}
+			nbcoord_t	sign = ((n.a + n.b + n.c) % 2 == 0) ? 1 : -1;
+			nbcoord_t	coeff = sign * binomial(n.a + k.a, n.a) * binomial(n.b + k.b, n.b) * binomial(n.c + k.c, n.c);
+			m_m2l.push_back({tk, tn, tnk, coeff});
+		}
+	}
+
+	// Shift: (i = n, j = m, k = n - m, C(n, m)) for all m <= n
+	m_shift.clear();
+	for(size_t tn = 0; tn != terms; ++tn)
+	{
+		const term&	n(m_terms[tn]);
+		for(size_t tm = 0; tm != terms; ++tm)
+		{
+			const term&	m(m_terms[tm]);
+			if(m.a > n.a || m.b > n.b || m.c > n.c)
+			{
+				continue;
+			}
+			nbcoord_t	coeff = binomial(n.a, m.a) * binomial(n.b, m.b) * binomial(n.c, m.c);
+			m_shift.push_back({tn, tm, term_index(n.a - m.a, n.b - m.b, n.c - m.c), coeff});
+		}
+	}
+}
+
+void nbody_engine_fmm::monomials(const nbvertex_t& d, nbcoord_t* mono) const
+{
+	const nbcoord_t	axis[3] = {d.x, d.y, d.z};
+	const size_t	terms = m_terms.size();
+
+	mono[0] = 1;
+	for(size_t t = 1; t != terms; ++t)
+	{
+		mono[t] = mono[m_mono_parent[t]] * axis[m_mono_axis[t]];
+	}
+}
+
+void nbody_engine_fmm::build_nodes(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+								   const nbcoord_t* mass)
+{
+	const std::vector<size_t>&	heap_body_n(m_heap->get_body_n());
+	const size_t				heap_size = heap_body_n.size();
+	const size_t				count = heap_size / 2;
+
+	m_node_count.resize(heap_size);
+	m_node_begin.resize(heap_size);
+	m_node_slot.resize(heap_size);
+
+	// Children have greater indices than parent
+	for(size_t idx = heap_size; idx-- > NBODY_HEAP_ROOT_INDEX;)
+	{
+		m_node_count[idx] = (idx >= count) ? 1 : m_node_count[m_heap->left_idx(idx)] + m_node_count[m_heap->rght_idx(idx)];
+	}
+
+	// Bodies of each subtree are continuous range [begin, begin + count) in leaves order
+	size_t	slot_count = 0;
+	m_node_begin[NBODY_HEAP_ROOT_INDEX] = 0;
+	for(size_t idx = NBODY_HEAP_ROOT_INDEX; idx != heap_size; ++idx)
+	{
+		size_t	parent = m_heap->parent_idx(idx);
+		bool	has_slot = (idx == NBODY_HEAP_ROOT_INDEX) ||
+						   (m_node_slot[parent] != NO_INDEX && !is_bucket(parent));
+		m_node_slot[idx] = has_slot ? slot_count++ : NO_INDEX;
+		if(idx < count)
+		{
+			size_t	left = m_heap->left_idx(idx);
+			m_node_begin[left] = m_node_begin[idx];
+			m_node_begin[m_heap->rght_idx(idx)] = m_node_begin[idx] + m_node_count[left];
+		}
+	}
+
+	m_body_n.resize(count);
+	m_leaf_data.resize(4 * count);
+	nbcoord_t*	px = m_leaf_data.data();
+	nbcoord_t*	py = px + count;
+	nbcoord_t*	pz = px + 2 * count;
+	nbcoord_t*	pm = px + 3 * count;
+
+	#pragma omp parallel for
+	for(size_t idx = count; idx < heap_size; ++idx)
+	{
+		size_t	n = m_node_begin[idx];
+		size_t	body = heap_body_n[idx];
+		m_body_n[n] = body;
+		px[n] = rx[body];
+		py[n] = ry[body];
+		pz[n] = rz[body];
+		pm[n] = mass[body];
+	}
+
+	m_multipole.resize(slot_count * m_terms.size());
+	m_local.resize(slot_count * m_terms.size());
+}
+
+void nbody_engine_fmm::p2m(size_t idx, nbcoord_t* scratch)
+{
+	const size_t		terms = m_terms.size();
+	const size_t		count = m_body_n.size();
+	const nbvertex_t&	center(m_heap->get_mass_center()[idx]);
+	nbcoord_t*			multipole = m_multipole.data() + m_node_slot[idx] * terms;
+	const nbcoord_t*	px = m_leaf_data.data();
+	const nbcoord_t*	py = px + count;
+	const nbcoord_t*	pz = px + 2 * count;
+	const nbcoord_t*	pm = px + 3 * count;
+	const size_t		begin = m_node_begin[idx];
+	const size_t		end = begin + m_node_count[idx];
+
+	std::fill(multipole, multipole + terms, 0);
+	for(size_t n = begin; n != end; ++n)
+	{
+		monomials(nbvertex_t(px[n], py[n], pz[n]) - center, scratch);
+		for(size_t t = 0; t != terms; ++t)
+		{
+			multipole[t] += pm[n] * scratch[t];
+		}
+	}
+}
+
+void nbody_engine_fmm::m2m(size_t idx, nbcoord_t* scratch)
+{
+	const size_t	terms = m_terms.size();
+	nbcoord_t*		multipole = m_multipole.data() + m_node_slot[idx] * terms;
+	const size_t	children[2] = {m_heap->left_idx(idx), m_heap->rght_idx(idx)};
+
+	std::fill(multipole, multipole + terms, 0);
+	for(size_t child : children)
+	{
+		const nbcoord_t*	child_multipole = m_multipole.data() + m_node_slot[child] * terms;
+		monomials(m_heap->get_mass_center()[child] - m_heap->get_mass_center()[idx], scratch);
+		for(const translation& s : m_shift)
+		{
+			multipole[s.i] += s.coeff * child_multipole[s.j] * scratch[s.k];
+		}
+	}
+}
+
+void nbody_engine_fmm::upward(size_t idx, size_t depth)
+{
+	if(is_bucket(idx))
+	{
+		std::vector<nbcoord_t>	scratch(m_terms.size());
+		p2m(idx, scratch.data());
+		return;
+	}
+
+	// Tree is balanced, so first levels have enough work for tasks
+	if(depth < MAX_TASK_DEPTH)
+	{
+		#pragma omp task
+		upward(m_heap->left_idx(idx), depth + 1);
+		#pragma omp task
+		upward(m_heap->rght_idx(idx), depth + 1);
+		#pragma omp taskwait
+	}
+	else
+	{
+		upward(m_heap->left_idx(idx), depth + 1);
+		upward(m_heap->rght_idx(idx), depth + 1);
+	}
+
+	std::vector<nbcoord_t>	scratch(m_terms.size());
+	m2m(idx, scratch.data());
+}
+
+void nbody_engine_fmm::m2l(size_t target, size_t source, nbcoord_t* scratch)
+{
+	const size_t		terms = m_terms.size();
+	const nbvertex_t	r(m_heap->get_mass_center()[target] - m_heap->get_mass_center()[source]);
+	const nbcoord_t		rr[3] = {r.x, r.y, r.z};
+	const nbcoord_t		r2 = r.norm();
+	const nbcoord_t		inv_r2 = 1 / r2;
+	nbcoord_t*			derivatives = scratch;
+
+	derivatives[0] = sqrt(inv_r2);
+	for(size_t t = 1; t != terms; ++t)
+	{
+		const derivative&	d(m_derivative[t]);
+		nbcoord_t			sum1 = 0;
+		nbcoord_t			sum2 = 0;
+		for(size_t n = 0; n != d.axis_count; ++n)
+		{
+			sum1 += rr[d.axis[n]] * derivatives[d.prev[n]];
+		}
+		for(size_t n = 0; n != d.prev2_count; ++n)
+		{
+			sum2 += derivatives[d.prev2[n]];
+		}
+		derivatives[t] = -(d.c1 * sum1 + d.c2 * sum2) * inv_r2;
+	}
+
+	nbcoord_t*			local = m_local.data() + m_node_slot[target] * terms;
+	const nbcoord_t*	multipole = m_multipole.data() + m_node_slot[source] * terms;
+
+	// Plan is sorted by 'i', so each local term is accumulated in register
+	const translation*	plan = m_m2l.data();
+	const translation*	plan_end = plan + m_m2l.size();
+	while(plan != plan_end)
+	{
+		const size_t	i = plan->i;
+		nbcoord_t		sum = 0;
+		for(; plan != plan_end && plan->i == i; ++plan)
+		{
+			sum += plan->coeff * multipole[plan->j] * derivatives[plan->k];
+		}
+		local[i] += sum;
+	}
+}
+
+void nbody_engine_fmm::l2l(size_t idx, nbcoord_t* scratch)
+{
+	const size_t		terms = m_terms.size();
+	const nbcoord_t*	local = m_local.data() + m_node_slot[idx] * terms;
+	const size_t		children[2] = {m_heap->left_idx(idx), m_heap->rght_idx(idx)};
+
+	for(size_t child : children)
+	{
+		nbcoord_t*	child_local = m_local.data() + m_node_slot[child] * terms;
+		monomials(m_heap->get_mass_center()[child] - m_heap->get_mass_center()[idx], scratch);
+		for(const translation& s : m_shift)
+		{
+			child_local[s.j] += s.coeff * local[s.i] * scratch[s.k];
+		}
+	}
+}
+
+void nbody_engine_fmm::l2p(size_t idx, nbcoord_t* acc, nbcoord_t* scratch) const
+{
+	const size_t		terms = m_terms.size();
+	const size_t		count = m_body_n.size();
+	const nbvertex_t&	center(m_heap->get_mass_center()[idx]);
+	const nbcoord_t*	local = m_local.data() + m_node_slot[idx] * terms;
+	const nbcoord_t*	px = m_leaf_data.data();
+	const nbcoord_t*	py = px + count;
+	const nbcoord_t*	pz = px + 2 * count;
+	const size_t		begin = m_node_begin[idx];
+	const size_t		end = begin + m_node_count[idx];
+
+	for(size_t n = begin; n != end; ++n)
+	{
+		monomials(nbvertex_t(px[n], py[n], pz[n]) - center, scratch);
+		for(size_t axis = 0; axis != 3; ++axis)
+		{
+			const size_t*	grad_term = m_grad_term[axis].data();
+			nbcoord_t		total = 0;
+			// d/dx_axis (x^k) = k_axis * x^(k - e_axis)
+			for(size_t t = 0; t != terms; ++t)
+			{
+				if(grad_term[t] != NO_INDEX)
+				{
+					const term&	k(m_terms[t]);
+					size_t		power = (axis == 0 ? k.a : (axis == 1 ? k.b : k.c)) + 1;
+					total += static_cast<nbcoord_t>(power) * local[grad_term[t]] * scratch[t];
+				}
+			}
+			acc[n + axis * count] += total;
+		}
+	}
+}
+
+void nbody_engine_fmm::p2p(size_t target, size_t source, nbcoord_t* acc) const
+{
+	const size_t		count = m_body_n.size();
+	// Local copies of pointers, so stores to accumulators can not alias them
+	const nbcoord_t*	px = m_leaf_data.data();
+	const nbcoord_t*	py = px + count;
+	const nbcoord_t*	pz = px + 2 * count;
+	const nbcoord_t*	pm = px + 3 * count;
+	nbcoord_t*			ax = acc;
+	nbcoord_t*			ay = acc + count;
+	nbcoord_t*			az = acc + 2 * count;
+	const nbcoord_t		min_distance(nbody::MinDistance);
+	const size_t		tb = m_node_begin[target];
+	const size_t		te = tb + m_node_count[target];
+	const size_t		sb = m_node_begin[source];
+	const size_t		se = sb + m_node_count[source];
+
+	for(size_t n1 = tb; n1 != te; ++n1)
+	{
+		const nbcoord_t	x1 = px[n1];
+		const nbcoord_t	y1 = py[n1];
+		const nbcoord_t	z1 = pz[n1];
+		nbcoord_t		total_x = 0;
+		nbcoord_t		total_y = 0;
+		nbcoord_t		total_z = 0;
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+		#pragma omp simd reduction(+:total_x, total_y, total_z)
+#endif
+		for(size_t n2 = sb; n2 < se; ++n2)
+		{
+			// Self interaction gives zero, because dx = dy = dz = 0
+			const nbcoord_t	dx = px[n2] - x1;
+			const nbcoord_t	dy = py[n2] - y1;
+			const nbcoord_t	dz = pz[n2] - z1;
+			const nbcoord_t	r2(std::max(dx * dx + dy * dy + dz * dz, min_distance));
+			const nbcoord_t	coeff = pm[n2] / (r2 * sqrt(r2));
+
+			total_x += dx * coeff;
+			total_y += dy * coeff;
+			total_z += dz * coeff;
+		}
+		ax[n1] += total_x;
+		ay[n1] += total_y;
+		az[n1] += total_z;
+	}
+}
+
+void nbody_engine_fmm::interact(size_t target, size_t source, nbcoord_t* acc, nbcoord_t* scratch)
+{
+	const std::vector<nbvertex_t>&	mass_center(m_heap->get_mass_center());
+	const std::vector<nbcoord_t>&	radius_sqr(m_heap->get_radius_sqr());
+	const nbcoord_t					rt = sqrt(radius_sqr[target]);
+	const nbcoord_t					rs = sqrt(radius_sqr[source]);
+
+	if(target != source)
+	{
+		const nbcoord_t	distance_sqr((mass_center[target] - mass_center[source]).norm());
+		const nbcoord_t	max_radius = m_distance_to_node_radius_ratio * (rt + rs);
+		if(distance_sqr > max_radius * max_radius)
+		{
+			m2l(target, source, scratch);
+			return;
+		}
+	}
+
+	const bool	target_bucket = is_bucket(target);
+	const bool	source_bucket = is_bucket(source);
+
+	if(target_bucket && source_bucket)
+	{
+		p2p(target, source, acc);
+	}
+	else if(source_bucket || (!target_bucket && rt >= rs))
+	{
+		interact(m_heap->left_idx(target), source, acc, scratch);
+		interact(m_heap->rght_idx(target), source, acc, scratch);
+	}
+	else
+	{
+		interact(target, m_heap->left_idx(source), acc, scratch);
+		interact(target, m_heap->rght_idx(source), acc, scratch);
+	}
+}
+
+void nbody_engine_fmm::downward(size_t idx, nbcoord_t* acc, nbcoord_t* scratch)
+{
+	if(is_bucket(idx))
+	{
+		l2p(idx, acc, scratch);
+		return;
+	}
+	l2l(idx, scratch);
+	downward(m_heap->left_idx(idx), acc, scratch);
+	downward(m_heap->rght_idx(idx), acc, scratch);
+}
+
+void nbody_engine_fmm::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	if(count == 0)
+	{
+		return;
+	}
+
+	// Node radius is used as is, so ratio is 1 here
+	m_heap->build(count, rx, ry, rz, mass, 1);
+	build_nodes(rx, ry, rz, mass);
+
+	#pragma omp parallel
+	#pragma omp single
+	upward(NBODY_HEAP_ROOT_INDEX, 0);
+
+	// Subtrees of target nodes are independent, so each target walks the tree in own thread.
+	// Targets do not depend on threads count, so result is the same for any threads count
+	std::vector<size_t>	targets;
+	for(size_t idx = NBODY_HEAP_ROOT_INDEX; idx != m_node_slot.size(); ++idx)
+	{
+		if(m_node_slot[idx] == NO_INDEX)
+		{
+			continue;
+		}
+		size_t	level = 0;
+		for(size_t i = idx; i > NBODY_HEAP_ROOT_INDEX; i = m_heap->parent_idx(i))
+		{
+			++level;
+		}
+		if(level == MAX_TARGET_DEPTH || (level < MAX_TARGET_DEPTH && is_bucket(idx)))
+		{
+			targets.push_back(idx);
+		}
+	}
+
+	std::fill(m_local.begin(), m_local.end(), 0);
+	std::vector<nbcoord_t>	acc(3 * count, 0);
+
+	#pragma omp parallel
+	{
+		std::vector<nbcoord_t>	scratch(m_terms.size());
+
+		#pragma omp for schedule(dynamic, 1)
+		for(size_t n = 0; n < targets.size(); ++n)
+		{
+			interact(targets[n], NBODY_HEAP_ROOT_INDEX, acc.data(), scratch.data());
+			downward(targets[n], acc.data(), scratch.data());
+		}
+	}
+
+	const nbcoord_t*	ax = acc.data();
+	const nbcoord_t*	ay = ax + count;
+	const nbcoord_t*	az = ax + 2 * count;
+
+	#pragma omp parallel for
+	for(size_t n = 0; n < count; ++n)
+	{
+		size_t	body = m_body_n[n];
+		fvx[body] = ax[n];
+		fvy[body] = ay[n];
+		fvz[body] = az[n];
+	}
+}
+
+void nbody_engine_fmm::fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+							 const std::vector<size_t>& active)
+{
+	// Expansions are built for all bodies, so use generic implementation to keep
+	// accelerations of active subset consistent with fcompute
+	nbody_engine::fcompute_active(t, y, f, active);
+}
+
+void nbody_engine_fmm::print_info() const
+{
+	nbody_engine_openmp::print_info();
+	qDebug() << "\torder:" << m_order;
+	qDebug() << "\tdistance_to_node_radius_ratio:" << m_distance_to_node_radius_ratio;
+	qDebug() << "\tleaf_size:" << m_leaf_size;
+}
@@ -0,0 +1,100 @@
+#ifndef NBODY_ENGINE_FMM_H
+#define NBODY_ENGINE_FMM_H
+
+#include "nbody_engine_openmp.h"
+
+class nbody_space_heap;
+
+/*!
+	Fast multipole method with Cartesian Taylor expansions of order 'p' on top of nbody_space_heap.
+	Multipole moments are computed at node mass centers (upward pass, P2M + M2M).
+	Each target subtree walks the tree (dual tree traversal): well separated node pairs
+	(|z_a - z_b| > distance_to_node_radius_ratio * (r_a + r_b)) are translated to local expansions (M2L),
+	close pairs of leaf buckets with at most 'leaf_size' bodies are computed directly (P2P).
+	Local expansions are shifted down to buckets and evaluated at bodies (downward pass, L2L + L2P).
+ */
+class NBODY_DLL nbody_engine_fmm : public nbody_engine_openmp
+{
+	//! Cartesian multi-index (a, b, c) => x^a y^b z^c
+	struct term
+	{
+		size_t	a, b, c;
+	};
+	//! dst[i] += coeff * src1[j] * src2[k]
+	struct translation
+	{
+		size_t		i, j, k;
+		nbcoord_t	coeff;
+	};
+	//! T[k] = -(c1 * Sum(r[axis] * T[k - e_axis]) + c2 * Sum(T[k - 2e_axis])) / r^2
+	struct derivative
+	{
+		size_t		axis_count;
+		size_t		axis[3];
+		size_t		prev[3];
+		size_t		prev2_count;
+		size_t		prev2[3];
+		nbcoord_t	c1, c2;
+	};
+
+	size_t						m_order;
+	nbcoord_t					m_distance_to_node_radius_ratio;
+	size_t						m_leaf_size;
+	nbody_space_heap*			m_heap;
+
+	// Expansion plans, depend on 'm_order' only
+	std::vector<term>			m_terms;
+	std::vector<size_t>			m_term_index;
+	std::vector<size_t>			m_mono_parent;
+	std::vector<size_t>			m_mono_axis;
+	std::vector<size_t>			m_grad_term[3];
+	std::vector<derivative>		m_derivative;
+	std::vector<translation>	m_m2l;
+	std::vector<translation>	m_shift;
+
+	// Per node data, indexed by heap index
+	std::vector<size_t>			m_node_begin;
+	std::vector<size_t>			m_node_count;
+	std::vector<size_t>			m_node_slot;
+	// Expansions of nodes with assigned 'm_node_slot', m_terms.size() values per node
+	std::vector<nbcoord_t>		m_multipole;
+	std::vector<nbcoord_t>		m_local;
+
+	// Bodies in tree leaves order
+	std::vector<size_t>			m_body_n;
+	std::vector<nbcoord_t>		m_leaf_data;
+public:
+	/*!
+		\param order - expansion order 'p'
+		\param distance_to_node_radius_ratio - nodes are well separated if distance between centers
+		is greater than this ratio multiplied to sum of nodes radiuses
+		\param leaf_size - maximum bodies count at leaf bucket
+	 */
+	explicit nbody_engine_fmm(size_t order = 4, nbcoord_t distance_to_node_radius_ratio = 2,
+							  size_t leaf_size = 16);
+	~nbody_engine_fmm();
+	const char* type_name() const override;
+	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
+	void print_info() const override;
+	bool set_force_law(e_force_law law, nbcoord_t softening) override;
+private:
+	size_t term_index(size_t a, size_t b, size_t c) const;
+	bool is_bucket(size_t idx) const;
+	void build_plans();
+	void build_nodes(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz, const nbcoord_t* mass);
+	void upward(size_t idx, size_t depth);
+	void interact(size_t target, size_t source, nbcoord_t* acc, nbcoord_t* scratch);
+	void downward(size_t idx, nbcoord_t* acc, nbcoord_t* scratch);
+	void p2m(size_t idx, nbcoord_t* scratch);
+	void m2m(size_t idx, nbcoord_t* scratch);
+	void m2l(size_t target, size_t source, nbcoord_t* scratch);
+	void l2l(size_t idx, nbcoord_t* scratch);
+	void l2p(size_t idx, nbcoord_t* acc, nbcoord_t* scratch) const;
+	void p2p(size_t target, size_t source, nbcoord_t* acc) const;
+	//! mono[t] = d^t for all terms
+	void monomials(const nbvertex_t& d, nbcoord_t* mono) const;
+};
+
+#endif // NBODY_ENGINE_FMM_H
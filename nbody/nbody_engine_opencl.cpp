@@ -502,6 +502,11 @@ void nbody_engine_opencl::fcompute(const nbcoord_t& t, const memory* _y, memory*
 		qDebug() << "f is not smemory";
 		return;
 	}
+	if(get_ode_order() != eode_first_order)
+	{
+		qDebug() << "Second order ODE is not supported";
+		return;
+	}
 
 	if(d->m_devices.empty())
 	{
@@ -596,6 +601,11 @@ void nbody_engine_opencl::fcompute_bh_impl(const nbcoord_t& t, const memory* _y,
 		qDebug() << "f is not smemory";
 		return;
 	}
+	if(get_ode_order() != eode_first_order)
+	{
+		qDebug() << "Second order ODE is not supported";
+		return;
+	}
 
 	if(d->m_devices.empty())
 	{
@@ -1,9 +1,11 @@
 #include "nbody_engine_openmp.h"
 #include <QDebug>
 #include <omp.h>
+#include <typeinfo>
 #include "summation.h"
 
-nbody_engine_openmp::nbody_engine_openmp()
+nbody_engine_openmp::nbody_engine_openmp(bool mixed_precision) :
+	m_mixed_precision(mixed_precision)
 {
 }
 
@@ -16,6 +18,46 @@ const char* nbody_engine_openmp::type_name() const
 	return "nbody_engine_openmp";
 }
 
+namespace {
+
+//! Direct sum acceleration of 'body1', pairwise terms are computed in float
+nbvertex_t direct_acceleration_mixed(size_t body1, size_t count, const nbcoord_t* rx,
+									 const nbcoord_t* mass)
+{
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+	const nbcoord_t		x1 = rx[body1];
+	const nbcoord_t		y1 = ry[body1];
+	const nbcoord_t		z1 = rz[body1];
+	nbcoord_t			total_force_x = 0;
+	nbcoord_t			total_force_y = 0;
+	nbcoord_t			total_force_z = 0;
+	for(size_t body2 = 0; body2 != count; ++body2)
+	{
+		if(body1 == body2)
+		{
+			continue;
+		}
+		const float		dx = static_cast<float>(rx[body2] - x1);
+		const float		dy = static_cast<float>(ry[body2] - y1);
+		const float		dz = static_cast<float>(rz[body2] - z1);
+		float			r2(dx * dx + dy * dy + dz * dz);
+		if(r2 < static_cast<float>(nbody::MinDistance))
+		{
+			r2 = static_cast<float>(nbody::MinDistance);
+		}
+		const float		rinv = 1.0f / std::sqrt(r2);
+		const float		coeff = static_cast<float>(mass[body2]) * rinv * rinv * rinv;
+
+		total_force_x += dx * coeff;
+		total_force_y += dy * coeff;
+		total_force_z += dz * coeff;
+	}
+	return nbvertex_t(total_force_x, total_force_y, total_force_z);
+}
+
+}//namespace
+
 void nbody_engine_openmp::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
 {
 	Q_UNUSED(t);
@@ -37,42 +79,114 @@ void nbody_engine_openmp::fcompute(const nbcoord_t& t, const memory* _y, memory*
 
 	size_t				count = m_data->get_count();
 	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
-	const nbcoord_t*	ry = rx + count;
-	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
 
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
 
 	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
 
 	#pragma omp parallel for
 	for(size_t body1 = 0; body1 < count; ++body1)
 	{
-		const nbvertex_t	v1(rx[ body1 ], ry[ body1 ], rz[ body1 ]);
-		nbvertex_t			total_force;
-		for(size_t body2 = 0; body2 != count; ++body2)
-		{
-			if(body1 == body2)
-			{
-				continue;
-			}
-			const nbvertex_t	v2(rx[ body2 ], ry[ body2 ], rz[ body2 ]);
-			const nbvertex_t	force(m_data->force(v1, v2, mass[body1], mass[body2]));
-			total_force += force;
-		}
-		frx[body1] = vx[body1];
-		fry[body1] = vy[body1];
-		frz[body1] = vz[body1];
-		fvx[body1] = total_force.x / mass[body1];
-		fvy[body1] = total_force.y / mass[body1];
-		fvz[body1] = total_force.z / mass[body1];
+		const nbvertex_t	total(m_mixed_precision ?
+								  direct_acceleration_mixed(body1, count, rx, mass) :
+								  direct_acceleration(body1, rx));
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
+	}
+}
+
+void nbody_engine_openmp::fcompute_active(const nbcoord_t& t, const memory* _y, memory* _f,
+										  const std::vector<size_t>& active)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(get_ode_order() != eode_second_order)
+	{
+		qDebug() << "fcompute_active requires second order ODE";
+		return;
+	}
+
+	advise_compute_count(active.size());
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	nbcoord_t*			fvx = reinterpret_cast<nbcoord_t*>(f->data());
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	const size_t		active_count = active.size();
+
+	#pragma omp parallel for
+	for(size_t n = 0; n < active_count; ++n)
+	{
+		const size_t		body1 = active[n];
+		const nbvertex_t	total(m_mixed_precision ?
+								  direct_acceleration_mixed(body1, count, rx, mass) :
+								  direct_acceleration(body1, rx));
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
+	}
+}
+
+void nbody_engine_openmp::fcompute_with_jerk(const nbcoord_t& t, const memory* _y, memory* _f, memory* _jerk)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+	smemory*		jerk = dynamic_cast<smemory*>(_jerk);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(jerk == NULL)
+	{
+		qDebug() << "jerk is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	ry = reinterpret_cast<const nbcoord_t*>(y->data());
+	nbcoord_t*			fx = reinterpret_cast<nbcoord_t*>(f->data());
+	nbcoord_t*			jx = reinterpret_cast<nbcoord_t*>(jerk->data());
+
+	// Mixed precision is used by fcompute only
+	#pragma omp parallel for
+	for(size_t body1 = 0; body1 < count; ++body1)
+	{
+		nbvertex_t	acc;
+		nbvertex_t	j;
+		direct_acceleration_jerk(body1, ry, acc, j);
+		fx[body1] = acc.x;
+		fx[body1 + count] = acc.y;
+		fx[body1 + 2 * count] = acc.z;
+		jx[body1] = j.x;
+		jx[body1 + count] = j.y;
+		jx[body1 + 2 * count] = j.z;
 	}
 }
 
@@ -184,6 +298,44 @@ void nbody_engine_openmp::fmadd(memory* __a, const memory* __b, const memory* __
 	}
 }
 
+void nbody_engine_openmp::fmaddn_inplace(memory* __a, const memory_array& __b,
+										 const nbcoord_t* c, size_t csize)
+{
+	smemory*	_a = dynamic_cast<smemory*>(__a);
+	if(_a == nullptr)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(c == nullptr)
+	{
+		return;
+	}
+	if(csize > __b.size())
+	{
+		qDebug() << "csize > b.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	b;
+	if(!buffers_data(__b, csize, b))
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+
+	nbcoord_t*				a = reinterpret_cast<nbcoord_t*>(_a->data());
+	const nbcoord_t* const*	bdata = b.data();
+	size_t					count = problem_size();
+
+	// One contiguous range per thread, so each thread reads all 'b' buffers once
+	#pragma omp parallel
+	{
+		size_t	threads = static_cast<size_t>(omp_get_num_threads());
+		size_t	thread = static_cast<size_t>(omp_get_thread_num());
+		fmaddn_range(a, a, bdata, c, csize, (count * thread) / threads, (count * (thread + 1)) / threads);
+	}
+}
+
 void nbody_engine_openmp::fmaddn_corr(memory* __a, memory* __corr, const memory_array& __b,
 									  const nbcoord_t* c, size_t csize)
 {
@@ -237,6 +389,107 @@ void nbody_engine_openmp::fmaddn_corr(memory* __a, memory* __corr, const memory_
 	}
 }
 
+void nbody_engine_openmp::fmaddn(memory* __a, const memory* __b, const memory_array& __c,
+								 const nbcoord_t* d, size_t dsize)
+{
+	smemory*		_a = dynamic_cast<smemory*>(__a);
+	const smemory*	_b = dynamic_cast<const smemory*>(__b);
+	if(_a == nullptr)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(__b != nullptr && _b == nullptr)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+	if(d == nullptr)
+	{
+		qDebug() << "d == NULL";
+		return;
+	}
+	if(dsize > __c.size())
+	{
+		qDebug() << "dsize > c.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	c;
+	if(!buffers_data(__c, dsize, c))
+	{
+		qDebug() << "c is not smemory";
+		return;
+	}
+
+	nbcoord_t*				a = reinterpret_cast<nbcoord_t*>(_a->data());
+	const nbcoord_t*		b = (_b == nullptr) ? nullptr : reinterpret_cast<const nbcoord_t*>(_b->data());
+	const nbcoord_t* const*	cdata = c.data();
+	size_t					count = problem_size();
+
+	#pragma omp parallel
+	{
+		size_t	threads = static_cast<size_t>(omp_get_num_threads());
+		size_t	thread = static_cast<size_t>(omp_get_thread_num());
+		fmaddn_range(a, b, cdata, d, dsize, (count * thread) / threads, (count * (thread + 1)) / threads);
+	}
+}
+
+void nbody_engine_openmp::fmaddn_second_order(memory* __a, const memory* __b, const memory_array& __c,
+											   const nbcoord_t& e, const nbcoord_t* dx, const nbcoord_t* dv,
+											   size_t csize)
+{
+	smemory*		_a = dynamic_cast<smemory*>(__a);
+	const smemory*	_b = dynamic_cast<const smemory*>(__b);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(__b != NULL && _b == NULL)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+	if(csize > __c.size())
+	{
+		qDebug() << "csize > c.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	c;
+	for(size_t k = 0; k != csize; ++k)
+	{
+		const smemory* _c = dynamic_cast<const smemory*>(__c[k]);
+		if(_c == NULL)
+		{
+			qDebug() << "c is not smemory";
+			return;
+		}
+		c.push_back(reinterpret_cast<const nbcoord_t*>(_c->data()));
+	}
+
+	size_t				half = problem_size() / 2;
+	nbcoord_t*			ax = reinterpret_cast<nbcoord_t*>(_a->data());
+	nbcoord_t*			av = ax + half;
+	const nbcoord_t*	bx = (_b == NULL) ? NULL : reinterpret_cast<const nbcoord_t*>(_b->data());
+	const nbcoord_t*	bv = (_b == NULL) ? NULL : bx + half;
+	const nbcoord_t* const*	cdata = c.data();
+
+	#pragma omp parallel for
+	for(size_t i = 0; i < half; ++i)
+	{
+		nbcoord_t	x = (bx == NULL) ? 0 : bx[i] + bv[i] * e;
+		nbcoord_t	v = (bv == NULL) ? 0 : bv[i];
+		for(size_t k = 0; k < csize; ++k)
+		{
+			x += cdata[k][i] * dx[k];
+			v += cdata[k][i] * dv[k];
+		}
+		ax[i] = x;
+		av[i] = v;
+	}
+}
+
 void nbody_engine_openmp::fmaxabs(const nbody_engine::memory* __a, nbcoord_t& result)
 {
 	const smemory*		_a = dynamic_cast<const smemory*>(__a);
@@ -265,7 +518,95 @@ void nbody_engine_openmp::fmaxabs(const nbody_engine::memory* __a, nbcoord_t& re
 	}
 }
 
+void nbody_engine_openmp::fweighted_rms(const nbody_engine::memory* __a, const nbody_engine::memory* __y,
+										const nbcoord_t& atol, const nbcoord_t& rtol, nbcoord_t& result)
+{
+	const smemory*		_a = dynamic_cast<const smemory*>(__a);
+	const smemory*		_y = dynamic_cast<const smemory*>(__y);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(_y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+
+	const nbcoord_t*	a = reinterpret_cast<const nbcoord_t*>(_a->data());
+	const nbcoord_t*	y = reinterpret_cast<const nbcoord_t*>(_y->data());
+	size_t				count = problem_size();
+	nbcoord_t			sum = 0;
+
+	#pragma omp parallel for reduction( + : sum )
+	for(size_t n = 0; n < count; ++n)
+	{
+		const nbcoord_t	e = a[n] / (atol + rtol * fabs(y[n]));
+		sum += e * e;
+	}
+	result = sqrt(sum / static_cast<nbcoord_t>(count));
+}
+
+void nbody_engine_openmp::fdot(const nbody_engine::memory* __a, const nbody_engine::memory* __b, nbcoord_t& result)
+{
+	const smemory*		_a = dynamic_cast<const smemory*>(__a);
+	const smemory*		_b = dynamic_cast<const smemory*>(__b);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(_b == NULL)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+
+	const nbcoord_t*	a = reinterpret_cast<const nbcoord_t*>(_a->data());
+	const nbcoord_t*	b = reinterpret_cast<const nbcoord_t*>(_b->data());
+	size_t				count = problem_size();
+	nbcoord_t			sum = 0;
+
+	#pragma omp parallel for reduction( + : sum )
+	for(size_t n = 0; n < count; ++n)
+	{
+		sum += a[n] * b[n];
+	}
+	result = sum;
+}
+
+nbody_engine* nbody_engine_openmp::clone()
+{
+	if(typeid(*this) != typeid(nbody_engine_openmp))
+	{
+		return NULL;
+	}
+	nbody_engine_openmp*	e = new nbody_engine_openmp(m_mixed_precision);
+	e->init_clone(this);
+	return e;
+}
+
 void nbody_engine_openmp::print_info() const
 {
+	nbody_engine_simple::print_info();
 	qDebug() << "\tOpenMP max threads:" << omp_get_max_threads();
+	qDebug() << "\tmixed_precision:" << m_mixed_precision;
+}
+
+bool nbody_engine_openmp::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	// Mixed precision kernel is Newtonian only
+	if(m_mixed_precision && law != efl_newton)
+	{
+		return false;
+	}
+	return nbody_engine_simple::set_force_law(law, softening);
+}
+
+bool nbody_engine_openmp::is_mixed_precision() const
+{
+	return m_mixed_precision;
 }
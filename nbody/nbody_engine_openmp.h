@@ -5,23 +5,49 @@
 
 class NBODY_DLL nbody_engine_openmp : public nbody_engine_simple
 {
+protected:
+	bool	m_mixed_precision;
 public:
-	nbody_engine_openmp();
+	/*!
+		\param mixed_precision - compute pairwise terms (dx, dy, dz, r2, 1/r^3) in float
+		and accumulate total force in nbcoord_t
+	 */
+	explicit nbody_engine_openmp(bool mixed_precision = false);
 	~nbody_engine_openmp();
 
 	const char* type_name() const override;
 
 	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
+	void fcompute_with_jerk(const nbcoord_t& t, const memory* y, memory* f, memory* jerk) override;
 
 	void copy_buffer(memory* a, const memory* b) override;
 	void fill_buffer(memory* a, const nbcoord_t& value) override;
 	void fmadd_inplace(memory* a, const memory* b, const nbcoord_t& c) override;
 	void fmadd(memory* a, const memory* b, const memory* c, const nbcoord_t& d) override;
+	void fmaddn_inplace(memory* a, const memory_array& b,
+						const nbcoord_t* c, size_t csize) override;
 	void fmaddn_corr(memory* a, memory* corr, const memory_array& b,
 					 const nbcoord_t* c, size_t csize) override;
+	void fmaddn(memory* a, const memory* b, const memory_array& c,
+				const nbcoord_t* d, size_t dsize) override;
+	void fmaddn_second_order(memory* a, const memory* b, const memory_array& c, const nbcoord_t& e,
+							 const nbcoord_t* dx, const nbcoord_t* dv, size_t csize) override;
 	void fmaxabs(const memory* a, nbcoord_t& result) override;
+	void fweighted_rms(const memory* a, const memory* y, const nbcoord_t& atol, const nbcoord_t& rtol,
+					   nbcoord_t& result) override;
+	void fdot(const memory* a, const memory* b, nbcoord_t& result) override;
+	/*!
+		Supported only by nbody_engine_openmp itself. Clone called from OpenMP parallel region
+		computes at calling thread, because nested parallelism is off by default.
+	 */
+	nbody_engine* clone() override;
 
 	void print_info() const override;
+	bool set_force_law(e_force_law law, nbcoord_t softening) override;
+
+	bool is_mixed_precision() const;
 };
 
 #endif // NBODY_ENGINE_SIMPLE_H
@@ -0,0 +1,391 @@
+#include "nbody_engine_simd.h"
+#include <omp.h>
+#include <QDebug>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && NB_COORD_PRECISION == 2
+#define NBODY_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif //_MSC_VER
+#if defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1911)
+#define NBODY_SIMD_AVX512
+#endif
+#endif
+
+// GCC and clang need per-function target to emit AVX2/AVX-512 code
+// without global '-m<isa>' flags. MSVC accepts intrinsics anywhere.
+#if defined(__GNUC__)
+#define NBODY_SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NBODY_SIMD_TARGET(isa)
+#endif
+
+namespace {
+
+struct simd_kernel_args
+{
+	size_t				count;
+	const nbcoord_t*	rx;
+	const nbcoord_t*	ry;
+	const nbcoord_t*	rz;
+	const nbcoord_t*	mass;
+	nbcoord_t*			fvx;
+	nbcoord_t*			fvy;
+	nbcoord_t*			fvz;
+};
+
+typedef void (*simd_kernel)(const simd_kernel_args& a, size_t begin, size_t end);
+
+//! Compute acceleration for bodies [begin, end)
+void kernel_scalar(const simd_kernel_args& a, size_t begin, size_t end)
+{
+	for(size_t body1 = begin; body1 < end; ++body1)
+	{
+		const nbcoord_t	x1 = a.rx[body1];
+		const nbcoord_t	y1 = a.ry[body1];
+		const nbcoord_t	z1 = a.rz[body1];
+		nbcoord_t		total_force_x = 0;
+		nbcoord_t		total_force_y = 0;
+		nbcoord_t		total_force_z = 0;
+
+		for(size_t body2 = 0; body2 != a.count; ++body2)
+		{
+			nbcoord_t		dx = a.rx[body2] - x1;
+			nbcoord_t		dy = a.ry[body2] - y1;
+			nbcoord_t		dz = a.rz[body2] - z1;
+			nbcoord_t		r2(dx * dx + dy * dy + dz * dz);
+			if(r2 < nbody::MinDistance)
+			{
+				r2 = nbody::MinDistance;
+			}
+			nbcoord_t		coeff = a.mass[body2] / (r2 * sqrt(r2));
+
+			total_force_x += dx * coeff;
+			total_force_y += dy * coeff;
+			total_force_z += dz * coeff;
+		}
+		a.fvx[body1] = total_force_x;
+		a.fvy[body1] = total_force_y;
+		a.fvz[body1] = total_force_z;
+	}
+}
+
+#ifdef NBODY_SIMD_X86
+NBODY_SIMD_TARGET("sse2")
+void kernel_sse2(const simd_kernel_args& a, size_t begin, size_t end)
+{
+	const size_t	width = 2;
+	const __m128d	min_distance(_mm_set1_pd(nbody::MinDistance));
+	size_t			body1 = begin;
+
+	for(; body1 + width <= end; body1 += width)
+	{
+		const __m128d	x1(_mm_loadu_pd(a.rx + body1));
+		const __m128d	y1(_mm_loadu_pd(a.ry + body1));
+		const __m128d	z1(_mm_loadu_pd(a.rz + body1));
+		__m128d			total_force_x(_mm_setzero_pd());
+		__m128d			total_force_y(_mm_setzero_pd());
+		__m128d			total_force_z(_mm_setzero_pd());
+
+		for(size_t body2 = 0; body2 != a.count; ++body2)
+		{
+			const __m128d	dx(_mm_sub_pd(_mm_set1_pd(a.rx[body2]), x1));
+			const __m128d	dy(_mm_sub_pd(_mm_set1_pd(a.ry[body2]), y1));
+			const __m128d	dz(_mm_sub_pd(_mm_set1_pd(a.rz[body2]), z1));
+			__m128d			r2(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)),
+										  _mm_mul_pd(dz, dz)));
+			r2 = _mm_max_pd(r2, min_distance);
+			const __m128d	coeff(_mm_div_pd(_mm_set1_pd(a.mass[body2]),
+											 _mm_mul_pd(r2, _mm_sqrt_pd(r2))));
+
+			total_force_x = _mm_add_pd(total_force_x, _mm_mul_pd(dx, coeff));
+			total_force_y = _mm_add_pd(total_force_y, _mm_mul_pd(dy, coeff));
+			total_force_z = _mm_add_pd(total_force_z, _mm_mul_pd(dz, coeff));
+		}
+		_mm_storeu_pd(a.fvx + body1, total_force_x);
+		_mm_storeu_pd(a.fvy + body1, total_force_y);
+		_mm_storeu_pd(a.fvz + body1, total_force_z);
+	}
+	kernel_scalar(a, body1, end);
+}
+
+NBODY_SIMD_TARGET("avx2,fma")
+void kernel_avx2(const simd_kernel_args& a, size_t begin, size_t end)
+{
+	const size_t	width = 4;
+	const __m256d	min_distance(_mm256_set1_pd(nbody::MinDistance));
+	size_t			body1 = begin;
+
+	for(; body1 + width <= end; body1 += width)
+	{
+		const __m256d	x1(_mm256_loadu_pd(a.rx + body1));
+		const __m256d	y1(_mm256_loadu_pd(a.ry + body1));
+		const __m256d	z1(_mm256_loadu_pd(a.rz + body1));
+		__m256d			total_force_x(_mm256_setzero_pd());
+		__m256d			total_force_y(_mm256_setzero_pd());
+		__m256d			total_force_z(_mm256_setzero_pd());
+
+		for(size_t body2 = 0; body2 != a.count; ++body2)
+		{
+			const __m256d	dx(_mm256_sub_pd(_mm256_broadcast_sd(a.rx + body2), x1));
+			const __m256d	dy(_mm256_sub_pd(_mm256_broadcast_sd(a.ry + body2), y1));
+			const __m256d	dz(_mm256_sub_pd(_mm256_broadcast_sd(a.rz + body2), z1));
+			__m256d			r2(_mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx))));
+			r2 = _mm256_max_pd(r2, min_distance);
+			const __m256d	coeff(_mm256_div_pd(_mm256_broadcast_sd(a.mass + body2),
+												_mm256_mul_pd(r2, _mm256_sqrt_pd(r2))));
+
+			total_force_x = _mm256_fmadd_pd(dx, coeff, total_force_x);
+			total_force_y = _mm256_fmadd_pd(dy, coeff, total_force_y);
+			total_force_z = _mm256_fmadd_pd(dz, coeff, total_force_z);
+		}
+		_mm256_storeu_pd(a.fvx + body1, total_force_x);
+		_mm256_storeu_pd(a.fvy + body1, total_force_y);
+		_mm256_storeu_pd(a.fvz + body1, total_force_z);
+	}
+	kernel_sse2(a, body1, end);
+}
+#endif //NBODY_SIMD_X86
+
+#ifdef NBODY_SIMD_AVX512
+NBODY_SIMD_TARGET("avx512f")
+void kernel_avx512(const simd_kernel_args& a, size_t begin, size_t end)
+{
+	const size_t	width = 8;
+	const __m512d	min_distance(_mm512_set1_pd(nbody::MinDistance));
+	// Zero-masked forms of max/sqrt avoid GCC 'maybe-uninitialized' false positive
+	// for _mm512_undefined_pd() inside unmasked intrinsics
+	const __mmask8	all = 0xff;
+	size_t			body1 = begin;
+
+	for(; body1 + width <= end; body1 += width)
+	{
+		const __m512d	x1(_mm512_loadu_pd(a.rx + body1));
+		const __m512d	y1(_mm512_loadu_pd(a.ry + body1));
+		const __m512d	z1(_mm512_loadu_pd(a.rz + body1));
+		__m512d			total_force_x(_mm512_setzero_pd());
+		__m512d			total_force_y(_mm512_setzero_pd());
+		__m512d			total_force_z(_mm512_setzero_pd());
+
+		for(size_t body2 = 0; body2 != a.count; ++body2)
+		{
+			const __m512d	dx(_mm512_sub_pd(_mm512_set1_pd(a.rx[body2]), x1));
+			const __m512d	dy(_mm512_sub_pd(_mm512_set1_pd(a.ry[body2]), y1));
+			const __m512d	dz(_mm512_sub_pd(_mm512_set1_pd(a.rz[body2]), z1));
+			__m512d			r2(_mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx))));
+			r2 = _mm512_maskz_max_pd(all, r2, min_distance);
+			const __m512d	coeff(_mm512_div_pd(_mm512_set1_pd(a.mass[body2]),
+												_mm512_mul_pd(r2, _mm512_maskz_sqrt_pd(all, r2))));
+
+			total_force_x = _mm512_fmadd_pd(dx, coeff, total_force_x);
+			total_force_y = _mm512_fmadd_pd(dy, coeff, total_force_y);
+			total_force_z = _mm512_fmadd_pd(dz, coeff, total_force_z);
+		}
+		_mm512_storeu_pd(a.fvx + body1, total_force_x);
+		_mm512_storeu_pd(a.fvy + body1, total_force_y);
+		_mm512_storeu_pd(a.fvz + body1, total_force_z);
+	}
+	kernel_avx2(a, body1, end);
+}
+#endif //NBODY_SIMD_AVX512
+
+simd_kernel select_kernel(e_simd_isa isa)
+{
+	switch(isa)
+	{
+#ifdef NBODY_SIMD_X86
+	case esimd_sse2:
+		return kernel_sse2;
+	case esimd_avx2:
+		return kernel_avx2;
+#endif //NBODY_SIMD_X86
+#ifdef NBODY_SIMD_AVX512
+	case esimd_avx512:
+		return kernel_avx512;
+#endif //NBODY_SIMD_AVX512
+	default:
+		break;
+	}
+	return kernel_scalar;
+}
+
+}//namespace
+
+const char* simd_isa_name(e_simd_isa isa)
+{
+	switch(isa)
+	{
+	case esimd_scalar:
+		return "scalar";
+	case esimd_sse2:
+		return "sse2";
+	case esimd_avx2:
+		return "avx2";
+	case esimd_avx512:
+		return "avx512";
+	case esimd_auto:
+		return "auto";
+	default:
+		return "";
+	}
+	return "";
+}
+
+e_simd_isa simd_isa_from_str(const QString& name)
+{
+	if(name == "scalar")
+	{
+		return esimd_scalar;
+	}
+	else if(name == "sse2")
+	{
+		return esimd_sse2;
+	}
+	else if(name == "avx2")
+	{
+		return esimd_avx2;
+	}
+	else if(name == "avx512")
+	{
+		return esimd_avx512;
+	}
+	else if(name == "auto")
+	{
+		return esimd_auto;
+	}
+
+	return esimd_unknown;
+}
+
+e_simd_isa simd_isa_detect()
+{
+#if defined(NBODY_SIMD_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+	{
+		return esimd_avx512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	{
+		return esimd_avx2;
+	}
+	return esimd_sse2;
+#elif defined(NBODY_SIMD_X86) && defined(_MSC_VER)
+	int		info[4] = {};
+	__cpuidex(info, 0, 0);
+	const int	max_leaf = info[0];
+	__cpuidex(info, 1, 0);
+	const bool	fma = (info[2] & (1 << 12)) != 0;
+	const bool	osxsave = (info[2] & (1 << 27)) != 0;
+	// Check that OS saves YMM (and ZMM) registers on context switch
+	const unsigned long long	xcr0 = osxsave ? _xgetbv(0) : 0;
+	const bool	os_avx = (xcr0 & 0x6) == 0x6;
+	const bool	os_avx512 = (xcr0 & 0xe6) == 0xe6;
+	bool		avx2 = false;
+	bool		avx512f = false;
+	if(max_leaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512f = (info[1] & (1 << 16)) != 0;
+	}
+#ifdef NBODY_SIMD_AVX512
+	if(avx512f && os_avx512)
+	{
+		return esimd_avx512;
+	}
+#else
+	Q_UNUSED(avx512f);
+	Q_UNUSED(os_avx512);
+#endif //NBODY_SIMD_AVX512
+	if(avx2 && fma && os_avx)
+	{
+		return esimd_avx2;
+	}
+	return esimd_sse2;
+#else
+	return esimd_scalar;
+#endif
+}
+
+nbody_engine_simd::nbody_engine_simd(e_simd_isa isa) :
+	m_isa(isa)
+{
+	e_simd_isa	supported = simd_isa_detect();
+	if(m_isa == esimd_auto)
+	{
+		m_isa = supported;
+	}
+	else if(m_isa > supported)
+	{
+		qDebug() << "Instruction set" << simd_isa_name(m_isa)
+				 << "is not supported. Fall back to" << simd_isa_name(supported);
+		m_isa = supported;
+	}
+}
+
+const char* nbody_engine_simd::type_name() const
+{
+	return "nbody_engine_simd";
+}
+
+bool nbody_engine_simd::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	// SIMD kernels are Newtonian only
+	return law == efl_newton && nbody_engine_openmp::set_force_law(law, softening);
+}
+
+void nbody_engine_simd::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	size_t				count = m_data->get_count();
+	const size_t		block = NBODY_DATA_BLOCK_SIZE;
+
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	const simd_kernel_args	args = {count, rx, ry, rz, mass, fvx, fvy, fvz};
+	const simd_kernel		kernel = select_kernel(m_isa);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for(size_t n1 = 0; n1 < count; n1 += block)
+	{
+		const size_t	n1_end = std::min(n1 + block, count);
+
+		kernel(args, n1, n1_end);
+	}
+}
+
+void nbody_engine_simd::print_info() const
+{
+	nbody_engine_openmp::print_info();
+	qDebug() << "\tsimd_isa:" << simd_isa_name(m_isa);
+}
+
+e_simd_isa nbody_engine_simd::get_isa() const
+{
+	return m_isa;
+}
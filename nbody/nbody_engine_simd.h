@@ -0,0 +1,40 @@
+#ifndef NBODY_ENGINE_SIMD_H
+#define NBODY_ENGINE_SIMD_H
+
+#include "nbody_engine_openmp.h"
+
+//! Instruction set used by SIMD engine force kernel
+enum e_simd_isa
+{
+	esimd_scalar,
+	esimd_sse2,
+	esimd_avx2,
+	esimd_avx512,
+
+	esimd_auto = 0xfffffffe,
+	esimd_unknown = 0xffffffff
+};
+
+const char NBODY_DLL* simd_isa_name(e_simd_isa isa);
+e_simd_isa NBODY_DLL simd_isa_from_str(const QString& name);
+//! Best instruction set supported by current CPU (CPUID based)
+e_simd_isa NBODY_DLL simd_isa_detect();
+
+/*!
+	Multi-threaded (OpenMP) engine with explicit SIMD (SSE2/AVX2/AVX-512) force kernel.
+	Kernel is selected at runtime from CPUID, so library can be built without '-m<isa>' flags.
+ */
+class NBODY_DLL nbody_engine_simd : public nbody_engine_openmp
+{
+	e_simd_isa	m_isa;
+public:
+	explicit nbody_engine_simd(e_simd_isa isa = esimd_auto);
+	const char* type_name() const override;
+	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void print_info() const override;
+	bool set_force_law(e_force_law law, nbcoord_t softening) override;
+	//! Instruction set used by force kernel
+	e_simd_isa get_isa() const;
+};
+
+#endif // NBODY_ENGINE_SIMD_H
@@ -1,8 +1,15 @@
 #include "nbody_engine_simple.h"
 #include <QDebug>
+#include <algorithm>
+#include <typeinfo>
 #include "summation.h"
 
-nbody_engine_simple::nbody_engine_simple()
+nbody_engine_simple::nbody_engine_simple() :
+	m_body_order(ebo_none),
+	m_reorder_rate(0),
+	m_force_law(efl_newton),
+	m_softening(0),
+	m_clone_data(NULL)
 {
 	m_mass = NULL;
 	m_y = NULL;
@@ -11,8 +18,12 @@ nbody_engine_simple::nbody_engine_simple()
 
 nbody_engine_simple::~nbody_engine_simple()
 {
-	free_buffer(m_mass);
+	if(m_clone_data == NULL)
+	{
+		free_buffer(m_mass);
+	}
 	free_buffer(m_y);
+	delete m_clone_data;
 }
 
 const char* nbody_engine_simple::type_name() const
@@ -22,6 +33,9 @@ const char* nbody_engine_simple::type_name() const
 
 void nbody_engine_simple::init(nbody_data* data)
 {
+	free_buffer(m_mass);
+	free_buffer(m_y);
+
 	m_data = data;
 	m_mass = create_buffer(sizeof(nbcoord_t) * m_data->get_count());
 	m_y = create_buffer(sizeof(nbcoord_t) * problem_size());
@@ -48,6 +62,25 @@ void nbody_engine_simple::init(nbody_data* data)
 		vz[i] = vel[i].z;
 		m[i] = mass[i];
 	}
+
+	m_body_index.resize(count);
+	for(size_t i = 0; i != count; ++i)
+	{
+		m_body_index[i] = i;
+	}
+}
+
+void nbody_engine_simple::init_clone(const nbody_engine_simple* origin)
+{
+	m_clone_data = new nbody_data(*origin->m_data);
+	m_data = m_clone_data;
+	m_mass = origin->m_mass;
+	m_y = create_buffer(sizeof(nbcoord_t) * problem_size());
+	copy_buffer(m_y, origin->m_y);
+	m_body_index = origin->m_body_index;
+	m_force_law = origin->m_force_law;
+	m_softening = origin->m_softening;
+	set_ode_order(origin->get_ode_order());
 }
 
 void nbody_engine_simple::get_data(nbody_data* data)
@@ -61,15 +94,17 @@ void nbody_engine_simple::get_data(nbody_data* data)
 	const nbcoord_t*	vz = rx + 5 * count;
 	nbvertex_t*			vrt = data->get_vertites();
 	nbvertex_t*			vel = data->get_velosites();
+	const size_t*		body_index = m_body_index.data();
 
 	for(size_t i = 0; i != count; ++i)
 	{
-		vrt[i].x = rx[i];
-		vrt[i].y = ry[i];
-		vrt[i].z = rz[i];
-		vel[i].x = vx[i];
-		vel[i].y = vy[i];
-		vel[i].z = vz[i];
+		size_t	n = body_index[i];
+		vrt[n].x = rx[i];
+		vrt[n].y = ry[i];
+		vrt[n].z = rz[i];
+		vel[n].x = vx[i];
+		vel[n].y = vy[i];
+		vel[n].z = vz[i];
 	}
 }
 
@@ -83,9 +118,24 @@ nbody_engine::memory* nbody_engine_simple::get_y()
 	return m_y;
 }
 
+const nbody_engine::memory* nbody_engine_simple::get_mass()
+{
+	return m_mass;
+}
+
+bool nbody_engine_simple::is_second_order_supported() const
+{
+	return true;
+}
+
 void nbody_engine_simple::advise_time(const nbcoord_t& dt)
 {
 	m_data->advise_time(dt);
+
+	if(m_body_order != ebo_none && m_reorder_rate != 0 && m_data->get_step() % m_reorder_rate == 0)
+	{
+		reorder_bodies();
+	}
 }
 
 nbcoord_t nbody_engine_simple::get_time() const
@@ -129,51 +179,114 @@ void nbody_engine_simple::fcompute(const nbcoord_t& t, const memory* _y, memory*
 
 	size_t				count = m_data->get_count();
 	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
-	const nbcoord_t*	ry = rx + count;
-	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
 
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
 
-	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	for(size_t body1 = 0; body1 < count; ++body1)
+	{
+		const nbvertex_t	total(direct_acceleration(body1, rx));
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
+	}
+}
+
+void nbody_engine_simple::fcompute_active(const nbcoord_t& t, const memory* _y, memory* _f,
+										  const std::vector<size_t>& active)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(get_ode_order() != eode_second_order)
+	{
+		qDebug() << "fcompute_active requires second order ODE";
+		return;
+	}
+
+	advise_compute_count(active.size());
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	nbcoord_t*			fvx = reinterpret_cast<nbcoord_t*>(f->data());
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+
+	for(size_t body1 : active)
+	{
+		const nbvertex_t	total(direct_acceleration(body1, rx));
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
+	}
+}
+
+void nbody_engine_simple::fcompute_with_jerk(const nbcoord_t& t, const memory* _y, memory* _f, memory* _jerk)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+	smemory*		jerk = dynamic_cast<smemory*>(_jerk);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(jerk == NULL)
+	{
+		qDebug() << "jerk is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	ry = reinterpret_cast<const nbcoord_t*>(y->data());
+	nbcoord_t*			fx = reinterpret_cast<nbcoord_t*>(f->data());
+	nbcoord_t*			jx = reinterpret_cast<nbcoord_t*>(jerk->data());
 
 	for(size_t body1 = 0; body1 < count; ++body1)
 	{
-		const nbvertex_t	v1(rx[ body1 ], ry[ body1 ], rz[ body1 ]);
-		nbvertex_t			total_force;
-		for(size_t body2 = 0; body2 != count; ++body2)
-		{
-			if(body1 == body2)
-			{
-				continue;
-			}
-			const nbvertex_t	v2(rx[ body2 ], ry[ body2 ], rz[ body2 ]);
-			const nbvertex_t	force(m_data->force(v1, v2, mass[body1], mass[body2]));
-			total_force += force;
-		}
-		frx[body1] = vx[body1];
-		fry[body1] = vy[body1];
-		frz[body1] = vz[body1];
-		fvx[body1] = total_force.x / mass[body1];
-		fvy[body1] = total_force.y / mass[body1];
-		fvz[body1] = total_force.z / mass[body1];
+		nbvertex_t	acc;
+		nbvertex_t	j;
+		direct_acceleration_jerk(body1, ry, acc, j);
+		fx[body1] = acc.x;
+		fx[body1 + count] = acc.y;
+		fx[body1 + 2 * count] = acc.z;
+		jx[body1] = j.x;
+		jx[body1 + count] = j.y;
+		jx[body1 + 2 * count] = j.z;
 	}
 }
 
 nbody_engine_simple::smemory* nbody_engine_simple::create_buffer(size_t s)
 {
-	return new smemory(s);
+	smemory*	m = new smemory(s);
+	m_buffers.insert(m);
+	return m;
 }
 
 void nbody_engine_simple::free_buffer(memory* m)
 {
+	m_buffers.erase(m);
 	delete m;
 }
 
@@ -307,6 +420,35 @@ void nbody_engine_simple::fmadd(memory* __a, const memory* __b, const memory* __
 	}
 }
 
+void nbody_engine_simple::fmaddn_inplace(memory* __a, const memory_array& __b,
+										 const nbcoord_t* c, size_t csize)
+{
+	smemory*	_a = dynamic_cast<smemory*>(__a);
+	if(_a == nullptr)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(c == nullptr)
+	{
+		return;
+	}
+	if(csize > __b.size())
+	{
+		qDebug() << "csize > b.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	b;
+	if(!buffers_data(__b, csize, b))
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+
+	nbcoord_t*	a = reinterpret_cast<nbcoord_t*>(_a->data());
+	fmaddn_range(a, a, b.data(), c, csize, 0, problem_size());
+}
+
 void nbody_engine_simple::fmaddn_corr(memory* __a, memory* __corr, const memory_array& __b,
 									  const nbcoord_t* c, size_t csize)
 {
@@ -358,6 +500,132 @@ void nbody_engine_simple::fmaddn_corr(memory* __a, memory* __corr, const memory_
 	}
 }
 
+void nbody_engine_simple::fmaddn(memory* __a, const memory* __b, const memory_array& __c,
+								 const nbcoord_t* d, size_t dsize)
+{
+	smemory*		_a = dynamic_cast<smemory*>(__a);
+	const smemory*	_b = dynamic_cast<const smemory*>(__b);
+	if(_a == nullptr)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(__b != nullptr && _b == nullptr)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+	if(d == nullptr)
+	{
+		qDebug() << "d == NULL";
+		return;
+	}
+	if(dsize > __c.size())
+	{
+		qDebug() << "dsize > c.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	c;
+	if(!buffers_data(__c, dsize, c))
+	{
+		qDebug() << "c is not smemory";
+		return;
+	}
+
+	nbcoord_t*			a = reinterpret_cast<nbcoord_t*>(_a->data());
+	const nbcoord_t*	b = (_b == nullptr) ? nullptr : reinterpret_cast<const nbcoord_t*>(_b->data());
+	fmaddn_range(a, b, c.data(), d, dsize, 0, problem_size());
+}
+
+void nbody_engine_simple::fmaddn_second_order(memory* __a, const memory* __b, const memory_array& __c,
+											   const nbcoord_t& e, const nbcoord_t* dx, const nbcoord_t* dv,
+											   size_t csize)
+{
+	smemory*		_a = dynamic_cast<smemory*>(__a);
+	const smemory*	_b = dynamic_cast<const smemory*>(__b);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(__b != NULL && _b == NULL)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+	if(csize > __c.size())
+	{
+		qDebug() << "csize > c.size()";
+		return;
+	}
+	std::vector<const nbcoord_t*>	c;
+	for(size_t k = 0; k != csize; ++k)
+	{
+		const smemory* _c = dynamic_cast<const smemory*>(__c[k]);
+		if(_c == NULL)
+		{
+			qDebug() << "c is not smemory";
+			return;
+		}
+		c.push_back(reinterpret_cast<const nbcoord_t*>(_c->data()));
+	}
+
+	size_t				half = problem_size() / 2;
+	nbcoord_t*			ax = reinterpret_cast<nbcoord_t*>(_a->data());
+	nbcoord_t*			av = ax + half;
+	const nbcoord_t*	bx = (_b == NULL) ? NULL : reinterpret_cast<const nbcoord_t*>(_b->data());
+	const nbcoord_t*	bv = (_b == NULL) ? NULL : bx + half;
+
+	for(size_t i = 0; i < half; ++i)
+	{
+		nbcoord_t	x = (bx == NULL) ? 0 : bx[i] + bv[i] * e;
+		nbcoord_t	v = (bv == NULL) ? 0 : bv[i];
+		for(size_t k = 0; k < csize; ++k)
+		{
+			x += c[k][i] * dx[k];
+			v += c[k][i] * dv[k];
+		}
+		ax[i] = x;
+		av[i] = v;
+	}
+}
+
+void nbody_engine_simple::kick_active(memory* __y, const memory* __f, const std::vector<size_t>& active,
+									  const std::vector<nbcoord_t>& dt)
+{
+	smemory*		_y = dynamic_cast<smemory*>(__y);
+	const smemory*	_f = dynamic_cast<const smemory*>(__f);
+
+	if(_y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(_f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+	if(active.size() != dt.size())
+	{
+		qDebug() << "active.size() != dt.size()";
+		return;
+	}
+
+	size_t				count = m_data->get_count();
+	nbcoord_t*			v = reinterpret_cast<nbcoord_t*>(_y->data()) + 3 * count;
+	const nbcoord_t*	f = reinterpret_cast<const nbcoord_t*>(_f->data());
+
+	for(size_t n = 0; n != active.size(); ++n)
+	{
+		const size_t	i = active[n];
+		v[i] += f[i] * dt[n];
+		v[i + count] += f[i + count] * dt[n];
+		v[i + 2 * count] += f[i + 2 * count] * dt[n];
+	}
+}
+
 void nbody_engine_simple::fmaxabs(const nbody_engine::memory* __a, nbcoord_t& result)
 {
 	const smemory*		_a = dynamic_cast<const smemory*>(__a);
@@ -408,3 +676,318 @@ size_t nbody_engine_simple::smemory::size() const
 {
 	return m_size;
 }
+
+void nbody_engine_simple::fweighted_rms(const nbody_engine::memory* __a, const nbody_engine::memory* __y,
+										const nbcoord_t& atol, const nbcoord_t& rtol, nbcoord_t& result)
+{
+	const smemory*		_a = dynamic_cast<const smemory*>(__a);
+	const smemory*		_y = dynamic_cast<const smemory*>(__y);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(_y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+
+	const nbcoord_t*	a = reinterpret_cast<const nbcoord_t*>(_a->data());
+	const nbcoord_t*	y = reinterpret_cast<const nbcoord_t*>(_y->data());
+	size_t				count = problem_size();
+	nbcoord_t			sum = 0;
+
+	for(size_t n = 0; n < count; ++n)
+	{
+		const nbcoord_t	e = a[n] / (atol + rtol * fabs(y[n]));
+		sum += e * e;
+	}
+	result = sqrt(sum / static_cast<nbcoord_t>(count));
+}
+
+void nbody_engine_simple::fdot(const nbody_engine::memory* __a, const nbody_engine::memory* __b, nbcoord_t& result)
+{
+	const smemory*		_a = dynamic_cast<const smemory*>(__a);
+	const smemory*		_b = dynamic_cast<const smemory*>(__b);
+
+	if(_a == NULL)
+	{
+		qDebug() << "a is not smemory";
+		return;
+	}
+	if(_b == NULL)
+	{
+		qDebug() << "b is not smemory";
+		return;
+	}
+
+	const nbcoord_t*	a = reinterpret_cast<const nbcoord_t*>(_a->data());
+	const nbcoord_t*	b = reinterpret_cast<const nbcoord_t*>(_b->data());
+	size_t				count = problem_size();
+	nbcoord_t			sum = 0;
+
+	for(size_t n = 0; n < count; ++n)
+	{
+		sum += a[n] * b[n];
+	}
+	result = sum;
+}
+
+nbody_engine* nbody_engine_simple::clone()
+{
+	// Derived engines may keep per-body data, that is not shared with clone
+	if(typeid(*this) != typeid(nbody_engine_simple))
+	{
+		return NULL;
+	}
+	nbody_engine_simple*	e = new nbody_engine_simple();
+	e->init_clone(this);
+	return e;
+}
+
+void nbody_engine_simple::print_info() const
+{
+	nbody_engine::print_info();
+	if(m_body_order != ebo_none)
+	{
+		qDebug() << "\tbody_order:" << body_order_name(m_body_order);
+		qDebug() << "\treorder_rate:" << m_reorder_rate;
+	}
+	if(m_force_law != efl_newton)
+	{
+		qDebug() << "\tsoftening:" << force_law_name(m_force_law);
+		qDebug() << "\tsoftening_length:" << m_softening;
+	}
+}
+
+void nbody_engine_simple::set_body_order(e_body_order order, size_t reorder_rate)
+{
+	m_body_order = order;
+	m_reorder_rate = reorder_rate;
+}
+
+bool nbody_engine_simple::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	if(law == efl_unknown)
+	{
+		return false;
+	}
+	m_force_law = law;
+	m_softening = softening;
+	return true;
+}
+
+e_force_law nbody_engine_simple::get_force_law() const
+{
+	return m_force_law;
+}
+
+nbcoord_t nbody_engine_simple::get_softening() const
+{
+	return m_softening;
+}
+
+e_body_order nbody_engine_simple::get_body_order() const
+{
+	return m_body_order;
+}
+
+void nbody_engine_simple::reorder_bodies()
+{
+	if(m_data == NULL || m_body_order == ebo_none)
+	{
+		return;
+	}
+
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(m_y->data());
+	std::vector<size_t>	order;
+
+	space_order(m_body_order, count, rx, rx + count, rx + 2 * count, order);
+
+	std::vector<nbcoord_t>	tmp(count);
+	for(memory* mem : m_buffers)
+	{
+		smemory*	m = dynamic_cast<smemory*>(mem);
+		size_t		size = m->size() / sizeof(nbcoord_t);
+		// Buffers are SoA of per-body values, other buffers are not touched
+		if(count == 0 || size % count != 0)
+		{
+			continue;
+		}
+		nbcoord_t*	data = reinterpret_cast<nbcoord_t*>(m->data());
+		for(size_t offset = 0; offset != size; offset += count)
+		{
+			nbcoord_t*	a = data + offset;
+			for(size_t i = 0; i != count; ++i)
+			{
+				tmp[i] = a[order[i]];
+			}
+			std::copy(tmp.begin(), tmp.end(), a);
+		}
+	}
+
+	std::vector<size_t>	body_index(count);
+	for(size_t i = 0; i != count; ++i)
+	{
+		body_index[i] = m_body_index[order[i]];
+	}
+	m_body_index.swap(body_index);
+
+	bodies_reordered(order);
+}
+
+nbvertex_t nbody_engine_simple::direct_acceleration(size_t body1, const nbcoord_t* rx) const
+{
+	switch(m_force_law)
+	{
+	case efl_plummer:
+		return direct_acceleration(nbody_force_plummer(m_softening), body1, rx);
+	case efl_spline:
+		return direct_acceleration(nbody_force_spline(m_softening), body1, rx);
+	default:
+		return direct_acceleration(nbody_force_newton(), body1, rx);
+	}
+}
+
+void nbody_engine_simple::direct_acceleration_jerk(size_t body1, const nbcoord_t* y,
+												   nbvertex_t& acc, nbvertex_t& jerk) const
+{
+	switch(m_force_law)
+	{
+	case efl_plummer:
+		direct_acceleration_jerk(nbody_force_plummer(m_softening), body1, y, acc, jerk);
+		break;
+	case efl_spline:
+		direct_acceleration_jerk(nbody_force_spline(m_softening), body1, y, acc, jerk);
+		break;
+	default:
+		direct_acceleration_jerk(nbody_force_newton(), body1, y, acc, jerk);
+		break;
+	}
+}
+
+template<class ForceLaw>
+nbvertex_t nbody_engine_simple::direct_acceleration(const ForceLaw& law, size_t body1, const nbcoord_t* rx) const
+{
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+	const nbvertex_t	v1(rx[ body1 ], ry[ body1 ], rz[ body1 ]);
+	nbvertex_t			total;
+
+	for(size_t body2 = 0; body2 != count; ++body2)
+	{
+		if(body1 == body2)
+		{
+			continue;
+		}
+		const nbvertex_t	dr(nbvertex_t(rx[ body2 ], ry[ body2 ], rz[ body2 ]) - v1);
+		total += dr * (mass[body2] * law(dr.norm()));
+	}
+	return total;
+}
+
+template<class ForceLaw>
+void nbody_engine_simple::direct_acceleration_jerk(const ForceLaw& law, size_t body1, const nbcoord_t* y,
+												   nbvertex_t& acc, nbvertex_t& jerk) const
+{
+	size_t				count = m_data->get_count();
+	const nbcoord_t*	rx = y;
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+	const nbcoord_t*	vx = rx + 3 * count;
+	const nbcoord_t*	vy = rx + 4 * count;
+	const nbcoord_t*	vz = rx + 5 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	acc = nbvertex_t();
+	jerk = nbvertex_t();
+	for(size_t body2 = 0; body2 != count; ++body2)
+	{
+		if(body1 == body2)
+		{
+			continue;
+		}
+		// a = Sum(m*dr*k(r^2)), jerk = Sum(m*(dv*k(r^2) + 2*(dr*dv)*dr*k'(r^2)))
+		const nbvertex_t	dr(rx[body2] - rx[body1], ry[body2] - ry[body1], rz[body2] - rz[body1]);
+		const nbvertex_t	dv(vx[body2] - vx[body1], vy[body2] - vy[body1], vz[body2] - vz[body1]);
+		const nbcoord_t		r2(dr.norm());
+		const nbcoord_t		coeff = mass[body2] * law(r2);
+		const nbcoord_t		rv = 2 * (dr * dv) * mass[body2] * law.derivative(r2);
+
+		acc += dr * coeff;
+		jerk += dv * coeff + dr * rv;
+	}
+}
+
+nbcoord_t* nbody_engine_simple::acceleration_data(const smemory* y, smemory* f) const
+{
+	size_t		count = m_data->get_count();
+	nbcoord_t*	frx = reinterpret_cast<nbcoord_t*>(f->data());
+
+	if(get_ode_order() == eode_second_order)
+	{
+		return frx;
+	}
+
+	const nbcoord_t*	vx = reinterpret_cast<const nbcoord_t*>(y->data()) + 3 * count;
+	std::copy(vx, vx + 3 * count, frx);
+
+	return frx + 3 * count;
+}
+
+void nbody_engine_simple::bodies_reordered(const std::vector<size_t>& order)
+{
+	Q_UNUSED(order);
+}
+
+bool nbody_engine_simple::buffers_data(const memory_array& mema, size_t count,
+									   std::vector<const nbcoord_t*>& data)
+{
+	data.resize(count);
+	for(size_t k = 0; k != count; ++k)
+	{
+		const smemory*	m = dynamic_cast<const smemory*>(mema[k]);
+		if(m == nullptr)
+		{
+			return false;
+		}
+		data[k] = reinterpret_cast<const nbcoord_t*>(m->data());
+	}
+	return true;
+}
+
+void nbody_engine_simple::fmaddn_range(nbcoord_t* a, const nbcoord_t* b, const nbcoord_t* const* c,
+									   const nbcoord_t* d, size_t dsize, size_t begin, size_t end)
+{
+	// 8 KiB of 'a' per block for double precision
+	const size_t	block_size = 1024;
+
+	for(size_t block = begin; block < end; block += block_size)
+	{
+		const size_t	count = std::min(block_size, end - block);
+		nbcoord_t*		ab = a + block;
+
+		if(b == nullptr)
+		{
+			std::fill(ab, ab + count, static_cast<nbcoord_t>(0));
+		}
+		else if(b != a)
+		{
+			std::copy(b + block, b + block + count, ab);
+		}
+		for(size_t k = 0; k != dsize; ++k)
+		{
+			const nbcoord_t*	cb = c[k] + block;
+			const nbcoord_t		dk = d[k];
+			for(size_t i = 0; i != count; ++i)
+			{
+				ab[i] += cb[i] * dk;
+			}
+		}
+	}
+}
@@ -1,7 +1,10 @@
 #ifndef NBODY_ENGINE_SIMPLE_H
 #define NBODY_ENGINE_SIMPLE_H
 
+#include <set>
 #include "nbody_engine.h"
+#include "nbody_force_law.h"
+#include "nbody_space_order.h"
 
 class NBODY_DLL nbody_engine_simple : public nbody_engine
 {
@@ -21,6 +24,17 @@ protected:
 	smemory*			m_mass;
 	smemory*			m_y;
 	nbody_data*			m_data;
+private:
+	e_body_order		m_body_order;
+	size_t				m_reorder_rate;
+	//! m_body_index[n] = original (nbody_data) index of body stored at position n
+	std::vector<size_t>	m_body_index;
+	//! All buffers created by engine, they are permuted with bodies reorder
+	std::set<memory*>	m_buffers;
+	e_force_law			m_force_law;
+	nbcoord_t			m_softening;
+	//! Own copy of nbody_data (time and step) of clone, NULL at original engine
+	nbody_data*			m_clone_data;
 public:
 	nbody_engine_simple();
 	~nbody_engine_simple();
@@ -29,12 +43,17 @@ public:
 	void get_data(nbody_data* data) override;
 	size_t problem_size() const override;
 	memory* get_y() override;
+	const memory* get_mass() override;
+	bool is_second_order_supported() const override;
 	void advise_time(const nbcoord_t& dt) override;
 	nbcoord_t get_time() const override;
 	void set_time(nbcoord_t t) override;
 	size_t get_step() const override;
 	void set_step(size_t s) override;
 	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
+	void fcompute_with_jerk(const nbcoord_t& t, const memory* y, memory* f, memory* jerk) override;
 
 	smemory* create_buffer(size_t) override;
 	void free_buffer(memory*) override;
@@ -44,9 +63,79 @@ public:
 	void fill_buffer(memory* a, const nbcoord_t& value) override;
 	void fmadd_inplace(memory* a, const memory* b, const nbcoord_t& c) override;
 	void fmadd(memory* a, const memory* b, const memory* c, const nbcoord_t& d) override;
+	void fmaddn_inplace(memory* a, const memory_array& b,
+						const nbcoord_t* c, size_t csize) override;
 	void fmaddn_corr(memory* a, memory* corr, const memory_array& b,
 					 const nbcoord_t* c, size_t csize) override;
+	void fmaddn(memory* a, const memory* b, const memory_array& c,
+				const nbcoord_t* d, size_t dsize) override;
+	void fmaddn_second_order(memory* a, const memory* b, const memory_array& c, const nbcoord_t& e,
+							 const nbcoord_t* dx, const nbcoord_t* dv, size_t csize) override;
+	void kick_active(memory* y, const memory* f, const std::vector<size_t>& active,
+					 const std::vector<nbcoord_t>& dt) override;
 	void fmaxabs(const memory* a, nbcoord_t& result) override;
+	void fweighted_rms(const memory* a, const memory* y, const nbcoord_t& atol, const nbcoord_t& rtol,
+					   nbcoord_t& result) override;
+	void fdot(const memory* a, const memory* b, nbcoord_t& result) override;
+	//! Supported only by nbody_engine_simple itself, derived engines return NULL
+	nbody_engine* clone() override;
+	void print_info() const override;
+
+	/*!
+		Keep bodies sorted along space filling curve for better memory locality of neighbours.
+		All engine buffers with size multiple of bodies count are permuted once per 'reorder_rate' steps,
+		get_data still returns bodies in original order.
+	 */
+	void set_body_order(e_body_order order, size_t reorder_rate);
+	e_body_order get_body_order() const;
+	//! Sort bodies along space filling curve now
+	void reorder_bodies();
+	/*!
+		Select pairwise force law (see nbody_force_law.h).
+		@param softening - Plummer softening length or spline kernel radius
+		@return false if law is not supported by engine
+	 */
+	virtual bool set_force_law(e_force_law law, nbcoord_t softening);
+	e_force_law get_force_law() const;
+	nbcoord_t get_softening() const;
+protected:
+	//! Make this engine a clone of 'origin' (see nbody_engine::clone), masses are shared with 'origin'
+	void init_clone(const nbody_engine_simple* origin);
+	/*!
+		Accelerations [ax, ay, az] part of fcompute result 'f'.
+		For first order ODE velocities from 'y' are copied to first half of 'f'.
+	 */
+	nbcoord_t* acceleration_data(const smemory* y, smemory* f) const;
+	//! Direct sum acceleration of 'body1', 'rx' points to [x, y, z] coordinates of all bodies
+	nbvertex_t direct_acceleration(size_t body1, const nbcoord_t* rx) const;
+	/*!
+		Direct sum acceleration 'acc' and jerk 'jerk' of 'body1',
+		'y' points to [x, y, z, vx, vy, vz] of all bodies
+	 */
+	void direct_acceleration_jerk(size_t body1, const nbcoord_t* y, nbvertex_t& acc, nbvertex_t& jerk) const;
+	template<class ForceLaw>
+	nbvertex_t direct_acceleration(const ForceLaw& law, size_t body1, const nbcoord_t* rx) const;
+	template<class ForceLaw>
+	void direct_acceleration_jerk(const ForceLaw& law, size_t body1, const nbcoord_t* y,
+								  nbvertex_t& acc, nbvertex_t& jerk) const;
+	/*!
+		Called after all engine buffers were permuted.
+		Engines with per-body cached data must permute or drop it.
+		@param order - order[new_index] = old_index
+	 */
+	virtual void bodies_reordered(const std::vector<size_t>& order);
+	/*!
+		Pointers to data of first 'count' buffers of 'mema'
+		@return false if some buffer is not smemory
+	 */
+	static bool buffers_data(const memory_array& mema, size_t count, std::vector<const nbcoord_t*>& data);
+	/*!
+		Single pass a[i] = b[i] + sum( c[k][i]*d[k], k=[0...dsize) ) for i=[begin...end).
+		'b' may be NULL (zero) or equal to 'a'. Range is processed by short blocks,
+		so block of 'a' stays in L1 cache while all 'c' buffers are read once.
+	 */
+	static void fmaddn_range(nbcoord_t* a, const nbcoord_t* b, const nbcoord_t* const* c,
+							 const nbcoord_t* d, size_t dsize, size_t begin, size_t end);
 };
 
 #endif // NBODY_ENGINE_SIMPLE_H
@@ -1,18 +1,108 @@
 #include "nbody_engine_simple_bh.h"
 
 #include <QDebug>
+#include <algorithm>
 
 #include "nbody_space_heap.h"
 #include "nbody_space_heap_stackless.h"
 #include "nbody_space_tree.h"
 
+namespace {
+
+//! Accelerations of bucket 'bodies' from shared interaction 'list'
+template<class ForceLaw>
+void bucket_fcompute(const ForceLaw& law, const std::vector<size_t>& bodies, const space_interaction_list& list,
+					 const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+					 nbcoord_t* fvx, nbcoord_t* fvy, nbcoord_t* fvz)
+{
+	// Local copies of pointers, so stores to accumulators can not alias them
+	const nbcoord_t*	x = list.x.data();
+	const nbcoord_t*	y = list.y.data();
+	const nbcoord_t*	z = list.z.data();
+	const nbcoord_t*	mass = list.mass.data();
+	const size_t		count = list.mass.size();
+	const size_t		quadrupole_count = list.quadrupole.size();
+
+	for(size_t body1 : bodies)
+	{
+		const nbcoord_t	x1 = rx[body1];
+		const nbcoord_t	y1 = ry[body1];
+		const nbcoord_t	z1 = rz[body1];
+		nbcoord_t		total_x = 0;
+		nbcoord_t		total_y = 0;
+		nbcoord_t		total_z = 0;
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+		#pragma omp simd reduction(+:total_x, total_y, total_z)
+#endif
+		for(size_t n = 0; n < count; ++n)
+		{
+			// Body itself is in the list too, it gives zero, because dx = dy = dz = 0
+			const nbcoord_t	dx = x[n] - x1;
+			const nbcoord_t	dy = y[n] - y1;
+			const nbcoord_t	dz = z[n] - z1;
+			const nbcoord_t	coeff = mass[n] * law(dx * dx + dy * dy + dz * dz);
+
+			total_x += dx * coeff;
+			total_y += dy * coeff;
+			total_z += dz * coeff;
+		}
+
+		nbvertex_t	total(total_x, total_y, total_z);
+		for(size_t n = 0; n != quadrupole_count; ++n)
+		{
+			total += space_quadrupole_force(nbvertex_t(x1, y1, z1), list.quadrupole_center[n], 1,
+											list.quadrupole[n]);
+		}
+
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
+	}
+}
+
+}//namespace
+
 nbody_engine_simple_bh::nbody_engine_simple_bh(nbcoord_t distance_to_node_radius_ratio,
 											   e_traverse_type tt,
-											   e_tree_layout tl) :
+											   e_tree_layout tl,
+											   size_t tree_rebuild_rate,
+											   nbcoord_t tree_max_overlap_growth,
+											   size_t multipole_order,
+											   size_t bucket_size) :
 	m_distance_to_node_radius_ratio(distance_to_node_radius_ratio),
 	m_traverse_type(tt),
-	m_tree_layout(tl)
+	m_tree_layout(tl),
+	m_tree_rebuild_rate(tree_rebuild_rate),
+	m_tree_max_overlap_growth(tree_max_overlap_growth),
+	m_multipole_order(multipole_order),
+	m_bucket_size(std::max(bucket_size, static_cast<size_t>(1))),
+	m_tree(nullptr),
+	m_heap(nullptr),
+	m_tree_valid(false),
+	m_tree_build_step(0),
+	m_tree_build_overlap(0)
 {
+	switch(m_tree_layout)
+	{
+	case etl_tree:
+		m_tree = new nbody_space_tree(m_multipole_order);
+		break;
+	case etl_heap:
+		m_heap = new nbody_space_heap(m_multipole_order);
+		break;
+	case etl_heap_stackless:
+		m_heap = new nbody_space_heap_stackless(m_multipole_order);
+		break;
+	default:
+		break;
+	}
+}
+
+nbody_engine_simple_bh::~nbody_engine_simple_bh()
+{
+	delete m_tree;
+	delete m_heap;
 }
 
 const char* nbody_engine_simple_bh::type_name() const
@@ -20,59 +110,125 @@ const char* nbody_engine_simple_bh::type_name() const
 	return "nbody_engine_simple_bh";
 }
 
+void nbody_engine_simple_bh::init(nbody_data* data)
+{
+	nbody_engine_openmp::init(data);
+	m_tree_valid = false;
+}
+
+void nbody_engine_simple_bh::bodies_reordered(const std::vector<size_t>& order)
+{
+	Q_UNUSED(order);
+	// Tree leaves refer to old body indices
+	m_tree_valid = false;
+}
+
+template<class T>
+void nbody_engine_simple_bh::update_tree(T* tree, const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+										 const nbcoord_t* mass)
+{
+	size_t	count = m_data->get_count();
+	size_t	step = get_step();
+	bool	rebuild = !m_tree_valid || !tree->is_built() ||
+					  m_tree_rebuild_rate == 0 ||
+					  step < m_tree_build_step ||
+					  step - m_tree_build_step >= m_tree_rebuild_rate;
+
+	if(!rebuild)
+	{
+		tree->refit(rx, ry, rz, mass);
+		rebuild = (tree->overlap() - m_tree_build_overlap > m_tree_max_overlap_growth);
+	}
+
+	if(rebuild)
+	{
+		tree->build(count, rx, ry, rz, mass, m_distance_to_node_radius_ratio);
+		m_tree_valid = true;
+		m_tree_build_step = step;
+		m_tree_build_overlap = (m_tree_rebuild_rate == 0) ? 0 : tree->overlap();
+	}
+}
+
 template<class T>
-void nbody_engine_simple_bh::space_subdivided_fcompute(const smemory* y, smemory* f)
+void nbody_engine_simple_bh::space_subdivided_fcompute(T* tree, const smemory* y, smemory* f,
+													   const std::vector<size_t>* active)
+{
+	switch(get_force_law())
+	{
+	case efl_plummer:
+		space_subdivided_fcompute(tree, nbody_force_plummer(get_softening()), y, f, active);
+		break;
+	case efl_spline:
+		space_subdivided_fcompute(tree, nbody_force_spline(get_softening()), y, f, active);
+		break;
+	default:
+		space_subdivided_fcompute(tree, nbody_force_newton(), y, f, active);
+		break;
+	}
+}
+
+template<class T, class ForceLaw>
+void nbody_engine_simple_bh::space_subdivided_fcompute(T* tree, const ForceLaw& law, const smemory* y, smemory* f,
+													   const std::vector<size_t>* active)
 {
 	size_t				count = m_data->get_count();
 	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
 	const nbcoord_t*	ry = rx + count;
 	const nbcoord_t*	rz = rx + 2 * count;
-	const nbcoord_t*	vx = rx + 3 * count;
-	const nbcoord_t*	vy = rx + 4 * count;
-	const nbcoord_t*	vz = rx + 5 * count;
 
-	nbcoord_t*			frx = reinterpret_cast<nbcoord_t*>(f->data());
-	nbcoord_t*			fry = frx + count;
-	nbcoord_t*			frz = frx + 2 * count;
-	nbcoord_t*			fvx = frx + 3 * count;
-	nbcoord_t*			fvy = frx + 4 * count;
-	nbcoord_t*			fvz = frx + 5 * count;
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
 
 	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
-	T					tree;
 
-	tree.build(count, rx, ry, rz, mass, m_distance_to_node_radius_ratio);
+	update_tree(tree, rx, ry, rz, mass);
 
-	auto update_f = [ = ](size_t body1, const nbvertex_t& total_force, nbcoord_t mass1)
+	auto update_f = [ = ](size_t body1, const nbvertex_t& total)
 	{
-		frx[body1] = vx[body1];
-		fry[body1] = vy[body1];
-		frz[body1] = vz[body1];
-		fvx[body1] = total_force.x / mass1;
-		fvy[body1] = total_force.y / mass1;
-		fvz[body1] = total_force.z / mass1;
+		fvx[body1] = total.x;
+		fvy[body1] = total.y;
+		fvz[body1] = total.z;
 	};
 
 	auto node_visitor = [&](size_t body1, const nbvertex_t& v1, const nbcoord_t mass1)
 	{
-		nbvertex_t			total_force(tree.traverse(m_data, v1, mass1));
-		update_f(body1, total_force, mass[body1]);
+		Q_UNUSED(mass1);
+		update_f(body1, tree->traverse(law, v1));
 	};
 
-	if(ett_cycle == m_traverse_type)
+	if(active != nullptr)
+	{
+		// Active subset is usually small, so each body walks the tree alone
+		const size_t	active_count = active->size();
+		#pragma omp parallel for schedule(dynamic, 4)
+		for(size_t n = 0; n < active_count; ++n)
+		{
+			const size_t		body1 = (*active)[n];
+			const nbvertex_t	v1(rx[body1], ry[body1], rz[body1]);
+			update_f(body1, tree->traverse(law, v1));
+		}
+	}
+	else if(ett_cycle == m_traverse_type)
 	{
 		#pragma omp parallel for schedule(dynamic, 4)
 		for(size_t body1 = 0; body1 < count; ++body1)
 		{
 			const nbvertex_t	v1(rx[body1], ry[body1], rz[body1]);
-			const nbcoord_t		mass1(mass[body1]);
-			const nbvertex_t	total_force(tree.traverse(m_data, v1, mass1));
-			update_f(body1, total_force, mass1);
+			update_f(body1, tree->traverse(law, v1));
 		}
 	}
 	else if(ett_nested_tree == m_traverse_type)
 	{
-		tree.traverse(node_visitor);
+		tree->traverse(node_visitor);
+	}
+	else if(ett_group == m_traverse_type)
+	{
+		auto bucket_visitor = [&](const std::vector<size_t>& bodies, const space_interaction_list& list)
+		{
+			bucket_fcompute(law, bodies, list, rx, ry, rz, fvx, fvy, fvz);
+		};
+		tree->traverse_group(m_bucket_size, bucket_visitor);
 	}
 }
 
@@ -98,13 +254,55 @@ void nbody_engine_simple_bh::fcompute(const nbcoord_t& t, const memory* _y, memo
 	switch(m_tree_layout)
 	{
 	case etl_tree:
-		space_subdivided_fcompute<nbody_space_tree>(y, f);
+		space_subdivided_fcompute(m_tree, y, f, nullptr);
+		break;
+	case etl_heap:
+		space_subdivided_fcompute(m_heap, y, f, nullptr);
+		break;
+	case etl_heap_stackless:
+		space_subdivided_fcompute(static_cast<nbody_space_heap_stackless*>(m_heap), y, f, nullptr);
+		break;
+	default:
+		break;
+	}
+}
+
+void nbody_engine_simple_bh::fcompute_active(const nbcoord_t& t, const memory* _y, memory* _f,
+											 const std::vector<size_t>& active)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+
+	if(get_ode_order() != eode_second_order)
+	{
+		qDebug() << "fcompute_active requires second order ODE";
+		return;
+	}
+
+	advise_compute_count(active.size());
+
+	switch(m_tree_layout)
+	{
+	case etl_tree:
+		space_subdivided_fcompute(m_tree, y, f, &active);
 		break;
 	case etl_heap:
-		space_subdivided_fcompute<nbody_space_heap>(y, f);
+		space_subdivided_fcompute(m_heap, y, f, &active);
 		break;
 	case etl_heap_stackless:
-		space_subdivided_fcompute<nbody_space_heap_stackless>(y, f);
+		space_subdivided_fcompute(static_cast<nbody_space_heap_stackless*>(m_heap), y, f, &active);
 		break;
 	default:
 		break;
@@ -149,7 +347,12 @@ void nbody_engine_simple_bh::print_info() const
 {
 	nbody_engine_simple::print_info();
 	qDebug() << "\tdistance_to_node_radius_ratio:" << m_distance_to_node_radius_ratio;
-	qDebug() << "\ttraverse_type:" << (m_traverse_type == ett_cycle ? "cycle" : "nested_tree");
+	qDebug() << "\ttraverse_type:" << (m_traverse_type == ett_cycle ? "cycle" :
+										  m_traverse_type == ett_nested_tree ? "nested_tree" : "group");
+	qDebug() << "\tbucket_size:" << m_bucket_size;
 	qDebug() << "\ttree_layout:" << tree_layout_name(m_tree_layout);
+	qDebug() << "\ttree_rebuild_rate:" << m_tree_rebuild_rate;
+	qDebug() << "\ttree_max_overlap_growth:" << m_tree_max_overlap_growth;
+	qDebug() << "\tmultipole_order:" << m_multipole_order;
 }
 
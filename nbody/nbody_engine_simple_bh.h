@@ -12,7 +12,8 @@ static constexpr	size_t MAX_STACK_SIZE = 64;
 enum e_traverse_type
 {
 	ett_cycle,
-	ett_nested_tree
+	ett_nested_tree,
+	ett_group
 };
 enum e_tree_layout
 {
@@ -26,9 +27,154 @@ enum e_tree_layout
 const char NBODY_DLL* tree_layout_name(e_tree_layout tree_layout);
 e_tree_layout NBODY_DLL tree_layout_from_str(const QString& name);
 
+//! Relative volume of intersection of children boxes [bmin1, bmax1] and [bmin2, bmax2] in parent box
+inline nbcoord_t space_box_overlap(const nbvertex_t& bmin, const nbvertex_t& bmax,
+								   const nbvertex_t& bmin1, const nbvertex_t& bmax1,
+								   const nbvertex_t& bmin2, const nbvertex_t& bmax2)
+{
+	const nbvertex_t	size(bmax - bmin);
+	const nbcoord_t		volume = size.x * size.y * size.z;
+	if(volume <= 0)
+	{
+		return 0;
+	}
+	const nbvertex_t	intersection(std::min(bmax1.x, bmax2.x) - std::max(bmin1.x, bmin2.x),
+									 std::min(bmax1.y, bmax2.y) - std::max(bmin1.y, bmin2.y),
+									 std::min(bmax1.z, bmax2.z) - std::max(bmin1.z, bmin2.z));
+	if(intersection.x <= 0 || intersection.y <= 0 || intersection.z <= 0)
+	{
+		return 0;
+	}
+	return intersection.x * intersection.y * intersection.z / volume;
+}
+
+//! Traceless quadrupole tensor Q_ij = Sum(m * (3 * d_i * d_j - |d|^2 * delta_ij)) relative to node mass center
+struct space_quadrupole
+{
+	nbcoord_t	xx, xy, xz, yy, yz, zz;
+
+	space_quadrupole() :
+		xx(0), xy(0), xz(0), yy(0), yz(0), zz(0)
+	{
+	}
+	//! Quadrupole of point 'mass' at 'd' relative to expansion center
+	space_quadrupole(const nbvertex_t& d, nbcoord_t mass)
+	{
+		const nbcoord_t	d2 = d.norm();
+		xx = mass * (3 * d.x * d.x - d2);
+		xy = mass * (3 * d.x * d.y);
+		xz = mass * (3 * d.x * d.z);
+		yy = mass * (3 * d.y * d.y - d2);
+		yz = mass * (3 * d.y * d.z);
+		zz = mass * (3 * d.z * d.z - d2);
+	}
+	space_quadrupole& operator += (const space_quadrupole& q)
+	{
+		xx += q.xx;
+		xy += q.xy;
+		xz += q.xz;
+		yy += q.yy;
+		yz += q.yz;
+		zz += q.zz;
+		return *this;
+	}
+	nbvertex_t operator * (const nbvertex_t& r) const
+	{
+		return nbvertex_t(xx * r.x + xy * r.y + xz * r.z,
+						  xy * r.x + yy * r.y + yz * r.z,
+						  xz * r.x + yz * r.y + zz * r.z);
+	}
+};
+
+//! Quadrupole of node with mass center 'center' from children quadrupoles (parallel axis theorem)
+inline space_quadrupole space_quadrupole_merge(const nbvertex_t& center,
+											   const nbvertex_t& center1, nbcoord_t mass1, const space_quadrupole& q1,
+											   const nbvertex_t& center2, nbcoord_t mass2, const space_quadrupole& q2)
+{
+	space_quadrupole	q(center1 - center, mass1);
+	q += space_quadrupole(center2 - center, mass2);
+	q += q1;
+	q += q2;
+	return q;
+}
+
+/*!
+	Quadrupole term of force from node with mass center 'v2' to body 'v1' with mass 'mass1'.
+	Potential of node is -M/r - (r^T Q r) / (2 r^5), so force term is
+	mass1 * (Q r / r^5 - 5/2 (r^T Q r) r / r^7), where r = v1 - v2
+ */
+inline nbvertex_t space_quadrupole_force(const nbvertex_t& v1, const nbvertex_t& v2, nbcoord_t mass1,
+										 const space_quadrupole& q)
+{
+	const nbvertex_t	dr(v1 - v2);
+	const nbcoord_t		r2(std::max(dr.norm(), nbody::MinDistance));
+	const nbcoord_t		inv_r2 = 1 / r2;
+	const nbcoord_t		inv_r5 = inv_r2 * inv_r2 / sqrt(r2);
+	const nbvertex_t	qr(q * dr);
+	const nbcoord_t		rqr = qr * dr;
+
+	return (qr - dr * (static_cast<nbcoord_t>(2.5) * rqr * inv_r2)) * (mass1 * inv_r5);
+}
+
+//! Squared distance from point 'v' to box [bmin, bmax], 0 if point is inside the box
+inline nbcoord_t space_box_distance_sqr(const nbvertex_t& v, const nbvertex_t& bmin, const nbvertex_t& bmax)
+{
+	const nbvertex_t	d(std::max(std::max(bmin.x - v.x, v.x - bmax.x), static_cast<nbcoord_t>(0)),
+						  std::max(std::max(bmin.y - v.y, v.y - bmax.y), static_cast<nbcoord_t>(0)),
+						  std::max(std::max(bmin.z - v.z, v.z - bmax.z), static_cast<nbcoord_t>(0)));
+	return d.norm();
+}
+
+/*!
+	Interaction list shared by all bodies of leaf bucket.
+	Nodes accepted for whole bucket box and bodies of opened leaves are stored as SoA point masses.
+	Quadrupole terms of accepted internal nodes are stored separately (multipole_order = 2 only).
+ */
+struct space_interaction_list
+{
+	std::vector<nbcoord_t>			x;
+	std::vector<nbcoord_t>			y;
+	std::vector<nbcoord_t>			z;
+	std::vector<nbcoord_t>			mass;
+	std::vector<nbvertex_t>			quadrupole_center;
+	std::vector<space_quadrupole>	quadrupole;
+
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		z.clear();
+		mass.clear();
+		quadrupole_center.clear();
+		quadrupole.clear();
+	}
+	void add(const nbvertex_t& center, nbcoord_t m)
+	{
+		x.push_back(center.x);
+		y.push_back(center.y);
+		z.push_back(center.z);
+		mass.push_back(m);
+	}
+};
+
+class nbody_space_tree;
+class nbody_space_heap;
+
 /*!
   Barnes–Hut simulation
   https://en.wikipedia.org/wiki/Barnes%E2%80%93Hut_simulation
+
+  Space tree is kept between fcompute calls. It is fully rebuilt once per
+  'tree_rebuild_rate' solver steps (0 - on every fcompute call), other calls
+  (intermediate solver stages) only refit node mass centers, boxes and radii.
+  Tree is rebuilt earlier if children boxes overlap grows by more than 'tree_max_overlap_growth'.
+
+  With 'ett_group' traverse type bodies are grouped to leaf buckets of at most 'bucket_size' bodies.
+  Each bucket walks the tree once against its bounding box and builds shared interaction list,
+  the list is evaluated for all bodies of the bucket with vectorized loop.
+
+  With 'multipole_order' = 2 nodes also keep quadrupole moments, so far nodes are approximated
+  more accurately and smaller 'distance_to_node_radius_ratio' gives the same accuracy.
  */
 class NBODY_DLL nbody_engine_simple_bh : public nbody_engine_openmp
 {
@@ -36,16 +182,45 @@ private:
 	nbcoord_t			m_distance_to_node_radius_ratio;
 	e_traverse_type		m_traverse_type;
 	e_tree_layout		m_tree_layout;
+	size_t				m_tree_rebuild_rate;
+	nbcoord_t			m_tree_max_overlap_growth;
+	size_t				m_multipole_order;
+	size_t				m_bucket_size;
+	nbody_space_tree*	m_tree;
+	nbody_space_heap*	m_heap;
+	bool				m_tree_valid;
+	size_t				m_tree_build_step;
+	nbcoord_t			m_tree_build_overlap;
 public:
 	nbody_engine_simple_bh(nbcoord_t distance_to_node_radius_ratio = 0,
 						   e_traverse_type tt = ett_cycle,
-						   e_tree_layout tl = etl_tree);
+						   e_tree_layout tl = etl_tree,
+						   size_t tree_rebuild_rate = 1,
+						   nbcoord_t tree_max_overlap_growth = 0.05,
+						   size_t multipole_order = 0,
+						   size_t bucket_size = 32);
+	~nbody_engine_simple_bh();
+	nbody_engine_simple_bh(const nbody_engine_simple_bh&) = delete;
+	nbody_engine_simple_bh& operator = (const nbody_engine_simple_bh&) = delete;
 	const char* type_name() const override;
+	void init(nbody_data* data) override;
 	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void fcompute_active(const nbcoord_t& t, const memory* y, memory* f,
+						 const std::vector<size_t>& active) override;
 	void print_info() const override;
+protected:
+	void bodies_reordered(const std::vector<size_t>& order) override;
 private:
 	template<class T>
-	void space_subdivided_fcompute(const smemory* y, smemory* f);
+	void update_tree(T* tree, const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+					 const nbcoord_t* mass);
+	//! Accelerations of all bodies or of 'active' bodies only, when it is not nullptr
+	template<class T>
+	void space_subdivided_fcompute(T* tree, const smemory* y, smemory* f,
+								   const std::vector<size_t>* active);
+	template<class T, class ForceLaw>
+	void space_subdivided_fcompute(T* tree, const ForceLaw& law, const smemory* y, smemory* f,
+								   const std::vector<size_t>* active);
 };
 
 #endif // NBODY_ENGINE_SIMPLE_BH_H
@@ -0,0 +1,206 @@
+#include "nbody_engine_tiled.h"
+#include <omp.h>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+struct tile_args
+{
+	const nbcoord_t*	rx;
+	const nbcoord_t*	ry;
+	const nbcoord_t*	rz;
+	const nbcoord_t*	mass;
+	nbcoord_t*			ax;
+	nbcoord_t*			ay;
+	nbcoord_t*			az;
+};
+
+//! Interactions between bodies [b1, e1) and [b2, e2), ranges must not overlap
+void tile_pair(const tile_args& a, size_t b1, size_t e1, size_t b2, size_t e2)
+{
+	// Local copies of pointers, so stores to accumulators can not alias them
+	const nbcoord_t*	rx = a.rx;
+	const nbcoord_t*	ry = a.ry;
+	const nbcoord_t*	rz = a.rz;
+	const nbcoord_t*	mass = a.mass;
+	nbcoord_t*			ax = a.ax;
+	nbcoord_t*			ay = a.ay;
+	nbcoord_t*			az = a.az;
+	const nbcoord_t		min_distance(nbody::MinDistance);
+
+	for(size_t body1 = b1; body1 != e1; ++body1)
+	{
+		const nbcoord_t	x1 = rx[body1];
+		const nbcoord_t	y1 = ry[body1];
+		const nbcoord_t	z1 = rz[body1];
+		const nbcoord_t	m1 = mass[body1];
+		nbcoord_t		total_force_x = 0;
+		nbcoord_t		total_force_y = 0;
+		nbcoord_t		total_force_z = 0;
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+		#pragma omp simd reduction(+:total_force_x, total_force_y, total_force_z)
+#endif
+		for(size_t body2 = b2; body2 < e2; ++body2)
+		{
+			const nbcoord_t	dx = rx[body2] - x1;
+			const nbcoord_t	dy = ry[body2] - y1;
+			const nbcoord_t	dz = rz[body2] - z1;
+			const nbcoord_t	r2(std::max(dx * dx + dy * dy + dz * dz, min_distance));
+			const nbcoord_t	r = sqrt(r2);
+			const nbcoord_t	rinv3 = 1 / (r * r2);
+			const nbcoord_t	coeff1 = mass[body2] * rinv3;
+			const nbcoord_t	coeff2 = m1 * rinv3;
+
+			total_force_x += dx * coeff1;
+			total_force_y += dy * coeff1;
+			total_force_z += dz * coeff1;
+			ax[body2] -= dx * coeff2;
+			ay[body2] -= dy * coeff2;
+			az[body2] -= dz * coeff2;
+		}
+		ax[body1] += total_force_x;
+		ay[body1] += total_force_y;
+		az[body1] += total_force_z;
+	}
+}
+
+//! Interactions inside [begin, end), each pair once
+void tile_diagonal(const tile_args& a, size_t begin, size_t end)
+{
+	for(size_t body1 = begin; body1 != end; ++body1)
+	{
+		tile_pair(a, body1, body1 + 1, body1 + 1, end);
+	}
+}
+
+}//namespace
+
+nbody_engine_tiled::nbody_engine_tiled(size_t tile_size) :
+	m_tile_size(std::max(tile_size, static_cast<size_t>(1)))
+{
+}
+
+const char* nbody_engine_tiled::type_name() const
+{
+	return "nbody_engine_tiled";
+}
+
+bool nbody_engine_tiled::set_force_law(e_force_law law, nbcoord_t softening)
+{
+	// Tiled kernel is Newtonian only
+	return law == efl_newton && nbody_engine_openmp::set_force_law(law, softening);
+}
+
+void nbody_engine_tiled::init(nbody_data* data)
+{
+	nbody_engine_openmp::init(data);
+
+	const size_t	tile_count = (m_data->get_count() + m_tile_size - 1) / m_tile_size;
+
+	m_tile_pairs.clear();
+	m_tile_pairs.reserve(tile_count * (tile_count + 1) / 2);
+	for(size_t t1 = 0; t1 != tile_count; ++t1)
+	{
+		for(size_t t2 = t1; t2 != tile_count; ++t2)
+		{
+			m_tile_pairs.push_back(std::make_pair(t1, t2));
+		}
+	}
+}
+
+void nbody_engine_tiled::fcompute(const nbcoord_t& t, const memory* _y, memory* _f)
+{
+	Q_UNUSED(t);
+	const smemory*	y = dynamic_cast<const  smemory*>(_y);
+	smemory*		f = dynamic_cast<smemory*>(_f);
+
+	if(y == NULL)
+	{
+		qDebug() << "y is not smemory";
+		return;
+	}
+	if(f == NULL)
+	{
+		qDebug() << "f is not smemory";
+		return;
+	}
+
+	advise_compute_count();
+
+	const size_t		count = m_data->get_count();
+	const size_t		tile_size = m_tile_size;
+	const size_t		threads = static_cast<size_t>(omp_get_max_threads());
+	const size_t		accum_stride = 3 * count;
+
+	const nbcoord_t*	rx = reinterpret_cast<const nbcoord_t*>(y->data());
+	const nbcoord_t*	ry = rx + count;
+	const nbcoord_t*	rz = rx + 2 * count;
+
+	nbcoord_t*			fvx = acceleration_data(y, f);
+	nbcoord_t*			fvy = fvx + count;
+	nbcoord_t*			fvz = fvx + 2 * count;
+	const nbcoord_t*	mass = reinterpret_cast<const nbcoord_t*>(m_mass->data());
+
+	m_accum.resize(threads * accum_stride);
+
+	const std::pair<size_t, size_t>*	tile_pairs = m_tile_pairs.data();
+	const size_t						tile_pairs_count = m_tile_pairs.size();
+	nbcoord_t*							accum = m_accum.data();
+
+	#pragma omp parallel num_threads(threads)
+	{
+		nbcoord_t*	ax = accum + static_cast<size_t>(omp_get_thread_num()) * accum_stride;
+		tile_args	args = {rx, ry, rz, mass, ax, ax + count, ax + 2 * count};
+
+		// Clear all buffers, runtime may give less threads than requested
+		#pragma omp for
+		for(size_t n = 0; n < threads * accum_stride; ++n)
+		{
+			accum[n] = 0;
+		}
+
+		#pragma omp for schedule(dynamic, 1)
+		for(size_t n = 0; n < tile_pairs_count; ++n)
+		{
+			const size_t	b1 = tile_pairs[n].first * tile_size;
+			const size_t	e1 = std::min(b1 + tile_size, count);
+			const size_t	b2 = tile_pairs[n].second * tile_size;
+			const size_t	e2 = std::min(b2 + tile_size, count);
+
+			if(b1 == b2)
+			{
+				tile_diagonal(args, b1, e1);
+			}
+			else
+			{
+				tile_pair(args, b1, e1, b2, e2);
+			}
+		}
+
+		#pragma omp for
+		for(size_t body = 0; body < count; ++body)
+		{
+			nbcoord_t	total_force_x = 0;
+			nbcoord_t	total_force_y = 0;
+			nbcoord_t	total_force_z = 0;
+			for(size_t thread = 0; thread != threads; ++thread)
+			{
+				const nbcoord_t*	tax = accum + thread * accum_stride;
+				total_force_x += tax[body];
+				total_force_y += tax[body + count];
+				total_force_z += tax[body + 2 * count];
+			}
+			fvx[body] = total_force_x;
+			fvy[body] = total_force_y;
+			fvz[body] = total_force_z;
+		}
+	}
+}
+
+void nbody_engine_tiled::print_info() const
+{
+	nbody_engine_openmp::print_info();
+	qDebug() << "\ttile_size:" << m_tile_size;
+}
@@ -0,0 +1,27 @@
+#ifndef NBODY_ENGINE_TILED_H
+#define NBODY_ENGINE_TILED_H
+
+#include "nbody_engine_openmp.h"
+
+/*!
+	Multi-threaded (OpenMP) direct engine with cache-tiled interaction matrix.
+	N×N interaction matrix is split into tiles of 'tile_size' bodies. Each tile pair (i <= j)
+	is computed once and equal-and-opposite forces are scattered to both sides (Newton's third law),
+	so every body pair is computed only once. Each thread accumulates forces to its own buffer,
+	buffers are summed at the end of fcompute.
+ */
+class NBODY_DLL nbody_engine_tiled : public nbody_engine_openmp
+{
+	size_t									m_tile_size;
+	std::vector< std::pair<size_t, size_t> >	m_tile_pairs;
+	std::vector<nbcoord_t>					m_accum;
+public:
+	explicit nbody_engine_tiled(size_t tile_size = 512);
+	const char* type_name() const override;
+	void init(nbody_data* data) override;
+	void fcompute(const nbcoord_t& t, const memory* y, memory* f) override;
+	void print_info() const override;
+	bool set_force_law(e_force_law law, nbcoord_t softening) override;
+};
+
+#endif // NBODY_ENGINE_TILED_H
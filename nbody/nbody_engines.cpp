@@ -1,7 +1,7 @@
 #include "nbody_engines.h"
 
 
-nbody_engine* nbody_create_engine(const QVariantMap& param)
+static nbody_engine* create_engine(const QVariantMap& param)
 {
 	const QString type(param.value("engine").toString());
 
@@ -10,12 +10,14 @@ nbody_engine* nbody_create_engine(const QVariantMap& param)
 		size_t		full_recompute_rate = param.value("full_recompute_rate", 1000).toUInt();
 		nbcoord_t	max_dist = param.value("max_dist", 10).toDouble();
 		nbcoord_t	min_force = param.value("min_force", 1e-4).toDouble();
+		nbcoord_t	skin = param.value("verlet_skin", max_dist / 4).toDouble();
 
-		return new nbody_engine_ah(full_recompute_rate, max_dist, min_force);
+		return new nbody_engine_ah(full_recompute_rate, max_dist, min_force, skin);
 	}
 	else if(type == "block")
 	{
-		return new nbody_engine_block();
+		bool	mixed_precision(param.value("mixed_precision", 0).toInt() != 0);
+		return new nbody_engine_block(mixed_precision);
 	}
 #ifdef HAVE_CUDA
 	else if(type == "cuda")
@@ -102,9 +104,37 @@ nbody_engine* nbody_create_engine(const QVariantMap& param)
 		return engine;
 	}
 #endif
+	else if(type == "fmm")
+	{
+		size_t		order = param.value("fmm_order", 4).toUInt();
+		nbcoord_t	distance_to_node_radius_ratio = param.value("distance_to_node_radius_ratio", 2).toDouble();
+		size_t		leaf_size = param.value("leaf_size", 16).toUInt();
+
+		if(order < 1)
+		{
+			qDebug() << "Invalid fmm_order. Must be greater than 0";
+			return NULL;
+		}
+
+		return new nbody_engine_fmm(order, distance_to_node_radius_ratio, leaf_size);
+	}
 	else if(type == "openmp")
 	{
-		return new nbody_engine_openmp();
+		bool	mixed_precision(param.value("mixed_precision", 0).toInt() != 0);
+		return new nbody_engine_openmp(mixed_precision);
+	}
+	else if(type == "simd")
+	{
+		QString		strisa(param.value("simd_isa", "auto").toString());
+		e_simd_isa	isa = simd_isa_from_str(strisa);
+
+		if(isa == esimd_unknown)
+		{
+			qDebug() << "Invalid simd_isa. Allowed values are 'auto', 'scalar', 'sse2', 'avx2' or 'avx512'";
+			return NULL;
+		}
+
+		return new nbody_engine_simd(isa);
 	}
 	else if(type == "simple")
 	{
@@ -115,6 +145,10 @@ nbody_engine* nbody_create_engine(const QVariantMap& param)
 		QString		strtt(param.value("traverse_type", "cycle").toString());
 		QString		strtl(param.value("tree_layout", "tree").toString());
 		nbcoord_t	distance_to_node_radius_ratio = param.value("distance_to_node_radius_ratio", 10).toDouble();
+		size_t		tree_rebuild_rate = param.value("tree_rebuild_rate", 1).toUInt();
+		nbcoord_t	tree_max_overlap_growth = param.value("tree_max_overlap_growth", 0.05).toDouble();
+		size_t		multipole_order = param.value("multipole_order", 0).toUInt();
+		size_t		bucket_size = param.value("bucket_size", 32).toUInt();
 		e_traverse_type	tt;
 
 		if(strtt == "cycle")
@@ -125,9 +159,13 @@ nbody_engine* nbody_create_engine(const QVariantMap& param)
 		{
 			tt = ett_nested_tree;
 		}
+		else if(strtt == "group")
+		{
+			tt = ett_group;
+		}
 		else
 		{
-			qDebug() << "Invalid traverse_type. Allowed values are 'cycle' or 'nested_tree'";
+			qDebug() << "Invalid traverse_type. Allowed values are 'cycle', 'nested_tree' or 'group'";
 			return NULL;
 		}
 
@@ -138,8 +176,82 @@ nbody_engine* nbody_create_engine(const QVariantMap& param)
 			return NULL;
 		}
 
-		return new nbody_engine_simple_bh(distance_to_node_radius_ratio, tt, tl);
+		if(multipole_order != 0 && multipole_order != 2)
+		{
+			qDebug() << "Invalid multipole_order. Allowed values are 0 or 2";
+			return NULL;
+		}
+
+		return new nbody_engine_simple_bh(distance_to_node_radius_ratio, tt, tl,
+										  tree_rebuild_rate, tree_max_overlap_growth,
+										  multipole_order, bucket_size);
+	}
+	else if(type == "tiled")
+	{
+		size_t	tile_size(param.value("tile_size", 512).toUInt());
+		return new nbody_engine_tiled(tile_size);
 	}
 
 	return NULL;
 }
+
+nbody_engine* nbody_create_engine(const QVariantMap& param)
+{
+	nbody_engine*	engine = create_engine(param);
+
+	if(engine == NULL)
+	{
+		return NULL;
+	}
+
+	e_body_order	order = body_order_from_str(param.value("body_order", "none").toString());
+	size_t			reorder_rate = param.value("reorder_rate", 16).toUInt();
+
+	if(order == ebo_unknown)
+	{
+		qDebug() << "Invalid body_order. Allowed values are 'none', 'morton' or 'hilbert'";
+		delete engine;
+		return NULL;
+	}
+
+	if(order != ebo_none)
+	{
+		nbody_engine_simple*	simple = dynamic_cast<nbody_engine_simple*>(engine);
+		if(simple == NULL)
+		{
+			qDebug() << "body_order is not supported by" << engine->type_name();
+			delete engine;
+			return NULL;
+		}
+		simple->set_body_order(order, reorder_rate);
+	}
+
+	e_force_law	law = force_law_from_str(param.value("softening", "none").toString());
+	nbcoord_t	softening_length = param.value("softening_length", 0).toDouble();
+
+	if(law == efl_unknown)
+	{
+		qDebug() << "Invalid softening. Allowed values are 'none', 'plummer' or 'spline'";
+		delete engine;
+		return NULL;
+	}
+
+	if(law != efl_newton)
+	{
+		nbody_engine_simple*	simple = dynamic_cast<nbody_engine_simple*>(engine);
+		if(softening_length <= 0)
+		{
+			qDebug() << "Invalid softening_length. Must be greater than 0";
+			delete engine;
+			return NULL;
+		}
+		if(simple == NULL || !simple->set_force_law(law, softening_length))
+		{
+			qDebug() << "softening" << force_law_name(law) << "is not supported by" << engine->type_name();
+			delete engine;
+			return NULL;
+		}
+	}
+
+	return engine;
+}
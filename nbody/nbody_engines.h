@@ -6,11 +6,14 @@
 #include "nbody_engine_cuda.h"
 #include "nbody_engine_cuda_bh.h"
 #include "nbody_engine_cuda_bh_tex.h"
+#include "nbody_engine_fmm.h"
 #include "nbody_engine_opencl.h"
 #include "nbody_engine_opencl_bh.h"
 #include "nbody_engine_openmp.h"
+#include "nbody_engine_simd.h"
 #include "nbody_engine_simple.h"
 #include "nbody_engine_simple_bh.h"
+#include "nbody_engine_tiled.h"
 
 /*!
    \brief Create solver from parameters
@@ -0,0 +1,35 @@
+#include "nbody_force_law.h"
+
+const char* force_law_name(e_force_law law)
+{
+	switch(law)
+	{
+	case efl_newton:
+		return "none";
+	case efl_plummer:
+		return "plummer";
+	case efl_spline:
+		return "spline";
+	default:
+		return "";
+	}
+	return "";
+}
+
+e_force_law force_law_from_str(const QString& name)
+{
+	if(name == "none")
+	{
+		return efl_newton;
+	}
+	else if(name == "plummer")
+	{
+		return efl_plummer;
+	}
+	else if(name == "spline")
+	{
+		return efl_spline;
+	}
+
+	return efl_unknown;
+}
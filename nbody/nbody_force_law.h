@@ -0,0 +1,124 @@
+#ifndef NBODY_FORCE_LAW_H
+#define NBODY_FORCE_LAW_H
+
+#include <algorithm>
+#include <cmath>
+#include "nbtype_info.h"
+#include "nbody_export.h"
+
+//! Pairwise gravity law used by CPU engines
+enum e_force_law
+{
+	efl_newton,		// 1/r^2 with r^2 clamped to nbody::MinDistance
+	efl_plummer,	// Plummer softening
+	efl_spline,		// Cubic spline softening
+
+	efl_unknown = 0xffffffff
+};
+
+const char NBODY_DLL* force_law_name(e_force_law law);
+e_force_law NBODY_DLL force_law_from_str(const QString& name);
+
+/*!
+	Force law policies.
+
+	Acceleration of body 1 by body 2 is (r2 - r1) * mass2 * law(|r2 - r1|^2),
+	so mass of body 1 is never multiplied and divided back.
+	law.derivative(r^2) is d(law(r^2))/d(r^2), it is used for jerk and force rate:
+	d(a)/dt = mass2 * (dv * law(r^2) + dr * 2 * (dr * dv) * law.derivative(r^2))
+
+	Policies are passed by value to templated kernels, so law is inlined into pair loop.
+	Gravity constant is 1, as at all engines.
+ */
+struct nbody_force_newton
+{
+	explicit nbody_force_newton(nbcoord_t softening = 0)
+	{
+		static_cast<void>(softening);
+	}
+	nbcoord_t operator()(nbcoord_t r2) const
+	{
+		r2 = std::max(r2, nbody::MinDistance);
+		return 1 / (r2 * sqrt(r2));
+	}
+	nbcoord_t derivative(nbcoord_t r2) const
+	{
+		r2 = std::max(r2, nbody::MinDistance);
+		return static_cast<nbcoord_t>(-1.5) / (r2 * r2 * sqrt(r2));
+	}
+};
+
+//! Potential -1/sqrt(r^2 + softening^2)
+struct nbody_force_plummer
+{
+	nbcoord_t	m_softening_sqr;
+
+	explicit nbody_force_plummer(nbcoord_t softening) :
+		m_softening_sqr(softening * softening)
+	{
+	}
+	nbcoord_t operator()(nbcoord_t r2) const
+	{
+		const nbcoord_t	s2 = r2 + m_softening_sqr;
+		return 1 / (s2 * sqrt(s2));
+	}
+	nbcoord_t derivative(nbcoord_t r2) const
+	{
+		const nbcoord_t	s2 = r2 + m_softening_sqr;
+		return static_cast<nbcoord_t>(-1.5) / (s2 * s2 * sqrt(s2));
+	}
+};
+
+/*!
+	Cubic spline kernel softening (Monaghan & Lattanzio 1985), as in GADGET-2.
+	Force is exactly Newtonian at r >= softening (kernel support radius h).
+ */
+struct nbody_force_spline
+{
+	nbcoord_t	m_h;
+	nbcoord_t	m_h_inv;
+	nbcoord_t	m_h3_inv;
+
+	explicit nbody_force_spline(nbcoord_t softening) :
+		m_h(softening),
+		m_h_inv(1 / softening),
+		m_h3_inv(1 / (softening * softening * softening))
+	{
+	}
+	nbcoord_t operator()(nbcoord_t r2) const
+	{
+		const nbcoord_t	r = sqrt(r2);
+		if(r >= m_h)
+		{
+			return 1 / (r2 * r);
+		}
+		const nbcoord_t	u = r * m_h_inv;
+		if(u < static_cast<nbcoord_t>(0.5))
+		{
+			return m_h3_inv * (static_cast<nbcoord_t>(32.0 / 3.0) +
+							   u * u * (32 * u - static_cast<nbcoord_t>(38.4)));
+		}
+		return m_h3_inv * (static_cast<nbcoord_t>(64.0 / 3.0) - 48 * u + static_cast<nbcoord_t>(38.4) * u * u -
+						   static_cast<nbcoord_t>(32.0 / 3.0) * u * u * u -
+						   static_cast<nbcoord_t>(1.0 / 15.0) / (u * u * u));
+	}
+	nbcoord_t derivative(nbcoord_t r2) const
+	{
+		const nbcoord_t	r = sqrt(r2);
+		if(r >= m_h)
+		{
+			return static_cast<nbcoord_t>(-1.5) / (r2 * r2 * r);
+		}
+		const nbcoord_t	u = r * m_h_inv;
+		const nbcoord_t	h5_inv = m_h3_inv * m_h_inv * m_h_inv;
+		if(u < static_cast<nbcoord_t>(0.5))
+		{
+			return h5_inv * (48 * u - static_cast<nbcoord_t>(38.4));
+		}
+		const nbcoord_t	u2 = u * u;
+		return h5_inv * (static_cast<nbcoord_t>(38.4) - 24 / u - 16 * u +
+						 static_cast<nbcoord_t>(0.1) / (u2 * u2 * u));
+	}
+};
+
+#endif //NBODY_FORCE_LAW_H
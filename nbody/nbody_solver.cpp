@@ -2,9 +2,12 @@
 #include "nbody_data_stream.h"
 #include "nbody_step_visitor.h"
 #include <QDebug>
+#include <limits>
 
 nbody_solver::nbody_solver()
-	: m_engine(NULL), m_min_step(0), m_max_step(0)
+	: m_engine(NULL), m_min_step(0), m_max_step(0),
+	  m_dense_data(NULL), m_dense_stream(NULL), m_dense_dump_dt(0), m_dense_dump_time(0),
+	  m_dense_y_backup(NULL), m_dense_status(0)
 {
 }
 
@@ -51,6 +54,12 @@ int nbody_solver::run(nbody_data* data, nbody_data_stream* stream, nbcoord_t max
 	nbcoord_t   last_check = data->get_time();
 	nbcoord_t   last_dump = last_check;
 
+	if(!is_engine_supported(m_engine))
+	{
+		qDebug() << "Solver" << type_name() << "does not support engine" << m_engine->type_name();
+		return -1;
+	}
+
 	if(stream != NULL && dump_dt > 0 && last_dump <= 0)
 	{
 		m_engine->get_data(data);
@@ -62,10 +71,25 @@ int nbody_solver::run(nbody_data* data, nbody_data_stream* stream, nbcoord_t max
 		last_dump = data->get_time();
 	}
 
+	const bool	dense_output = (stream != NULL && dump_dt > 0 && has_dense_output());
+	if(dense_output)
+	{
+		m_dense_data = data;
+		m_dense_stream = stream;
+		m_dense_dump_dt = dump_dt;
+		m_dense_dump_time = last_dump + dump_dt;
+		m_dense_status = 0;
+	}
+
 	while(data->get_time() < max_time)
 	{
 		advise(dt);
 
+		if(dense_output && m_dense_status != 0)
+		{
+			break;
+		}
+
 		nbcoord_t   t = data->get_time();
 
 		if(check_dt > 0 && t >= last_check + check_dt - dt * 0.1)
@@ -78,7 +102,7 @@ int nbody_solver::run(nbody_data* data, nbody_data_stream* stream, nbcoord_t max
 			last_check = t;
 		}
 
-		if(stream != NULL && dump_dt > 0 && t >= last_dump + dump_dt - dt * 0.1)
+		if(!dense_output && stream != NULL && dump_dt > 0 && t >= last_dump + dump_dt - dt * 0.1)
 		{
 			m_engine->get_data(data);
 			if(0 != stream->write(data))
@@ -89,6 +113,19 @@ int nbody_solver::run(nbody_data* data, nbody_data_stream* stream, nbcoord_t max
 			last_dump = t;
 		}
 	}
+
+	if(dense_output)
+	{
+		m_engine->free_buffer(m_dense_y_backup);
+		m_dense_y_backup = NULL;
+		m_dense_data = NULL;
+		m_dense_stream = NULL;
+		if(m_dense_status != 0)
+		{
+			qDebug() << "Can't stream->write";
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -108,3 +145,50 @@ void nbody_solver::reset()
 {
 }
 
+bool nbody_solver::has_dense_output() const
+{
+	return false;
+}
+
+bool nbody_solver::is_engine_supported(nbody_engine* e) const
+{
+	if(get_ode_order() == eode_second_order && !e->is_second_order_supported())
+	{
+		qDebug() << "Engine" << e->type_name() << "does not support second order ODE";
+		return false;
+	}
+	return true;
+}
+
+nbcoord_t nbody_solver::next_dense_output_time() const
+{
+	if(m_dense_stream == NULL || m_dense_status != 0)
+	{
+		return std::numeric_limits<nbcoord_t>::max();
+	}
+	return m_dense_dump_time;
+}
+
+void nbody_solver::write_dense_output(nbcoord_t t, const nbody_engine::memory* y)
+{
+	if(m_dense_stream == NULL)
+	{
+		return;
+	}
+	if(m_dense_y_backup == NULL)
+	{
+		m_dense_y_backup = m_engine->create_buffer(sizeof(nbcoord_t) * m_engine->problem_size());
+	}
+
+	// Stream frames are taken from engine state, so swap it with 'y' for a while
+	const nbcoord_t	engine_time = m_engine->get_time();
+	m_engine->copy_buffer(m_dense_y_backup, m_engine->get_y());
+	m_engine->copy_buffer(m_engine->get_y(), y);
+	m_engine->set_time(t);
+	m_engine->get_data(m_dense_data);
+	m_dense_status = m_dense_stream->write(m_dense_data);
+	m_engine->copy_buffer(m_engine->get_y(), m_dense_y_backup);
+	m_engine->set_time(engine_time);
+
+	m_dense_dump_time += m_dense_dump_dt;
+}
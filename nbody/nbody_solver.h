@@ -13,6 +13,12 @@ class NBODY_DLL nbody_solver
 	nbody_engine*						m_engine;
 	nbcoord_t							m_min_step;
 	nbcoord_t							m_max_step;
+	nbody_data*							m_dense_data;
+	nbody_data_stream*					m_dense_stream;
+	nbcoord_t							m_dense_dump_dt;
+	nbcoord_t							m_dense_dump_time;
+	nbody_engine::memory*				m_dense_y_backup;
+	int									m_dense_status;
 
 	std::vector<std::shared_ptr<nbody_step_visitor>> m_check_visitors;
 	nbody_solver(const nbody_solver&) = delete;
@@ -34,6 +40,26 @@ public:
 	virtual e_ode_order get_ode_order() const;
 	//! Reset solver's state to initial
 	virtual void reset();
+	/*!
+		Solver can compute state at any time within its last step (continuous extension).
+		Then 'run' writes stream frames at exact dump times and
+		step size does not depend on dump time step.
+	 */
+	virtual bool has_dense_output() const;
+	/*!
+		Solver can advance state of engine 'e', 'run' fails with unsupported engine.
+		Second order ODE solvers need engine with accelerations only output,
+		solvers that need more from engine than forces computation check it too.
+	 */
+	virtual bool is_engine_supported(nbody_engine* e) const;
+protected:
+	//! Next stream dump time, it is max nbcoord_t value when dense output is not requested by 'run'
+	nbcoord_t next_dense_output_time() const;
+	/*!
+		Write state 'y' at time 't' to stream, 't' is not greater than next_dense_output_time()
+		Engine state is not changed.
+	 */
+	void write_dense_output(nbcoord_t t, const nbody_engine::memory* y);
 };
 
 #endif // NBODY_SOLVER_H
@@ -0,0 +1,320 @@
+#include "nbody_solver_abm.h"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+nbody_solver_abm::nbody_solver_abm(size_t max_order, nbcoord_t error_threshold) :
+	nbody_solver(),
+	m_max_order(std::max(max_order, static_cast<size_t>(1))),
+	m_error_threshold(error_threshold),
+	m_predictor(nullptr),
+	m_delta(nullptr),
+	m_f(nullptr),
+	m_tmp(nullptr),
+	m_psi(m_max_order + 1, 0),
+	m_psi_next(m_max_order + 1, 0),
+	m_beta(m_max_order + 1, 1),
+	m_sigma(m_max_order + 1, 1),
+	m_g(m_max_order + 1, 0),
+	m_gcoeff(m_max_order + 1, 0),
+	m_gstar(m_max_order + 2, 1),
+	m_order(0),
+	m_valid(0),
+	m_constant_steps(0),
+	m_start(false),
+	m_control_step(0)
+{
+	// gstar[j] = |gamma*[j]|, Sum(gamma*[i]/(j + 1 - i), i=[0...j]) = 0
+	std::vector<nbcoord_t>	gamma(m_gstar.size(), 1);
+	for(size_t j = 1; j != gamma.size(); ++j)
+	{
+		nbcoord_t	sum = 0;
+		for(size_t i = 0; i != j; ++i)
+		{
+			sum += gamma[i] / static_cast<nbcoord_t>(j + 1 - i);
+		}
+		gamma[j] = -sum;
+		m_gstar[j] = fabs(gamma[j]);
+	}
+}
+
+nbody_solver_abm::~nbody_solver_abm()
+{
+	engine()->free_buffers(m_phi);
+	engine()->free_buffer(m_predictor);
+	engine()->free_buffer(m_delta);
+	engine()->free_buffer(m_f);
+	engine()->free_buffer(m_tmp);
+}
+
+const char* nbody_solver_abm::type_name() const
+{
+	return "nbody_solver_abm";
+}
+
+void nbody_solver_abm::start(nbcoord_t t, nbcoord_t dt, nbody_engine::memory* y)
+{
+	engine()->fcompute(t, y, m_phi[0]);
+
+	// First order step error is about (h/T)^2/2, where T = |y|/|f| is time scale of problem
+	nbcoord_t	fnorm = 0;
+	engine()->fweighted_rms(m_phi[0], y, m_error_threshold, m_error_threshold, fnorm);
+	nbcoord_t	h = dt;
+	if(fnorm > 0)
+	{
+		h = std::min(h, static_cast<nbcoord_t>(0.5) / (fnorm * sqrt(m_error_threshold)));
+	}
+
+	m_control_step = std::max(h, get_min_step());
+	m_order = 1;
+	m_valid = 0;
+	m_constant_steps = 0;
+	m_start = true;
+}
+
+void nbody_solver_abm::step_coefficients(size_t k, nbcoord_t h)
+{
+	// Hairer, Norsett, Wanner "Solving ordinary differential equations I", III.5
+	m_psi_next[0] = h;
+	for(size_t i = 1; i <= k; ++i)
+	{
+		m_psi_next[i] = h + m_psi[i - 1];
+	}
+
+	// Phi*[j] = beta[j]*Phi[j] are differences of constant step history
+	for(size_t j = 1, jmax = std::min(k, m_valid); j <= jmax; ++j)
+	{
+		m_beta[j] = m_beta[j - 1] * m_psi_next[j - 1] / m_psi[j - 1];
+	}
+
+	// Error constants scale, sigma[j] = 1 for constant step
+	for(size_t j = 1; j <= k; ++j)
+	{
+		m_sigma[j] = static_cast<nbcoord_t>(j) * h / m_psi_next[j - 1] * m_sigma[j - 1];
+	}
+
+	// g[j] = c[j][1], c[0][q] = 1/q, c[j][q] = c[j - 1][q] - c[j - 1][q + 1]*h/psi[j]
+	for(size_t q = 0; q <= k; ++q)
+	{
+		m_gcoeff[q] = 1 / static_cast<nbcoord_t>(q + 1);
+	}
+	m_g[0] = 1;
+	for(size_t j = 1; j <= k; ++j)
+	{
+		const nbcoord_t	alpha = h / m_psi_next[j - 1];
+		for(size_t q = 0; q <= k - j; ++q)
+		{
+			m_gcoeff[q] -= m_gcoeff[q + 1] * alpha;
+		}
+		m_g[j] = m_gcoeff[0];
+	}
+}
+
+bool nbody_solver_abm::step(nbcoord_t t, nbcoord_t h, nbody_engine::memory* y, size_t& fails)
+{
+	const size_t			k = m_order;
+	const nbcoord_t			safety = static_cast<nbcoord_t>(0.5);
+	std::vector<nbcoord_t>	coeff(k);
+
+	step_coefficients(k, h);
+
+	// Predict: p = y + h*Sum(g[j]*Phi*[j], j=[0...k))
+	for(size_t j = 0; j != k; ++j)
+	{
+		coeff[j] = h * m_g[j] * m_beta[j];
+	}
+	engine()->fmaddn(m_predictor, y, m_phi, coeff.data(), k);
+
+	// Evaluate and compute k-th difference at predicted state: Phi[k] = f(p) - Sum(Phi*[j], j=[0...k))
+	engine()->fcompute(t + h, m_predictor, m_f);
+	for(size_t j = 0; j != k; ++j)
+	{
+		coeff[j] = -m_beta[j];
+	}
+	engine()->fmaddn(m_delta, m_f, m_phi, coeff.data(), k);
+
+	nbcoord_t	norm = 0;
+	engine()->fweighted_rms(m_delta, y, m_error_threshold, m_error_threshold, norm);
+
+	// Difference of k and k + 1 order correctors and error estimates of orders k - 1 and k
+	const nbcoord_t	error = h * fabs(m_g[k - 1] - m_g[k]) * norm;
+	const nbcoord_t	error_k = h * m_sigma[k] * m_gstar[k] * norm;
+	nbcoord_t		error_km1 = std::numeric_limits<nbcoord_t>::max();
+	if(k > 1)
+	{
+		engine()->fmadd(m_tmp, m_delta, m_phi[k - 1], m_beta[k - 1]);
+		engine()->fweighted_rms(m_tmp, y, m_error_threshold, m_error_threshold, norm);
+		error_km1 = h * m_sigma[k - 1] * m_gstar[k - 1] * norm;
+	}
+
+	// Running step already reduced to min_step is not rejected again, otherwise
+	// last step t_end - t which rounds a bit above min_step is repeated endlessly
+	if(error > 1 && h > get_min_step() && m_control_step > get_min_step())
+	{
+		// Step is repeated with previous history, only m_psi_next and m_beta are changed
+		++fails;
+		m_start = false;
+		m_constant_steps = 0;
+		if(fails >= 3)
+		{
+			m_order = 1;
+		}
+		else if(k > 1 && error_km1 <= error_k)
+		{
+			m_order = k - 1;
+		}
+		const nbcoord_t	factor = pow(safety / error, 1 / static_cast<nbcoord_t>(k + 1));
+		m_control_step = h * std::min(static_cast<nbcoord_t>(0.9), std::max(static_cast<nbcoord_t>(0.2), factor));
+		m_control_step = std::max(m_control_step, get_min_step());
+		return false;
+	}
+	fails = 0;
+
+	// Error estimate of order k + 1 needs Phi[k + 1] = Phi[k] - Phi*[k]
+	const bool	same_step = (m_valid > 0 && h == m_psi[0]);
+	nbcoord_t	error_kp1 = -1;
+	if(k < m_max_order && m_valid >= k && (m_start || (same_step && m_constant_steps >= k)))
+	{
+		engine()->fmadd(m_tmp, m_delta, m_phi[k], -m_beta[k]);
+		engine()->fweighted_rms(m_tmp, y, m_error_threshold, m_error_threshold, norm);
+		error_kp1 = h * m_gstar[k + 1] * norm;
+	}
+
+	// Correct and evaluate
+	engine()->fmadd(y, m_predictor, m_delta, h * m_g[k]);
+	engine()->fcompute(t + h, y, m_f);
+
+	// Update differences with corrected f: Phi[0] = f, Phi[j + 1] = Phi[j] - Phi*[j]
+	const size_t			top = std::min(k, m_valid);
+	nbody_engine::memory*	diff = m_f;
+	nbody_engine::memory*	next = m_tmp;
+	for(size_t j = 0; j <= top; ++j)
+	{
+		engine()->fmadd(next, diff, m_phi[j], -m_beta[j]);
+		std::swap(m_phi[j], diff);
+		std::swap(diff, next);
+	}
+	std::swap(m_phi[top + 1], diff);
+	m_f = diff;
+	m_tmp = next;
+
+	m_valid = top + 1;
+	m_psi.swap(m_psi_next);
+	m_constant_steps = same_step ? m_constant_steps + 1 : 1;
+
+	// Order with least error estimate, it is raised only after k + 1 steps with constant step size
+	size_t		order = k;
+	nbcoord_t	order_error = error;
+	if(k > 1 && error_km1 <= error_k)
+	{
+		order = k - 1;
+		order_error = error_km1;
+		m_start = false;
+	}
+	else if(error_kp1 >= 0 && error_kp1 >= error_k)
+	{
+		m_start = false;
+	}
+	else if(k < m_max_order && (m_start || error_kp1 >= 0))
+	{
+		order = k + 1;
+		order_error = std::max(error, error_kp1);
+	}
+	if(order == m_max_order)
+	{
+		m_start = false;
+	}
+	if(order != k)
+	{
+		m_constant_steps = 0;
+	}
+	m_order = order;
+
+	// Step is doubled or kept while it is possible to keep history of constant step
+	const nbcoord_t	min_error = static_cast<nbcoord_t>(1e-10);
+	nbcoord_t		factor = pow(safety / std::max(order_error, min_error), 1 / static_cast<nbcoord_t>(order + 1));
+	if(factor >= 2)
+	{
+		factor = 2;
+	}
+	else if(factor >= 1)
+	{
+		factor = 1;
+	}
+	else
+	{
+		factor = std::min(static_cast<nbcoord_t>(0.9), std::max(static_cast<nbcoord_t>(0.5), factor));
+	}
+
+	// Last step may be shortened to reach t_end, it does not limit running step
+	if(h < m_control_step && factor >= 1)
+	{
+		m_control_step = std::max(m_control_step, h * factor);
+	}
+	else
+	{
+		m_control_step = std::max(h * factor, get_min_step());
+	}
+	return true;
+}
+
+void nbody_solver_abm::advise(nbcoord_t dt)
+{
+	nbody_engine::memory*	y = engine()->get_y();
+	const nbcoord_t			t0 = engine()->get_time();
+	const nbcoord_t			t_end = t0 + dt;
+	nbcoord_t				t = t0;
+	size_t					fails = 0;
+
+	if(m_phi.empty())
+	{
+		const size_t	size = sizeof(nbcoord_t) * engine()->problem_size();
+		m_phi = engine()->create_buffers(size, m_max_order + 2);
+		m_predictor = engine()->create_buffer(size);
+		m_delta = engine()->create_buffer(size);
+		m_f = engine()->create_buffer(size);
+		m_tmp = engine()->create_buffer(size);
+	}
+
+	if(m_order == 0)
+	{
+		start(t, dt, y);
+	}
+
+	for(bool last = false; !last;)
+	{
+		m_control_step = std::min(m_control_step, dt);
+		nbcoord_t	h = m_control_step;
+		// Stretch step a bit to avoid tiny last step
+		if(t + h * static_cast<nbcoord_t>(1.01) >= t_end)
+		{
+			h = t_end - t;
+			last = true;
+		}
+		if(!step(t, h, y, fails))
+		{
+			last = false;
+			continue;
+		}
+		t += h;
+	}
+
+	engine()->set_time(t0);
+	engine()->advise_time(dt);
+}
+
+void nbody_solver_abm::print_info() const
+{
+	nbody_solver::print_info();
+	qDebug() << "\tmax_order" << m_max_order;
+	qDebug() << "\terror_threshold" << m_error_threshold;
+}
+
+void nbody_solver_abm::reset()
+{
+	m_order = 0;
+	m_valid = 0;
+	m_constant_steps = 0;
+	m_start = false;
+	m_control_step = 0;
+}
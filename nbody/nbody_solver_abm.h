@@ -0,0 +1,68 @@
+#ifndef NBODY_SOLVER_ABM_H
+#define NBODY_SOLVER_ABM_H
+
+#include "nbody_solver.h"
+
+/*!
+   \brief Variable step, variable order Adams-Bashforth-Moulton (PECE) method
+
+   History is kept as modified divided differences Phi[j] of f (Shampine, Gordon,
+   see Hairer, Norsett, Wanner "Solving ordinary differential equations I", III.5),
+   so step size may change at any step without restart.
+   Adams-Bashforth predictor of order k is corrected by Adams-Moulton of order k + 1,
+   step costs two force computations: at predicted and at corrected state.
+   Local error is difference of k and k + 1 order correctors, its weighted RMS norm
+   (absolute and relative tolerance are error_threshold) must not be greater than 1,
+   otherwise step is rejected and repeated with smaller step.
+   Order is chosen from error estimates of orders k - 1, k and k + 1.
+   Solver starts at first order and raises it at each step until max_order is reached
+   or lower order becomes preferable.
+   Each 'advise(dt)' call ends exactly at t + dt, internal step is not greater than dt.
+ */
+class NBODY_DLL nbody_solver_abm : public nbody_solver
+{
+	size_t						m_max_order;
+	nbcoord_t					m_error_threshold;
+	//! Modified divided differences Phi[0...m_max_order + 1], Phi[0] is f at last accepted step
+	nbody_engine::memory_array	m_phi;
+	nbody_engine::memory*		m_predictor;
+	nbody_engine::memory*		m_delta;
+	nbody_engine::memory*		m_f;
+	nbody_engine::memory*		m_tmp;
+	//! psi[i] = t[n] - t[n - i - 1]
+	std::vector<nbcoord_t>		m_psi;
+	std::vector<nbcoord_t>		m_psi_next;
+	std::vector<nbcoord_t>		m_beta;
+	std::vector<nbcoord_t>		m_sigma;
+	std::vector<nbcoord_t>		m_g;
+	std::vector<nbcoord_t>		m_gcoeff;
+	//! Constant step error coefficients of Adams-Moulton methods
+	std::vector<nbcoord_t>		m_gstar;
+	//! Current order, 0 if there is no history
+	size_t						m_order;
+	//! Max valid index of m_phi
+	size_t						m_valid;
+	//! Steps count with current order and step size
+	size_t						m_constant_steps;
+	bool						m_start;
+	nbcoord_t					m_control_step;
+public:
+	explicit nbody_solver_abm(size_t max_order = 12, nbcoord_t error_threshold = 1e-10);
+	~nbody_solver_abm();
+	const char* type_name() const override;
+	void advise(nbcoord_t dt) override;
+	void print_info() const override;
+	void reset() override;
+private:
+	//! Start history from f(t, y)
+	void start(nbcoord_t t, nbcoord_t dt, nbody_engine::memory* y);
+	//! Step coefficients psi, beta, sigma and g of order k for step h
+	void step_coefficients(size_t k, nbcoord_t h);
+	/*!
+		Make step [t, t + h] with current order, on success 'y' is updated,
+		otherwise order and m_control_step are decreased.
+	 */
+	bool step(nbcoord_t t, nbcoord_t h, nbody_engine::memory* y, size_t& fails);
+};
+
+#endif // NBODY_SOLVER_ABM_H
@@ -0,0 +1,232 @@
+#include "nbody_solver_block_step.h"
+#include <QDebug>
+
+namespace {
+//! Maximum bins count, step of the last bin is dt/2^30
+constexpr size_t MAX_LEVELS = 30;
+}
+
+nbody_solver_block_step::nbody_solver_block_step(nbcoord_t eta) :
+	nbody_solver(),
+	m_eta(eta),
+	m_f(nullptr),
+	m_bins(nullptr),
+	m_f_valid(false),
+	m_levels(0)
+{
+}
+
+nbody_solver_block_step::~nbody_solver_block_step()
+{
+	engine()->free_buffer(m_f);
+	engine()->free_buffer(m_bins);
+}
+
+const char* nbody_solver_block_step::type_name() const
+{
+	return "nbody_solver_block_step";
+}
+
+void nbody_solver_block_step::advise(nbcoord_t dt)
+{
+	nbody_engine::memory*	y = engine()->get_y();
+	const nbcoord_t			t = engine()->get_time();
+	const size_t			count = engine()->problem_size() / 6;
+
+	if(m_f == nullptr)
+	{
+		m_f = engine()->create_buffer(sizeof(nbcoord_t) * count * 3);
+		m_bins = engine()->create_buffer(sizeof(nbcoord_t) * count);
+		m_f_valid = false;
+	}
+
+	m_levels = levels_count(dt);
+	m_acc.resize(count * 3);
+	m_bin.resize(count);
+	m_bin_count.assign(m_levels + 1, 0);
+
+	if(m_f_valid)
+	{
+		engine()->read_buffer(m_acc.data(), m_f);
+		engine()->read_buffer(m_bin.data(), m_bins);
+	}
+	else
+	{
+		start(dt);
+	}
+
+	// Opening half-kick of all bodies
+	m_active.resize(count);
+	m_kick.resize(count);
+	for(size_t n = 0; n != count; ++n)
+	{
+		m_bin[n] = std::min(m_bin[n], static_cast<nbcoord_t>(m_levels));
+		m_bin_count[static_cast<size_t>(m_bin[n])]++;
+		m_active[n] = n;
+		m_kick[n] = dt / static_cast<nbcoord_t>(size_t(2) << static_cast<size_t>(m_bin[n]));
+	}
+	engine()->kick_active(y, m_f, m_active, m_kick);
+
+	// Time is counted in ticks of the last bin step
+	const size_t			total = size_t(1) << m_levels;
+	const nbcoord_t			tick_dt = dt / static_cast<nbcoord_t>(total);
+	size_t					tick = 0;
+	std::vector<nbcoord_t>	acc_old;
+
+	while(tick < total)
+	{
+		size_t	max_bin = m_levels;
+		while(m_bin_count[max_bin] == 0)
+		{
+			--max_bin;
+		}
+		const size_t	max_bin_ticks = total >> max_bin;
+		const size_t	next = (tick / max_bin_ticks + 1) * max_bin_ticks;
+
+		// Drift all bodies with their half-step velocities
+		engine()->fmaddn_second_order(y, y, nbody_engine::memory_array(),
+									  static_cast<nbcoord_t>(next - tick) * tick_dt, NULL, NULL, 0);
+		tick = next;
+
+		// Bodies of bins with step boundary at the current tick
+		size_t	first_bin = m_levels;
+		while(first_bin > 0 && tick % (total >> (first_bin - 1)) == 0)
+		{
+			--first_bin;
+		}
+		m_active.clear();
+		for(size_t n = 0; n != count; ++n)
+		{
+			if(static_cast<size_t>(m_bin[n]) >= first_bin)
+			{
+				m_active.push_back(n);
+			}
+		}
+
+		acc_old.resize(m_active.size() * 3);
+		for(size_t n = 0; n != m_active.size(); ++n)
+		{
+			for(size_t d = 0; d != 3; ++d)
+			{
+				acc_old[n + d * m_active.size()] = m_acc[m_active[n] + d * count];
+			}
+		}
+
+		engine()->fcompute_active(t + static_cast<nbcoord_t>(tick) * tick_dt, y, m_f, m_active);
+		engine()->read_buffer(m_acc.data(), m_f);
+
+		// Closing half-kick of the finished step and opening half-kick of the next one
+		m_kick.resize(m_active.size());
+		for(size_t n = 0; n != m_active.size(); ++n)
+		{
+			const size_t	body = m_active[n];
+			const size_t	bin = static_cast<size_t>(m_bin[body]);
+			const nbcoord_t	step = dt / static_cast<nbcoord_t>(size_t(1) << bin);
+			size_t			new_bin = select_bin(body, dt, step, acc_old.data() + n);
+
+			// Greater step is possible only at common boundary with greater bins
+			new_bin = std::max(new_bin, bin > 0 ? bin - 1 : 0);
+			while(new_bin < bin && tick % (total >> new_bin) != 0)
+			{
+				++new_bin;
+			}
+			m_bin_count[bin]--;
+			m_bin_count[new_bin]++;
+			m_bin[body] = static_cast<nbcoord_t>(new_bin);
+
+			m_kick[n] = step / 2;
+			if(tick < total)
+			{
+				m_kick[n] += dt / static_cast<nbcoord_t>(size_t(2) << new_bin);
+			}
+		}
+		engine()->kick_active(y, m_f, m_active, m_kick);
+	}
+
+	engine()->write_buffer(m_bins, m_bin.data());
+	m_f_valid = true;
+	engine()->advise_time(dt);
+}
+
+void nbody_solver_block_step::print_info() const
+{
+	nbody_solver::print_info();
+	qDebug() << "\teta" << m_eta;
+	qDebug() << "\ttime bins" << m_levels + 1;
+}
+
+e_ode_order nbody_solver_block_step::get_ode_order() const
+{
+	return eode_second_order;
+}
+
+void nbody_solver_block_step::reset()
+{
+	m_f_valid = false;
+}
+
+const std::vector<size_t>& nbody_solver_block_step::bin_count() const
+{
+	return m_bin_count;
+}
+
+size_t nbody_solver_block_step::levels_count(nbcoord_t dt) const
+{
+	size_t		levels = 0;
+	nbcoord_t	step = dt;
+	while(step > get_min_step() && levels < MAX_LEVELS)
+	{
+		step /= 2;
+		++levels;
+	}
+	return levels;
+}
+
+size_t nbody_solver_block_step::select_bin(size_t body, nbcoord_t dt, nbcoord_t step,
+										   const nbcoord_t* acc_old) const
+{
+	const size_t	count = m_bin.size();
+	const size_t	active_count = m_active.size();
+	const nbvertex_t	a(m_acc[body], m_acc[body + count], m_acc[body + 2 * count]);
+	const nbvertex_t	a_old(acc_old[0], acc_old[active_count], acc_old[2 * active_count]);
+	const nbcoord_t	da = (a - a_old).length();
+
+	if(da > 0)
+	{
+		// eta*|a|/|da/dt|
+		return step_bin(dt, m_eta * a.length() * step / da);
+	}
+	return 0;
+}
+
+size_t nbody_solver_block_step::step_bin(nbcoord_t dt, nbcoord_t step) const
+{
+	size_t	bin = 0;
+	while(bin < m_levels && dt / static_cast<nbcoord_t>(size_t(1) << bin) > step)
+	{
+		++bin;
+	}
+	return bin;
+}
+
+void nbody_solver_block_step::start(nbcoord_t dt)
+{
+	nbody_engine::memory*	y = engine()->get_y();
+	const size_t			count = engine()->problem_size() / 6;
+	std::vector<nbcoord_t>	state(count * 6);
+
+	engine()->fcompute(engine()->get_time(), y, m_f);
+	engine()->read_buffer(m_acc.data(), m_f);
+	engine()->read_buffer(state.data(), y);
+
+	// There is no acceleration history, so initial step is eta*|v|/|a|
+	const nbcoord_t*	v = state.data() + 3 * count;
+	for(size_t n = 0; n != count; ++n)
+	{
+		const nbvertex_t	vn(v[n], v[n + count], v[n + 2 * count]);
+		const nbvertex_t	an(m_acc[n], m_acc[n + count], m_acc[n + 2 * count]);
+		const nbcoord_t		alen = an.length();
+
+		m_bin[n] = (alen > 0) ? static_cast<nbcoord_t>(step_bin(dt, m_eta * vn.length() / alen)) : 0;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef NBODY_SOLVER_BLOCK_STEP_H
+#define NBODY_SOLVER_BLOCK_STEP_H
+
+#include "nbody_solver.h"
+
+/*!
+   \brief Kick-drift-kick leapfrog with hierarchical block individual time steps
+
+   Each body has a time bin k and moves with the step dt/2^k, where dt is
+   the solver step. Step of a body is chosen as eta*|a|/|da/dt|, rounded down
+   to a power of two and clamped to [min_step, max_step]. Bodies of
+   the same bin are kicked together, forces are computed only for bodies
+   at the end of their step (nbody_engine::fcompute_active).
+   All bodies are drifted to each bin boundary, which is O(N) and cheap
+   compared to force computation.
+*/
+class NBODY_DLL nbody_solver_block_step : public nbody_solver
+{
+	nbcoord_t				m_eta;
+	//! Accelerations (problem_size() / 2 values)
+	nbody_engine::memory*	m_f;
+	//! Time bins of bodies (kept at engine to follow bodies reorder)
+	nbody_engine::memory*	m_bins;
+	bool					m_f_valid;
+	size_t					m_levels;
+	std::vector<nbcoord_t>	m_acc;
+	std::vector<nbcoord_t>	m_bin;
+	std::vector<size_t>		m_bin_count;
+	std::vector<size_t>		m_active;
+	std::vector<nbcoord_t>	m_kick;
+public:
+	explicit nbody_solver_block_step(nbcoord_t eta = 0.005);
+	~nbody_solver_block_step();
+	const char* type_name() const override;
+	void advise(nbcoord_t dt) override;
+	void print_info() const override;
+	e_ode_order get_ode_order() const override;
+	void reset() override;
+	//! Count of bodies at each time bin after the last step
+	const std::vector<size_t>& bin_count() const;
+private:
+	size_t levels_count(nbcoord_t dt) const;
+	size_t select_bin(size_t body, nbcoord_t dt, nbcoord_t step, const nbcoord_t* acc_old) const;
+	//! Smallest bin with step dt/2^bin not greater than 'step'
+	size_t step_bin(nbcoord_t dt, nbcoord_t step) const;
+	void start(nbcoord_t dt);
+};
+
+#endif // NBODY_SOLVER_BLOCK_STEP_H
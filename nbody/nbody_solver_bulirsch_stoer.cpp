@@ -2,6 +2,7 @@
 #include "nbody_solver_midpoint_stetter.h"
 #include "nbody_extrapolator.h"
 #include <QDebug>
+#include <omp.h>
 
 namespace {
 std::vector<size_t> init_steps(size_t n, e_bs_sub type)
@@ -38,6 +39,34 @@ std::vector<size_t> init_steps(size_t n, e_bs_sub type)
 }
 }//namespace
 
+const char* bs_control_name(e_bs_control control)
+{
+	switch(control)
+	{
+	case ebsc_fixed:
+		return "fixed";
+	case ebsc_deuflhard:
+		return "deuflhard";
+	default:
+		return "";
+	}
+	return "";
+}
+
+e_bs_control bs_control_from_str(const QString& name)
+{
+	if(name == "fixed")
+	{
+		return ebsc_fixed;
+	}
+	else if(name == "deuflhard")
+	{
+		return ebsc_deuflhard;
+	}
+
+	return ebsc_unknown;
+}
+
 nbody_solver_bulirsch_stoer::nbody_solver_bulirsch_stoer(
 	size_t max_level, nbcoord_t error_threshold) :
 	nbody_solver(),
@@ -46,7 +75,11 @@ nbody_solver_bulirsch_stoer::nbody_solver_bulirsch_stoer(
 	m_error_threshold(error_threshold),
 	m_sub_steps_count(init_steps(m_max_level, ebssub_bulirsch_stoer)),
 	m_y0(nullptr),
-	m_extrapolator(nullptr)
+	m_extrapolator(nullptr),
+	m_clones_compute_count(0),
+	m_control(ebsc_fixed),
+	m_control_step(0),
+	m_control_level(0)
 {
 }
 
@@ -55,6 +88,26 @@ nbody_solver_bulirsch_stoer::~nbody_solver_bulirsch_stoer()
 	engine()->free_buffer(m_y0);
 	delete m_extrapolator;
 	delete m_internal;
+	for(nbody_solver* s : m_clone_solvers)
+	{
+		delete s;
+	}
+	for(nbody_engine* e : m_clones)
+	{
+		delete e;
+	}
+}
+
+void nbody_solver_bulirsch_stoer::set_control(e_bs_control control)
+{
+	m_control = control;
+	m_sub_steps_count = init_steps(m_max_level, control == ebsc_deuflhard ?
+								   ebssub_deuflhard : ebssub_bulirsch_stoer);
+}
+
+e_bs_control nbody_solver_bulirsch_stoer::get_control() const
+{
+	return m_control;
 }
 
 const char* nbody_solver_bulirsch_stoer::type_name() const
@@ -62,59 +115,254 @@ const char* nbody_solver_bulirsch_stoer::type_name() const
 	return "nbody_solver_bulirsch_stoer";
 }
 
-void nbody_solver_bulirsch_stoer::compute_substep(size_t level, nbcoord_t dt, nbcoord_t t0)
+void nbody_solver_bulirsch_stoer::create_clones()
 {
-	nbody_engine::memory*	y = engine()->get_y();
+	const size_t	count = std::min(static_cast<size_t>(omp_get_max_threads()), m_max_level);
+	if(count < 2)
+	{
+		return;
+	}
+	for(size_t n = 0; n != count; ++n)
+	{
+		nbody_engine*	clone = engine()->clone();
+		if(clone == NULL)
+		{
+			break;
+		}
+		nbody_solver*	internal = new nbody_solver_midpoint_stetter();
+		internal->set_engine(clone);
+		m_clones.push_back(clone);
+		m_clone_solvers.push_back(internal);
+	}
+}
 
-	engine()->copy_buffer(y, m_y0);
-	engine()->set_time(t0);
+size_t nbody_solver_bulirsch_stoer::batch_size() const
+{
+	return m_clones.empty() ? 1 : m_clones.size();
+}
+
+void nbody_solver_bulirsch_stoer::compute_substep(nbody_solver* internal, size_t level,
+												  nbcoord_t dt, nbcoord_t t0)
+{
+	nbody_engine*			e = internal->engine();
+	nbody_engine::memory*	y = e->get_y();
+
+	e->copy_buffer(y, m_y0);
+	e->set_time(t0);
 
 	// Compute ODE solution with step 'dt / substeps_count'
 	size_t		substeps_count = m_sub_steps_count[level];
 	nbcoord_t	substep_dt = dt / substeps_count;
 
-	m_internal->reset();
+	internal->reset();
 	for(size_t substep_n = 0; substep_n != substeps_count; ++substep_n)
 	{
-		m_internal->advise(substep_dt);
+		internal->advise(substep_dt);
+	}
+}
+
+nbody_engine::memory_array nbody_solver_bulirsch_stoer::compute_levels(size_t first, size_t last,
+																		nbcoord_t dt, nbcoord_t t0)
+{
+	const size_t	count = last - first;
+
+	// Single level is computed at this engine, it may use all threads itself
+	if(count == 1)
+	{
+		compute_substep(m_internal, first, dt, t0);
+		return nbody_engine::memory_array(1, engine()->get_y());
 	}
 
-	m_extrapolator->update_table(level, y);
+	// Longest level goes first
+	#pragma omp parallel for schedule(dynamic, 1)
+	for(size_t n = 0; n < count; ++n)
+	{
+		compute_substep(m_clone_solvers[count - 1 - n], last - 1 - n, dt, t0);
+	}
+
+	nbody_engine::memory_array	result(count);
+	size_t						clones_compute_count = 0;
+	for(size_t n = 0; n != m_clones.size(); ++n)
+	{
+		if(n < count)
+		{
+			result[n] = m_clones[n]->get_y();
+		}
+		clones_compute_count += m_clones[n]->get_compute_count();
+	}
+	engine()->advise_compute_count((clones_compute_count - m_clones_compute_count) *
+								   (engine()->problem_size() / 6));
+	m_clones_compute_count = clones_compute_count;
+
+	return result;
 }
 
-void nbody_solver_bulirsch_stoer::advise(nbcoord_t dt)
+nbcoord_t nbody_solver_bulirsch_stoer::level_work(size_t level) const
 {
-	if(m_y0 == nullptr)
+	// Midpoint-Stetter method makes two force computations per substep and one at start
+	const size_t	batch = batch_size();
+	size_t			work = 0;
+	for(size_t first = 0; first <= level; first += batch)
 	{
-		size_t size = sizeof(nbcoord_t) * engine()->problem_size();
-		m_y0 = engine()->create_buffer(size);
-		m_extrapolator = nbody_create_extrapolator("neville", engine(), 2, m_sub_steps_count);
-		m_internal = new nbody_solver_midpoint_stetter();
-		m_internal->set_engine(engine());
+		work += 2 * m_sub_steps_count[std::min(level, first + batch - 1)] + 1;
 	}
+	return static_cast<nbcoord_t>(work);
+}
 
+void nbody_solver_bulirsch_stoer::fixed_step(nbcoord_t dt, nbcoord_t t0)
+{
 	nbody_engine::memory*	y = engine()->get_y();
-	nbcoord_t				t0(engine()->get_time());
 
 	engine()->copy_buffer(m_y0, y);
 
-	for(size_t level = 0; level != m_max_level; ++level)
+	for(size_t level = 0; level != m_max_level;)
 	{
-//		QDebug	g(qDebug());
-//		g << level << engine()->get_time() << t0;
-		compute_substep(level, dt, t0);
+		// Levels 0, 1 and 2 are always needed, next ones are computed only while error is too big
+		const size_t	first = level;
+		const size_t	last = std::min(m_max_level, first + (first < 3 ? std::min(batch_size(), 3 - first) : 1));
+		const nbody_engine::memory_array	state(compute_levels(first, last, dt, t0));
 
-		if(level < 2)
+		for(; level != last; ++level)
 		{
+			m_extrapolator->update_table(level, state[level - first]);
+
+			const bool	last_level = (level + 1 == m_max_level);
+			if(level < 2 && !last_level)
+			{
+				continue;
+			}
+			if(last_level || m_extrapolator->estimate_error(level) < m_error_threshold)
+			{
+				m_extrapolator->extrapolate(level, y);
+				return;
+			}
+		}
+	}
+}
+
+void nbody_solver_bulirsch_stoer::deuflhard_step(nbcoord_t dt, nbcoord_t t)
+{
+	// Hairer, Norsett, Wanner "Solving ordinary differential equations I", II.9
+	const nbcoord_t			safety1 = static_cast<nbcoord_t>(0.65);
+	const nbcoord_t			safety2 = static_cast<nbcoord_t>(0.94);
+	const nbcoord_t			min_factor = static_cast<nbcoord_t>(0.25);
+	const nbcoord_t			max_factor = 50;
+	const nbcoord_t			work_ratio = static_cast<nbcoord_t>(0.9);
+	const size_t			max_level = m_max_level - 1;
+	const nbcoord_t			t_end = t + dt;
+	nbody_engine::memory*	y = engine()->get_y();
+	std::vector<nbcoord_t>	step(m_max_level);
+	std::vector<nbcoord_t>	work(m_max_level);
+
+	if(m_control_step <= 0)
+	{
+		// Initial table size from tolerance
+		const nbcoord_t	level = static_cast<nbcoord_t>(0.6) * -log10(m_error_threshold) + static_cast<nbcoord_t>(0.5);
+		m_control_step = dt;
+		m_control_level = std::min(max_level, std::max(static_cast<size_t>(1),
+													   static_cast<size_t>(std::max(level, 0_f))));
+	}
+
+	for(bool last = false; !last;)
+	{
+		nbcoord_t	h = m_control_step;
+		// Stretch step a bit to avoid tiny last step
+		if(t + h * static_cast<nbcoord_t>(1.01) >= t_end)
+		{
+			h = t_end - t;
+			last = true;
+		}
+
+		const size_t	k = m_control_level;
+		nbcoord_t		error = 0;
+
+		engine()->copy_buffer(m_y0, y);
+
+		for(size_t level = 0; level <= k;)
+		{
+			const size_t	first = level;
+			const size_t	end = std::min(k + 1, first + batch_size());
+			const nbody_engine::memory_array	state(compute_levels(first, end, h, t));
+
+			for(; level != end; ++level)
+			{
+				m_extrapolator->update_table(level, state[level - first]);
+				if(level == 0)
+				{
+					continue;
+				}
+				// Error estimate of T[level][level] is O(h^(2*level + 1))
+				error = m_extrapolator->estimate_error(level) / m_error_threshold;
+				nbcoord_t	factor = pow(error / safety1, 1 / static_cast<nbcoord_t>(2 * level + 1)) / safety2;
+				factor = std::min(max_factor, std::max(min_factor, factor));
+				step[level] = h / factor;
+				work[level] = level_work(level) / step[level];
+			}
+		}
+
+		// Table size with minimal work per unit step
+		size_t		next = k;
+		nbcoord_t	next_step = step[k];
+		if(k > 1 && work[k - 1] < work_ratio * work[k])
+		{
+			next = k - 1;
+			next_step = step[next];
+		}
+		else if(k < max_level && work[k] < work_ratio * work[k - 1])
+		{
+			next = k + 1;
+			next_step = step[k] * level_work(next) / level_work(k);
+		}
+
+		// Step clamped to min_step can not be reduced further and is accepted,
+		// last step t_end - t may be a bit longer than min_step by rounding
+		if(error > 1 && h > get_min_step() && m_control_step > get_min_step())
+		{
+			// Single level batches are computed at engine's state
+			engine()->copy_buffer(y, m_y0);
+			m_control_level = std::min(next, k);
+			m_control_step = std::max(std::min(step[m_control_level], h), get_min_step());
+			last = false;
 			continue;
 		}
-		nbcoord_t	maxdiff = m_extrapolator->estimate_error(level);
-//		g << engine()->get_time() << t0 << dt << maxdiff;
-		if(maxdiff < m_error_threshold || level == m_max_level - 1)
+
+		m_extrapolator->extrapolate(k, y);
+		t += h;
+		m_control_level = next;
+
+		// Last step may be shortened to reach t_end, it does not limit running step
+		if(h < m_control_step && next_step >= h)
 		{
-			m_extrapolator->extrapolate(level, y);
-			break;
+			m_control_step = std::max(m_control_step, next_step);
 		}
+		else
+		{
+			m_control_step = std::max(next_step, get_min_step());
+		}
+	}
+}
+
+void nbody_solver_bulirsch_stoer::advise(nbcoord_t dt)
+{
+	if(m_y0 == nullptr)
+	{
+		size_t size = sizeof(nbcoord_t) * engine()->problem_size();
+		m_y0 = engine()->create_buffer(size);
+		m_extrapolator = nbody_create_extrapolator("neville", engine(), 2, m_sub_steps_count);
+		m_internal = new nbody_solver_midpoint_stetter();
+		m_internal->set_engine(engine());
+		create_clones();
+	}
+
+	nbcoord_t	t0(engine()->get_time());
+
+	if(m_control == ebsc_deuflhard && m_max_level > 1)
+	{
+		deuflhard_step(dt, t0);
+	}
+	else
+	{
+		fixed_step(dt, t0);
 	}
 
 	engine()->set_time(t0);
@@ -126,4 +374,12 @@ void nbody_solver_bulirsch_stoer::print_info() const
 	nbody_solver::print_info();
 	qDebug() << "\tmax_level" << m_max_level;
 	qDebug() << "\terror_threshold" << m_error_threshold;
+	qDebug() << "\tcontrol" << bs_control_name(m_control);
+	qDebug() << "\tengine clones" << m_clones.size();
+}
+
+void nbody_solver_bulirsch_stoer::reset()
+{
+	m_control_step = 0;
+	m_control_level = 0;
 }
@@ -7,8 +7,24 @@ class nbody_extrapolator;
 
 enum e_bs_sub { ebssub_bulirsch_stoer, ebssub_deuflhard };
 
+//! Order and step control of Bulirsch-Stoer solver
+enum e_bs_control
+{
+	ebsc_fixed,		// Fixed step, levels are added until error is less than error_threshold
+	ebsc_deuflhard,	// Deuflhard adaptive order and step size
+
+	ebsc_unknown = 0xffffffff
+};
+
+const char NBODY_DLL* bs_control_name(e_bs_control control);
+e_bs_control NBODY_DLL bs_control_from_str(const QString& name);
+
 /*!
 	Bulirsch-Stoer solver
+
+	Extrapolation levels are independent until extrapolation table update,
+	so they are computed concurrently on engine clones (see nbody_engine::clone)
+	and put to the table in level order. Without clones levels are computed serially.
 */
 class NBODY_DLL nbody_solver_bulirsch_stoer : public nbody_solver
 {
@@ -18,15 +34,46 @@ class NBODY_DLL nbody_solver_bulirsch_stoer : public nbody_solver
 	std::vector<size_t>			m_sub_steps_count;
 	nbody_engine::memory*		m_y0;
 	nbody_extrapolator*			m_extrapolator;
+	//! Engine clones and their internal solvers, one level of batch per clone
+	std::vector<nbody_engine*>	m_clones;
+	std::vector<nbody_solver*>	m_clone_solvers;
+	size_t						m_clones_compute_count;
+	e_bs_control				m_control;
+	//! Deuflhard control running step and last level of extrapolation table
+	nbcoord_t					m_control_step;
+	size_t						m_control_level;
 public:
 	explicit nbody_solver_bulirsch_stoer(size_t max_level = 8,
 										 nbcoord_t error_threshold = 1e-4);
 	~nbody_solver_bulirsch_stoer();
+	/*!
+		With ebsc_deuflhard solver keeps its own step size and extrapolation table size between 'advise' calls,
+		both are chosen to minimize work per unit step (Hairer, Norsett, Wanner, Solving ODE I, II.9).
+		Work of level is its force computations count, levels of batch computed concurrently
+		count as the longest one. Step is rejected if error estimate is greater than error_threshold.
+		Each 'advise(dt)' call ends exactly at t + dt.
+		Must be called before first 'advise' call.
+	 */
+	void set_control(e_bs_control control);
+	e_bs_control get_control() const;
 	const char* type_name() const override;
 	void advise(nbcoord_t dt) override;
 	void print_info() const override;
+	void reset() override;
 private:
-	void compute_substep(size_t level, nbcoord_t dt, nbcoord_t t0);
+	void create_clones();
+	//! Levels count computed at once
+	size_t batch_size() const;
+	void compute_substep(nbody_solver* internal, size_t level, nbcoord_t dt, nbcoord_t t0);
+	/*!
+		Compute levels [first, last) from m_y0 and return their states.
+		'last - first' must not be greater than batch_size(), single level is computed at solver's engine.
+	 */
+	nbody_engine::memory_array compute_levels(size_t first, size_t last, nbcoord_t dt, nbcoord_t t0);
+	//! Force computations count of levels [0, level] with batch computation
+	nbcoord_t level_work(size_t level) const;
+	void fixed_step(nbcoord_t dt, nbcoord_t t0);
+	void deuflhard_step(nbcoord_t dt, nbcoord_t t0);
 };
 
 #endif // NBODY_SOLVER_BULIRSCH_STOER_H
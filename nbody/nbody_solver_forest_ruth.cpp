@@ -0,0 +1,15 @@
+#include "nbody_solver_forest_ruth.h"
+#include <cmath>
+
+nbody_solver_forest_ruth::nbody_solver_forest_ruth() : nbody_solver_symplectic()
+{
+	const nbcoord_t	theta = 1_f / (2_f - cbrt(2_f));
+
+	set_splitting({theta / 2_f, (1_f - theta) / 2_f, (1_f - theta) / 2_f, theta / 2_f},
+				  {theta, 1_f - 2_f * theta, theta});
+}
+
+const char* nbody_solver_forest_ruth::type_name() const
+{
+	return "nbody_solver_forest_ruth";
+}
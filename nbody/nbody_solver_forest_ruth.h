@@ -0,0 +1,16 @@
+#ifndef NBODY_SOLVER_FOREST_RUTH_H
+#define NBODY_SOLVER_FOREST_RUTH_H
+
+#include "nbody_solver_symplectic.h"
+
+/*!
+   \brief Forest-Ruth drift-kick-drift 4-order method
+*/
+class NBODY_DLL nbody_solver_forest_ruth : public nbody_solver_symplectic
+{
+public:
+	nbody_solver_forest_ruth();
+	const char* type_name() const override;
+};
+
+#endif // NBODY_SOLVER_FOREST_RUTH_H
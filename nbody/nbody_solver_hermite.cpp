@@ -0,0 +1,84 @@
+#include "nbody_solver_hermite.h"
+
+nbody_solver_hermite::nbody_solver_hermite() :
+	nbody_solver(),
+	m_yp(nullptr),
+	m_a0(nullptr),
+	m_j0(nullptr),
+	m_a1(nullptr),
+	m_j1(nullptr),
+	m_f_valid(false)
+{
+}
+
+nbody_solver_hermite::~nbody_solver_hermite()
+{
+	engine()->free_buffer(m_yp);
+	engine()->free_buffer(m_a0);
+	engine()->free_buffer(m_j0);
+	engine()->free_buffer(m_a1);
+	engine()->free_buffer(m_j1);
+}
+
+const char* nbody_solver_hermite::type_name() const
+{
+	return "nbody_solver_hermite";
+}
+
+void nbody_solver_hermite::advise(nbcoord_t dt)
+{
+	nbody_engine::memory*	y = engine()->get_y();
+	nbcoord_t				t = engine()->get_time();
+	const size_t			ps = engine()->problem_size();
+
+	if(m_yp == nullptr)
+	{
+		m_yp = engine()->create_buffer(sizeof(nbcoord_t) * ps);
+		m_a0 = engine()->create_buffer(sizeof(nbcoord_t) * ps / 2);
+		m_j0 = engine()->create_buffer(sizeof(nbcoord_t) * ps / 2);
+		m_a1 = engine()->create_buffer(sizeof(nbcoord_t) * ps / 2);
+		m_j1 = engine()->create_buffer(sizeof(nbcoord_t) * ps / 2);
+		m_f_valid = false;
+	}
+
+	if(!m_f_valid)
+	{
+		engine()->fcompute_with_jerk(t, y, m_a0, m_j0);
+	}
+
+	const nbcoord_t	dt2 = dt * dt;
+	const nbcoord_t	dt3 = dt2 * dt;
+
+	{
+		const nbody_engine::memory_array	aj({m_a0, m_j0});
+		const nbcoord_t						dx[] = {dt2 / 2, dt3 / 6};
+		const nbcoord_t						dv[] = {dt, dt2 / 2};
+		engine()->fmaddn_second_order(m_yp, y, aj, dt, dx, dv, 2);
+	}
+
+	engine()->fcompute_with_jerk(t + dt, m_yp, m_a1, m_j1);
+
+	{
+		// x1 = x + v*dt + (a0/3 + a1/6)*dt^2 + (j0 - j1)*dt^3/24 with v1 substituted
+		const nbody_engine::memory_array	aj({m_a0, m_a1, m_j0, m_j1});
+		const nbcoord_t						dx[] = {dt2 / 3, dt2 / 6, dt3 / 24, -dt3 / 24};
+		const nbcoord_t						dv[] = {dt / 2, dt / 2, dt2 / 12, -dt2 / 12};
+		engine()->fmaddn_second_order(y, y, aj, dt, dx, dv, 4);
+	}
+
+	std::swap(m_a0, m_a1);
+	std::swap(m_j0, m_j1);
+	m_f_valid = true;
+
+	engine()->advise_time(dt);
+}
+
+e_ode_order nbody_solver_hermite::get_ode_order() const
+{
+	return eode_second_order;
+}
+
+void nbody_solver_hermite::reset()
+{
+	m_f_valid = false;
+}
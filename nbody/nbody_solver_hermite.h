@@ -0,0 +1,33 @@
+#ifndef NBODY_SOLVER_HERMITE_H
+#define NBODY_SOLVER_HERMITE_H
+
+#include "nbody_solver.h"
+
+/*!
+   \brief Hermite 4-order predictor-corrector method for second order ODE x" = a(x)
+
+   Acceleration a and jerk j = da/dt are computed in single engine call
+   (nbody_engine::fcompute_with_jerk), so step costs one force computation.
+   Predictor: xp = x + v*dt + a0*dt^2/2 + j0*dt^3/6, vp = v + a0*dt + j0*dt^2/2
+   Corrector: v1 = v + (a0 + a1)*dt/2 + (j0 - j1)*dt^2/12
+              x1 = x + (v + v1)*dt/2 + (a0 - a1)*dt^2/12
+   Accelerations and jerks at predicted state are reused at the next step.
+*/
+class NBODY_DLL nbody_solver_hermite : public nbody_solver
+{
+	nbody_engine::memory*	m_yp;
+	nbody_engine::memory*	m_a0;
+	nbody_engine::memory*	m_j0;
+	nbody_engine::memory*	m_a1;
+	nbody_engine::memory*	m_j1;
+	bool					m_f_valid;
+public:
+	nbody_solver_hermite();
+	~nbody_solver_hermite();
+	const char* type_name() const override;
+	void advise(nbcoord_t dt) override;
+	e_ode_order get_ode_order() const override;
+	void reset() override;
+};
+
+#endif // NBODY_SOLVER_HERMITE_H
@@ -0,0 +1,11 @@
+#include "nbody_solver_leapfrog.h"
+
+nbody_solver_leapfrog::nbody_solver_leapfrog() : nbody_solver_symplectic()
+{
+	set_leapfrog_composition({1_f});
+}
+
+const char* nbody_solver_leapfrog::type_name() const
+{
+	return "nbody_solver_leapfrog";
+}
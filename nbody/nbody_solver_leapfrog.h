@@ -0,0 +1,16 @@
+#ifndef NBODY_SOLVER_LEAPFROG_H
+#define NBODY_SOLVER_LEAPFROG_H
+
+#include "nbody_solver_symplectic.h"
+
+/*!
+   \brief Kick-drift-kick leapfrog (Stormer-Verlet) 2-order method
+*/
+class NBODY_DLL nbody_solver_leapfrog : public nbody_solver_symplectic
+{
+public:
+	nbody_solver_leapfrog();
+	const char* type_name() const override;
+};
+
+#endif // NBODY_SOLVER_LEAPFROG_H
@@ -1,9 +1,112 @@
 #include "nbody_solver_rk_butcher.h"
 #include <QDebug>
+#include <algorithm>
+
+namespace {
+/*!
+	Solve m*x = rhs by Gaussian elimination with partial pivoting, 'm' is n x n row-major matrix.
+	Result is stored to 'rhs'.
+*/
+bool solve_linear_system(std::vector<nbcoord_t> m, std::vector<nbcoord_t>& rhs, size_t n)
+{
+	for(size_t col = 0; col != n; ++col)
+	{
+		size_t	pivot = col;
+		for(size_t row = col + 1; row != n; ++row)
+		{
+			if(fabs(m[row * n + col]) > fabs(m[pivot * n + col]))
+			{
+				pivot = row;
+			}
+		}
+		if(m[pivot * n + col] == 0)
+		{
+			return false;
+		}
+		for(size_t k = 0; k != n; ++k)
+		{
+			std::swap(m[pivot * n + k], m[col * n + k]);
+		}
+		std::swap(rhs[pivot], rhs[col]);
+		for(size_t row = col + 1; row != n; ++row)
+		{
+			const nbcoord_t	f = m[row * n + col] / m[col * n + col];
+			for(size_t k = col; k != n; ++k)
+			{
+				m[row * n + k] -= f * m[col * n + k];
+			}
+			rhs[row] -= f * rhs[col];
+		}
+	}
+	for(size_t col = n; col-- != 0;)
+	{
+		for(size_t k = col + 1; k != n; ++k)
+		{
+			rhs[col] -= m[col * n + k] * rhs[k];
+		}
+		rhs[col] /= m[col * n + col];
+	}
+	return true;
+}
+}
+
+const char* step_control_name(e_step_control control)
+{
+	switch(control)
+	{
+	case esc_subdivision:
+		return "subdivision";
+	case esc_pi:
+		return "pi";
+	default:
+		return "";
+	}
+	return "";
+}
+
+e_step_control step_control_from_str(const QString& name)
+{
+	if(name == "subdivision")
+	{
+		return esc_subdivision;
+	}
+	else if(name == "pi")
+	{
+		return esc_pi;
+	}
+
+	return esc_unknown;
+}
 
 nbody_solver_rk_butcher::nbody_solver_rk_butcher(nbody_butcher_table* t) :
 	nbody_solver(),
 	m_bt(t),
+	m_rkn(nullptr),
+	m_t(nullptr),
+	m_tmpk(nullptr),
+	m_ycorr_data(nullptr),
+	m_tcorr_data(nullptr),
+	m_max_recursion(8),
+	m_substep_subdivisions(8),
+	m_error_threshold(1e-4),
+	m_refine_steps_count(1),
+	m_correction(false),
+	m_ode_order(eode_first_order),
+	m_step_control(esc_subdivision),
+	m_control_step(0),
+	m_prev_error(1),
+	m_implicit_tolerance(0),
+	m_anderson_depth(0),
+	m_anderson_count(0),
+	m_stages_t(0),
+	m_stages_dt(0)
+{
+}
+
+nbody_solver_rk_butcher::nbody_solver_rk_butcher(nbody_butcher_table_rkn* t) :
+	nbody_solver(),
+	m_bt(nullptr),
+	m_rkn(t),
 	m_t(nullptr),
 	m_tmpk(nullptr),
 	m_ycorr_data(nullptr),
@@ -12,19 +115,37 @@ nbody_solver_rk_butcher::nbody_solver_rk_butcher(nbody_butcher_table* t) :
 	m_substep_subdivisions(8),
 	m_error_threshold(1e-4),
 	m_refine_steps_count(1),
-	m_correction(false)
+	m_correction(false),
+	m_ode_order(eode_second_order),
+	m_step_control(esc_subdivision),
+	m_control_step(0),
+	m_prev_error(1),
+	m_implicit_tolerance(0),
+	m_anderson_depth(0),
+	m_anderson_count(0),
+	m_stages_t(0),
+	m_stages_dt(0)
 {
 }
 
 nbody_solver_rk_butcher::~nbody_solver_rk_butcher()
 {
 	delete m_bt;
+	delete m_rkn;
 	engine()->free_buffers(m_k);;
 	engine()->free_buffer(m_t);
 	engine()->free_buffer(m_tmpk);
 	engine()->free_buffer(m_ycorr_data);
 	engine()->free_buffer(m_tcorr_data);
 	engine()->free_buffers(m_y_stack);
+	engine()->free_buffers(m_kdelta);
+	engine()->free_buffers(m_anderson_f);
+	engine()->free_buffers(m_anderson_g);
+	for(size_t i = 0; i != m_anderson_df.size(); ++i)
+	{
+		engine()->free_buffers(m_anderson_df[i]);
+		engine()->free_buffers(m_anderson_dg[i]);
+	}
 }
 
 const char* nbody_solver_rk_butcher::type_name() const
@@ -57,12 +178,56 @@ void nbody_solver_rk_butcher::set_correction(bool corr)
 	m_correction = corr;
 }
 
+void nbody_solver_rk_butcher::set_implicit_tolerance(nbcoord_t tolerance)
+{
+	m_implicit_tolerance = tolerance;
+}
+
+void nbody_solver_rk_butcher::set_anderson_depth(size_t depth)
+{
+	m_anderson_depth = depth;
+}
+
+void nbody_solver_rk_butcher::set_step_control(e_step_control control)
+{
+	m_step_control = control;
+}
+
+e_step_control nbody_solver_rk_butcher::get_step_control() const
+{
+	return m_step_control;
+}
+
+void nbody_solver_rk_butcher::set_ode_order(e_ode_order order)
+{
+	if(m_bt == nullptr)
+	{
+		if(order != eode_second_order)
+		{
+			qDebug() << "Runge-Kutta-Nystrom solver supports only second order ODE";
+		}
+		return;
+	}
+	m_ode_order = order;
+	if(m_ode_order == eode_second_order && m_rkn == nullptr)
+	{
+		m_rkn = new nbody_butcher_table_rkn_induced(m_bt);
+	}
+}
+
 void nbody_solver_rk_butcher::advise(nbcoord_t dt)
 {
 	nbody_engine::memory*	y = engine()->get_y();
 	nbcoord_t				t = engine()->get_time();
 
-	sub_step(1, t, dt, y, 0);
+	if(m_step_control == esc_pi && is_embedded() && error_order() != 0)
+	{
+		pi_control_step(t, dt, y);
+	}
+	else
+	{
+		sub_step(1, t, dt, y, 0);
+	}
 
 	engine()->advise_time(dt);
 }
@@ -74,11 +239,27 @@ void nbody_solver_rk_butcher::print_info() const
 	qDebug() << "\tsubstep_subdivisions" << m_substep_subdivisions;
 	qDebug() << "\terror_threshold" << m_error_threshold;
 	qDebug() << "\trefine_steps_count" << m_refine_steps_count;
+	qDebug() << "\timplicit_tolerance" << m_implicit_tolerance;
+	qDebug() << "\tanderson_depth" << m_anderson_depth;
 	qDebug() << "\tcorrection" << m_correction;
+	qDebug() << "\tstep_control" << step_control_name(m_step_control);
+}
+
+e_ode_order nbody_solver_rk_butcher::get_ode_order() const
+{
+	return m_ode_order;
+}
+
+bool nbody_solver_rk_butcher::has_dense_output() const
+{
+	return m_bt != nullptr && !m_bt->is_implicit() && m_bt->is_embedded();
 }
 
 void nbody_solver_rk_butcher::reset()
 {
+	m_control_step = 0;
+	m_prev_error = 1;
+	m_stages_dt = 0;
 	if(m_ycorr_data != nullptr)
 	{
 		engine()->fill_buffer(m_ycorr_data, 0);
@@ -94,20 +275,61 @@ const nbody_butcher_table* nbody_solver_rk_butcher::table() const
 	return m_bt;
 }
 
-void nbody_solver_rk_butcher::sub_step_implicit(size_t steps, const nbcoord_t** a,
-												nbcoord_t* coeff,
+const nbody_butcher_table_rkn* nbody_solver_rk_butcher::rkn_table() const
+{
+	return m_rkn;
+}
+
+size_t nbody_solver_rk_butcher::steps_count() const
+{
+	return m_ode_order == eode_second_order ? m_rkn->get_steps() : m_bt->get_steps();
+}
+
+bool nbody_solver_rk_butcher::is_implicit() const
+{
+	return m_ode_order == eode_second_order ? m_rkn->is_implicit() : m_bt->is_implicit();
+}
+
+bool nbody_solver_rk_butcher::is_embedded() const
+{
+	return m_ode_order == eode_second_order ? m_rkn->is_embedded() : m_bt->is_embedded();
+}
+
+size_t nbody_solver_rk_butcher::error_order() const
+{
+	return m_ode_order == eode_second_order ? m_rkn->get_error_order() : m_bt->get_error_order();
+}
+
+void nbody_solver_rk_butcher::sub_step_implicit(size_t steps,
 												const nbody_engine::memory* y,
 												bool need_first_approach_k,
-												const nbcoord_t* c, nbcoord_t t,
-												nbcoord_t dt)
+												nbcoord_t t, nbcoord_t dt)
 {
+	const bool			second_order = (m_ode_order == eode_second_order);
+	const nbcoord_t*	c = m_c.data();
+
+	if(m_implicit_tolerance > 0)
+	{
+		iterate_implicit(steps, y, need_first_approach_k, t, dt);
+		return;
+	}
+
 	if(need_first_approach_k)
 	{
 		//Compute first approach for <k>
 		engine()->fcompute(t, y, m_tmpk);
 		for(size_t i = 0; i != steps; ++i)
 		{
-			engine()->fmadd(m_t, y, m_tmpk, dt * c[i]);
+			if(second_order)
+			{
+				const nbody_engine::memory_array	tmpk(1, m_tmpk);
+				const nbcoord_t						dv = dt * c[i];
+				engine()->fmaddn_second_order(m_t, y, tmpk, dt * c[i], m_zero.data(), &dv, 1);
+			}
+			else
+			{
+				engine()->fmadd(m_t, y, m_tmpk, dt * c[i]);
+			}
 			engine()->fcompute(t + c[i]*dt, m_t, m_k[i]);
 		}
 	}
@@ -117,22 +339,179 @@ void nbody_solver_rk_butcher::sub_step_implicit(size_t steps, const nbcoord_t**
 	{
 		for(size_t i = 0; i != steps; ++i)
 		{
-			for(size_t n = 0; n != steps; ++n)
+			stage_state(m_stage[i], y, c[i], dt, false);
+			engine()->fcompute(t + c[i]*dt, m_t, m_k[i]);
+		}
+	}
+}
+
+void nbody_solver_rk_butcher::iterate_implicit(size_t steps, const nbody_engine::memory* y,
+												bool need_first_approach_k, nbcoord_t t, nbcoord_t dt)
+{
+	const nbcoord_t*	c = m_c.data();
+
+	if(need_first_approach_k || m_stages_dt == 0 || !predict_stages(steps, t, dt))
+	{
+		engine()->fcompute(t, y, m_tmpk);
+		for(size_t i = 0; i != steps; ++i)
+		{
+			engine()->copy_buffer(m_k[i], m_tmpk);
+		}
+	}
+
+	m_anderson_count = 0;
+	for(size_t iter = 0; iter != m_refine_steps_count; ++iter)
+	{
+		nbcoord_t	delta = 0;
+		for(size_t i = 0; i != steps; ++i)
+		{
+			stage_state(m_stage[i], y, c[i], dt, false);
+			engine()->fcompute(t + c[i]*dt, m_t, m_tmpk);
+			engine()->fmadd(m_kdelta[i], m_tmpk, m_k[i], -1);
+			engine()->copy_buffer(m_k[i], m_tmpk);
+
+			nbcoord_t	stage_delta = 0;
+			engine()->fmaxabs(m_kdelta[i], stage_delta);
+			delta = std::max(delta, stage_delta);
+		}
+		if(delta * dt <= m_implicit_tolerance)
+		{
+			break;
+		}
+		if(m_anderson_depth > 0)
+		{
+			anderson_mixing(steps, iter == 0);
+		}
+	}
+
+	m_stages_t = t;
+	m_stages_dt = dt;
+}
+
+bool nbody_solver_rk_butcher::predict_stages(size_t steps, nbcoord_t t, nbcoord_t dt)
+{
+	const nbcoord_t*	c = m_c.data();
+
+	for(size_t j = 0; j != steps; ++j)
+	{
+		for(size_t m = 0; m != j; ++m)
+		{
+			if(c[j] == c[m])
 			{
-				coeff[n] = dt * a[i][n];
+				return false;
+			}
+		}
+	}
+
+	// Stages of collocation method are values of polynomial of degree 'steps - 1'
+	// at nodes t + c[j]*dt, so it is evaluated at new nodes by Lagrange interpolation
+	std::vector<nbcoord_t>	w(steps);
+	for(size_t i = 0; i != steps; ++i)
+	{
+		const nbcoord_t	theta = (t + c[i] * dt - m_stages_t) / m_stages_dt;
+		for(size_t j = 0; j != steps; ++j)
+		{
+			w[j] = 1;
+			for(size_t m = 0; m != steps; ++m)
+			{
+				if(m != j)
+				{
+					w[j] *= (theta - c[m]) / (c[j] - c[m]);
+				}
 			}
-			engine()->fmaddn(m_t, y, m_k, coeff, m_k.size());
-			engine()->fcompute(t + c[i]*dt, m_t, m_k[i]);
 		}
+		engine()->fmaddn(m_kdelta[i], NULL, m_k, w.data(), steps);
 	}
+	for(size_t i = 0; i != steps; ++i)
+	{
+		engine()->copy_buffer(m_k[i], m_kdelta[i]);
+	}
+	return true;
 }
 
-void nbody_solver_rk_butcher::sub_step_explicit(size_t steps, const nbcoord_t** a,
-												nbcoord_t* coeff,
+void nbody_solver_rk_butcher::anderson_mixing(size_t steps, bool first_sweep)
+{
+	// H. F. Walker, P. Ni "Anderson acceleration for fixed-point iterations", 2011
+	// Sweep result G is at m_k, its residual F = G - K is at m_kdelta
+	if(!first_sweep)
+	{
+		size_t	n = m_anderson_count;
+		if(n == m_anderson_depth)
+		{
+			// Drop the oldest differences
+			for(size_t i = 0; i != steps; ++i)
+			{
+				std::rotate(m_anderson_df[i].begin(), m_anderson_df[i].begin() + 1, m_anderson_df[i].end());
+				std::rotate(m_anderson_dg[i].begin(), m_anderson_dg[i].begin() + 1, m_anderson_dg[i].end());
+			}
+			n = m_anderson_depth - 1;
+		}
+		else
+		{
+			++m_anderson_count;
+		}
+		for(size_t i = 0; i != steps; ++i)
+		{
+			engine()->fmadd(m_anderson_df[i][n], m_kdelta[i], m_anderson_f[i], -1);
+			engine()->fmadd(m_anderson_dg[i][n], m_k[i], m_anderson_g[i], -1);
+		}
+	}
+	for(size_t i = 0; i != steps; ++i)
+	{
+		engine()->copy_buffer(m_anderson_f[i], m_kdelta[i]);
+		engine()->copy_buffer(m_anderson_g[i], m_k[i]);
+	}
+
+	const size_t	count = m_anderson_count;
+	if(count == 0)
+	{
+		return;
+	}
+
+	// Least squares min|F - dF*gamma| by normal equations
+	std::vector<nbcoord_t>	gram(count * count, 0);
+	std::vector<nbcoord_t>	gamma(count, 0);
+	for(size_t a = 0; a != count; ++a)
+	{
+		for(size_t b = a; b != count; ++b)
+		{
+			for(size_t i = 0; i != steps; ++i)
+			{
+				nbcoord_t	dot = 0;
+				engine()->fdot(m_anderson_df[i][a], m_anderson_df[i][b], dot);
+				gram[a * count + b] += dot;
+			}
+			gram[b * count + a] = gram[a * count + b];
+		}
+		for(size_t i = 0; i != steps; ++i)
+		{
+			nbcoord_t	dot = 0;
+			engine()->fdot(m_anderson_df[i][a], m_kdelta[i], dot);
+			gamma[a] += dot;
+		}
+	}
+	if(!solve_linear_system(gram, gamma, count))
+	{
+		return;
+	}
+
+	// K = G - dG*gamma
+	for(nbcoord_t& g : gamma)
+	{
+		g = -g;
+	}
+	for(size_t i = 0; i != steps; ++i)
+	{
+		engine()->fmaddn_inplace(m_k[i], m_anderson_dg[i], gamma.data(), count);
+	}
+}
+
+void nbody_solver_rk_butcher::sub_step_explicit(size_t steps,
 												const nbody_engine::memory* y,
-												const nbcoord_t* c, nbcoord_t t,
-												nbcoord_t dt)
+												nbcoord_t t, nbcoord_t dt)
 {
+	const nbcoord_t*	c = m_c.data();
+
 	for(size_t i = 0; i < steps; ++i)
 	{
 		if(i == 0)
@@ -141,82 +520,369 @@ void nbody_solver_rk_butcher::sub_step_explicit(size_t steps, const nbcoord_t**
 		}
 		else
 		{
-			for(size_t n = 0; n != i; ++n)
+			stage_state(m_stage[i], y, c[i], dt, m_correction);
+			engine()->fcompute(t + c[i]*dt, m_t, m_k[i]);
+		}
+	}
+}
+
+void nbody_solver_rk_butcher::build_combinations()
+{
+	const bool			second_order = (m_ode_order == eode_second_order);
+	const size_t		steps = steps_count();
+	const nbcoord_t**	a = second_order ? m_rkn->get_a() : m_bt->get_a();
+	const nbcoord_t*	b1 = second_order ? m_rkn->get_b1() : m_bt->get_b1();
+	const nbcoord_t*	b2 = second_order ? m_rkn->get_b2() : m_bt->get_b2();
+	const nbcoord_t*	c = second_order ? m_rkn->get_c() : m_bt->get_c();
+	const nbcoord_t*	bv1 = second_order ? m_rkn->get_bv1() : nullptr;
+	const nbcoord_t*	bv2 = second_order ? m_rkn->get_bv2() : nullptr;
+
+	m_stage.resize(steps);
+	for(size_t i = 0; i != steps; ++i)
+	{
+		build_combination(a[i], nullptr, is_implicit() ? steps : i, m_stage[i]);
+	}
+	build_combination(b2, bv2, steps, m_step);
+
+	if(is_embedded())
+	{
+		std::vector<nbcoord_t>	dx(steps);
+		std::vector<nbcoord_t>	dv(steps);
+		for(size_t n = 0; n != steps; ++n)
+		{
+			dx[n] = b2[n] - b1[n];
+			dv[n] = second_order ? bv2[n] - bv1[n] : 0;
+		}
+		build_combination(dx.data(), second_order ? dv.data() : nullptr, steps, m_error);
+	}
+
+	m_c.assign(c, c + steps);
+	m_zero.assign(steps, 0);
+	build_dense_output();
+}
+
+void nbody_solver_rk_butcher::build_combination(const nbcoord_t* x, const nbcoord_t* v, size_t count,
+												combination& comb) const
+{
+	comb.k.clear();
+	comb.x.clear();
+	comb.v.clear();
+	for(size_t n = 0; n != count; ++n)
+	{
+		if(x[n] != 0 || (v != nullptr && v[n] != 0))
+		{
+			comb.k.push_back(m_k[n]);
+			comb.x.push_back(x[n]);
+			comb.v.push_back(v != nullptr ? v[n] : 0);
+		}
+	}
+	comb.dx.resize(comb.k.size());
+	comb.dv.resize(comb.k.size());
+}
+
+void nbody_solver_rk_butcher::build_dense_output()
+{
+	m_dense_weights.clear();
+	if(!has_dense_output())
+	{
+		return;
+	}
+
+	const size_t		steps = m_bt->get_steps();
+	const nbcoord_t**	a = m_bt->get_a();
+	const nbcoord_t*	b = m_bt->get_b2();
+	const nbcoord_t*	c = m_bt->get_c();
+	// Order conditions up to third order: Sum(b*phi[r]) for phi = {1, c, c^2, a*c}
+	const size_t			conds = 4;
+	std::vector<nbcoord_t>	phi(conds * steps);
+
+	for(size_t i = 0; i != steps; ++i)
+	{
+		nbcoord_t	ac = 0;
+		for(size_t j = 0; j != i; ++j)
+		{
+			ac += a[i][j] * c[j];
+		}
+		phi[0 * steps + i] = 1;
+		phi[1 * steps + i] = c[i];
+		phi[2 * steps + i] = c[i] * c[i];
+		phi[3 * steps + i] = ac;
+	}
+
+	std::vector<nbcoord_t>	gram(conds * conds, 0);
+	for(size_t r1 = 0; r1 != conds; ++r1)
+	{
+		for(size_t r2 = 0; r2 != conds; ++r2)
+		{
+			for(size_t i = 0; i != steps; ++i)
 			{
-				coeff[n] = dt * a[i][n];
+				gram[r1 * conds + r2] += phi[r1 * steps + i] * phi[r2 * steps + i];
 			}
-			if(m_correction)
+		}
+	}
+
+	// Sum(b(theta)*phi[r]) must be {theta, theta^2/2, theta^3/3, theta^3/6}.
+	// Minimal norm theta and theta^2 coefficients are found from conditions,
+	// theta^3 coefficients are b - w[0] - w[1], they satisfy the rest since b is at least third order.
+	const nbcoord_t	target[2][conds] = {{1, 0, 0, 0}, {0, 1_f / 2_f, 0, 0}};
+	m_dense_weights.resize(3 * steps);
+	for(size_t q = 0; q != 2; ++q)
+	{
+		std::vector<nbcoord_t>	lambda(target[q], target[q] + conds);
+		if(!solve_linear_system(gram, lambda, conds))
+		{
+			qDebug() << "Can't build continuous extension of Butcher table";
+			m_dense_weights.clear();
+			return;
+		}
+		for(size_t i = 0; i != steps; ++i)
+		{
+			nbcoord_t	w = 0;
+			for(size_t r = 0; r != conds; ++r)
 			{
-				engine()->copy_buffer(m_tcorr_data, m_ycorr_data);
-				engine()->copy_buffer(m_t, y);
-				engine()->fmaddn_corr(m_t, m_tcorr_data, m_k, coeff, i);
+				w += phi[r * steps + i] * lambda[r];
 			}
-			else
+			m_dense_weights[3 * i + q] = w;
+		}
+	}
+	for(size_t i = 0; i != steps; ++i)
+	{
+		m_dense_weights[3 * i + 2] = b[i] - m_dense_weights[3 * i] - m_dense_weights[3 * i + 1];
+	}
+
+	m_dense.k = m_k;
+	m_dense.x.resize(steps);
+	m_dense.v.resize(steps);
+	m_dense.dx.resize(steps);
+	m_dense.dv.resize(steps);
+}
+
+void nbody_solver_rk_butcher::dense_output(const nbody_engine::memory* y, nbcoord_t t, nbcoord_t dt)
+{
+	if(m_dense_weights.empty())
+	{
+		return;
+	}
+
+	const size_t	steps = m_dense.k.size();
+	// Accumulated dump time may be a bit greater than step end, it must not be moved to next step
+	const nbcoord_t	step_end = t + dt * static_cast<nbcoord_t>(1.001);
+	for(nbcoord_t dump_time = next_dense_output_time(); dump_time <= step_end; dump_time = next_dense_output_time())
+	{
+		const nbcoord_t	theta = (dump_time - t) / dt;
+		for(size_t n = 0; n != steps; ++n)
+		{
+			const nbcoord_t*	w = m_dense_weights.data() + 3 * n;
+			m_dense.x[n] = theta * (w[0] + theta * (w[1] + theta * w[2]));
+		}
+		if(m_ode_order == eode_second_order)
+		{
+			// Position weights of induced Runge-Kutta-Nystrom form, see nbody_butcher_table_rkn_induced
+			const nbcoord_t**	a = m_bt->get_a();
+			for(size_t j = 0; j != steps; ++j)
 			{
-				engine()->fmaddn(m_t, y, m_k, coeff, i);
+				nbcoord_t	bx = 0;
+				for(size_t i = j + 1; i < steps; ++i)
+				{
+					bx += m_dense.x[i] * a[i][j];
+				}
+				m_dense.dx[j] = dt * dt * bx;
+				m_dense.dv[j] = dt * m_dense.x[j];
 			}
-			engine()->fcompute(t + c[i]*dt, m_t, m_k[i]);
+			engine()->fmaddn_second_order(m_t, y, m_dense.k, theta * dt, m_dense.dx.data(), m_dense.dv.data(), steps);
+		}
+		else
+		{
+			for(size_t n = 0; n != steps; ++n)
+			{
+				m_dense.dx[n] = dt * m_dense.x[n];
+			}
+			engine()->fmaddn(m_t, y, m_dense.k, m_dense.dx.data(), steps);
 		}
+		write_dense_output(dump_time, m_t);
 	}
 }
 
-void nbody_solver_rk_butcher::sub_step(size_t substeps_count, nbcoord_t t, nbcoord_t dt,
-									   nbody_engine::memory* y, size_t recursion_level)
+void nbody_solver_rk_butcher::stage_state(combination& comb, const nbody_engine::memory* y,
+										  nbcoord_t c, nbcoord_t dt, bool correction)
 {
-	const size_t		steps = m_bt->get_steps();
-	const nbcoord_t**	a = m_bt->get_a();
-	const nbcoord_t*	b1 = m_bt->get_b1();
-	const nbcoord_t*	b2 = m_bt->get_b2();
-	const nbcoord_t*	c = m_bt->get_c();
-	size_t				ps = engine()->problem_size();
-	size_t				coeff_count = steps + 1;
-	bool				need_first_approach_k = false;
+	const size_t	size = comb.k.size();
 
-	std::vector<nbcoord_t>	coeff;
-	coeff.resize(coeff_count);
+	if(m_ode_order == eode_second_order)
+	{
+		for(size_t n = 0; n != size; ++n)
+		{
+			comb.dx[n] = dt * dt * comb.x[n];
+		}
+		// Stage velocities are not used by second order fcompute, keep them equal to v
+		engine()->fmaddn_second_order(m_t, y, comb.k, dt * c, comb.dx.data(), m_zero.data(), size);
+		return;
+	}
 
-	if(m_k.empty())
+	if(size == 0)
 	{
-		need_first_approach_k  = true;
-		m_k = engine()->create_buffers(sizeof(nbcoord_t) * ps, steps);
-		m_t = engine()->create_buffer(sizeof(nbcoord_t) * ps);
-		m_tmpk = engine()->create_buffer(sizeof(nbcoord_t) * ps);
-		m_y_stack = engine()->create_buffers(sizeof(nbcoord_t) * ps, m_max_recursion);
-		if(m_correction)
+		engine()->copy_buffer(m_t, y);
+		return;
+	}
+
+	for(size_t n = 0; n != size; ++n)
+	{
+		comb.dx[n] = dt * comb.x[n];
+	}
+	if(correction)
+	{
+		engine()->copy_buffer(m_tcorr_data, m_ycorr_data);
+		engine()->copy_buffer(m_t, y);
+		engine()->fmaddn_corr(m_t, m_tcorr_data, comb.k, comb.dx.data(), size);
+	}
+	else
+	{
+		engine()->fmaddn(m_t, y, comb.k, comb.dx.data(), size);
+	}
+}
+
+void nbody_solver_rk_butcher::create_stage_buffers()
+{
+	const size_t	steps = steps_count();
+	size_t			ps = engine()->problem_size();
+	// Vector operations process problem_size() values, so iterated stages have full size
+	const bool		iterate = is_implicit() && m_implicit_tolerance > 0;
+	// Second order ODE stages are accelerations only
+	size_t			kps = (m_ode_order == eode_second_order && !iterate) ? ps / 2 : ps;
+
+	m_k = engine()->create_buffers(sizeof(nbcoord_t) * kps, steps);
+	m_t = engine()->create_buffer(sizeof(nbcoord_t) * ps);
+	m_tmpk = engine()->create_buffer(sizeof(nbcoord_t) * kps);
+	if(iterate)
+	{
+		// Second half of second order ODE stages stays zero
+		for(nbody_engine::memory* k : m_k)
+		{
+			engine()->fill_buffer(k, 0);
+		}
+		engine()->fill_buffer(m_tmpk, 0);
+		m_kdelta = engine()->create_buffers(sizeof(nbcoord_t) * kps, steps);
+		if(m_anderson_depth > 0)
 		{
-			m_ycorr_data = engine()->create_buffer(sizeof(nbcoord_t) * ps);
-			m_tcorr_data = engine()->create_buffer(sizeof(nbcoord_t) * ps);
-			engine()->fill_buffer(m_ycorr_data, 0);
-			engine()->fill_buffer(m_tcorr_data, 0);
+			m_anderson_f = engine()->create_buffers(sizeof(nbcoord_t) * kps, steps);
+			m_anderson_g = engine()->create_buffers(sizeof(nbcoord_t) * kps, steps);
+			m_anderson_df.resize(steps);
+			m_anderson_dg.resize(steps);
+			for(size_t i = 0; i != steps; ++i)
+			{
+				m_anderson_df[i] = engine()->create_buffers(sizeof(nbcoord_t) * kps, m_anderson_depth);
+				m_anderson_dg[i] = engine()->create_buffers(sizeof(nbcoord_t) * kps, m_anderson_depth);
+			}
 		}
 	}
+	m_y_stack = engine()->create_buffers(sizeof(nbcoord_t) * ps, m_max_recursion);
+	if(m_correction)
+	{
+		m_ycorr_data = engine()->create_buffer(sizeof(nbcoord_t) * ps);
+		m_tcorr_data = engine()->create_buffer(sizeof(nbcoord_t) * ps);
+		engine()->fill_buffer(m_ycorr_data, 0);
+		engine()->fill_buffer(m_tcorr_data, 0);
+	}
+	build_combinations();
+}
 
-	for(size_t sub_n = 0; sub_n != substeps_count; ++sub_n, t += dt)
+void nbody_solver_rk_butcher::compute_stages(size_t steps, const nbody_engine::memory* y,
+											 bool need_first_approach_k, nbcoord_t t, nbcoord_t dt)
+{
+	if(is_implicit())
+	{
+		sub_step_implicit(steps, y, need_first_approach_k, t, dt);
+	}
+	else
+	{
+		sub_step_explicit(steps, y, t, dt);
+	}
+}
+
+void nbody_solver_rk_butcher::error_estimate(nbcoord_t dt)
+{
+	const size_t	size = m_error.k.size();
+
+	if(m_ode_order == eode_second_order)
+	{
+		for(size_t n = 0; n != size; ++n)
+		{
+			m_error.dx[n] = dt * dt * m_error.x[n];
+			m_error.dv[n] = dt * m_error.v[n];
+		}
+		engine()->fmaddn_second_order(m_t, NULL, m_error.k, 0, m_error.dx.data(), m_error.dv.data(), size);
+	}
+	else if(size == 0)
 	{
-		if(m_bt->is_implicit())
+		engine()->fill_buffer(m_t, 0);
+	}
+	else
+	{
+		for(size_t n = 0; n != size; ++n)
 		{
-			sub_step_implicit(steps, a, coeff.data(), y, need_first_approach_k, c, t, dt);
+			m_error.dx[n] = dt * m_error.x[n];
+		}
+		engine()->fmaddn(m_t, NULL, m_error.k, m_error.dx.data(), size);
+	}
+}
+
+void nbody_solver_rk_butcher::apply_step(nbody_engine::memory* y, nbcoord_t t, nbcoord_t dt)
+{
+	dense_output(y, t, dt);
+	if(m_ode_order == eode_second_order)
+	{
+		for(size_t n = 0; n != m_step.k.size(); ++n)
+		{
+			m_step.dx[n] = dt * dt * m_step.x[n];
+			m_step.dv[n] = dt * m_step.v[n];
+		}
+		engine()->fmaddn_second_order(y, y, m_step.k, dt, m_step.dx.data(), m_step.dv.data(), m_step.k.size());
+	}
+	else
+	{
+		for(size_t n = 0; n != m_step.k.size(); ++n)
+		{
+			m_step.dx[n] = dt * m_step.x[n];
+		}
+		if(m_correction)
+		{
+			engine()->fmaddn_corr(y, m_ycorr_data, m_step.k, m_step.dx.data(), m_step.k.size());
 		}
 		else
 		{
-			sub_step_explicit(steps, a, coeff.data(), y, c, t, dt);
+			engine()->fmaddn_inplace(y, m_step.k, m_step.dx.data(), m_step.k.size());
 		}
+	}
+}
+
+void nbody_solver_rk_butcher::sub_step(size_t substeps_count, nbcoord_t t, nbcoord_t dt,
+									   nbody_engine::memory* y, size_t recursion_level)
+{
+	const size_t		steps = steps_count();
+	bool				need_first_approach_k = false;
+
+	if(m_k.empty())
+	{
+		need_first_approach_k  = true;
+		create_stage_buffers();
+	}
+
+	for(size_t sub_n = 0; sub_n != substeps_count; ++sub_n, t += dt)
+	{
+		compute_stages(steps, y, need_first_approach_k, t, dt);
 
 		nbcoord_t	max_error = 0;
 
-		if(m_bt->is_embedded())
+		if(is_embedded())
 		{
-			for(size_t n = 0; n != steps; ++n)
-			{
-				coeff[n] = (b2[n] - b1[n]);
-			}
-			engine()->fmaddn(m_t, NULL, m_k, coeff.data(), steps);
+			error_estimate(dt);
 			engine()->fmaxabs(m_t, max_error);
 		}
 
 //		qDebug() << max_error;
-		bool can_subdivide = (m_bt->is_embedded() && recursion_level < m_max_recursion) && dt > get_min_step();
-		bool need_subdivide = max_error > m_error_threshold;
+		bool can_subdivide = (is_embedded() && recursion_level < m_max_recursion) && dt > get_min_step();
+		// Subdivision threshold is error per unit step
+		bool need_subdivide = max_error > m_error_threshold * dt;
 
 		if(can_subdivide && need_subdivide)
 		{
@@ -231,18 +897,87 @@ void nbody_solver_rk_butcher::sub_step(size_t substeps_count, nbcoord_t t, nbcoo
 		}
 		else
 		{
-			for(size_t n = 0; n != steps; ++n)
-			{
-				coeff[n] = b2[n] * dt;
-			}
-			if(m_correction)
-			{
-				engine()->fmaddn_corr(y, m_ycorr_data, m_k, coeff.data(), m_k.size());
-			}
-			else
-			{
-				engine()->fmaddn_inplace(y, m_k, coeff.data(), m_k.size());
-			}
+			apply_step(y, t, dt);
 		}
 	}//for( size_t sub_n = 0; sub_n != substeps_count; ++sub_n )
 }
+
+void nbody_solver_rk_butcher::pi_control_step(nbcoord_t t, nbcoord_t dt, nbody_engine::memory* y)
+{
+	const size_t	steps = steps_count();
+	bool			need_first_approach_k = false;
+
+	if(m_k.empty())
+	{
+		need_first_approach_k = true;
+		create_stage_buffers();
+	}
+
+	// Hairer, Wanner "Solving ordinary differential equations II", IV.2
+	const nbcoord_t	k = static_cast<nbcoord_t>(error_order() + 1);
+	const nbcoord_t	alpha = static_cast<nbcoord_t>(0.7) / k;
+	const nbcoord_t	beta = static_cast<nbcoord_t>(0.4) / k;
+	const nbcoord_t	safety = static_cast<nbcoord_t>(0.9);
+	const nbcoord_t	min_factor = static_cast<nbcoord_t>(0.2);
+	const nbcoord_t	max_factor = 5;
+	const nbcoord_t	min_error = static_cast<nbcoord_t>(1e-10);
+	const nbcoord_t	t_end = t + dt;
+	bool			rejected = false;
+
+	if(m_control_step <= 0)
+	{
+		m_control_step = dt;
+	}
+
+	for(bool last = false; !last;)
+	{
+		nbcoord_t	h = m_control_step;
+		// Stretch step a bit to avoid tiny last step
+		if(t + h * static_cast<nbcoord_t>(1.01) >= t_end)
+		{
+			h = t_end - t;
+			last = true;
+		}
+
+		compute_stages(steps, y, need_first_approach_k, t, h);
+		need_first_approach_k = false;
+		error_estimate(h);
+
+		nbcoord_t	error = 0;
+		engine()->fweighted_rms(m_t, y, m_error_threshold, m_error_threshold, error);
+
+		// Step already clamped to min_step is accepted, else last step slightly
+		// longer than min_step would be rejected forever
+		if(error > 1 && h > get_min_step() && m_control_step > get_min_step())
+		{
+			m_control_step = h * std::max(min_factor, safety * pow(error, -1 / k));
+			m_control_step = std::max(m_control_step, get_min_step());
+			rejected = true;
+			last = false;
+			continue;
+		}
+
+		apply_step(y, t, h);
+		t += h;
+
+		error = std::max(error, min_error);
+		nbcoord_t	factor = safety * pow(error, -alpha) * pow(m_prev_error, beta);
+		factor = std::min(max_factor, std::max(min_factor, factor));
+		if(rejected)
+		{
+			factor = std::min(factor, static_cast<nbcoord_t>(1));
+		}
+		m_prev_error = std::max(error, static_cast<nbcoord_t>(1e-4));
+		rejected = false;
+
+		// Last step may be shortened to reach t_end, it does not limit running step
+		if(h < m_control_step && factor >= 1)
+		{
+			m_control_step = std::max(m_control_step, h * factor);
+		}
+		else
+		{
+			m_control_step = std::max(h * factor, get_min_step());
+		}
+	}
+}
@@ -4,49 +4,171 @@
 #include "nbody_solver.h"
 #include "nbody_butcher_table.h"
 
+//! Step size control of embedded Runge-Kutta solvers
+enum e_step_control
+{
+	esc_subdivision,	// Recursive subdivision of step with too big error
+	esc_pi,				// PI (Gustafsson) controller of running step size
+
+	esc_unknown = 0xffffffff
+};
+
+const char NBODY_DLL* step_control_name(e_step_control control);
+e_step_control NBODY_DLL step_control_from_str(const QString& name);
+
 class NBODY_DLL nbody_solver_rk_butcher : public nbody_solver
 {
+	/*!
+		Nonzero terms of Butcher table row Sum(x[n] * k[n]), 'v' are velocity weights
+		of second order ODE. Zero table coefficients are dropped once, so each stage
+		is a single engine call over stage buffers it really depends on.
+	 */
+	struct combination
+	{
+		nbody_engine::memory_array	k;
+		std::vector<nbcoord_t>		x;
+		std::vector<nbcoord_t>		v;
+		//! Weights scaled with step, they are updated at each use
+		std::vector<nbcoord_t>		dx;
+		std::vector<nbcoord_t>		dv;
+	};
 	nbody_butcher_table*		m_bt;
+	nbody_butcher_table_rkn*	m_rkn;
 	nbody_engine::memory_array	m_k;
 	nbody_engine::memory*		m_t;
 	nbody_engine::memory*		m_tmpk;
 	nbody_engine::memory*		m_ycorr_data;
 	nbody_engine::memory*		m_tcorr_data;
 	nbody_engine::memory_array	m_y_stack;
+	std::vector<combination>	m_stage;
+	combination					m_step;
+	combination					m_error;
+	std::vector<nbcoord_t>		m_c;
+	//! Zero stage velocity weights of second order ODE
+	std::vector<nbcoord_t>		m_zero;
+	//! Continuous extension b[n](theta) = theta*(w[n][0] + theta*(w[n][1] + theta*w[n][2]))
+	std::vector<nbcoord_t>		m_dense_weights;
+	combination					m_dense;
 
 	size_t						m_max_recursion;
 	size_t						m_substep_subdivisions;
 	nbcoord_t					m_error_threshold;
 	size_t						m_refine_steps_count;
 	bool						m_correction;
+	e_ode_order					m_ode_order;
+	e_step_control				m_step_control;
+	//! PI controller running step and error of previous accepted step
+	nbcoord_t					m_control_step;
+	nbcoord_t					m_prev_error;
+	nbcoord_t					m_implicit_tolerance;
+	size_t						m_anderson_depth;
+	//! Stage residuals of implicit iteration, they are also scratch of stages prediction
+	nbody_engine::memory_array	m_kdelta;
+	//! Anderson acceleration residuals and stages of previous sweep and history of their differences [stage][n]
+	nbody_engine::memory_array	m_anderson_f;
+	nbody_engine::memory_array	m_anderson_g;
+	std::vector<nbody_engine::memory_array>	m_anderson_df;
+	std::vector<nbody_engine::memory_array>	m_anderson_dg;
+	size_t						m_anderson_count;
+	//! Start time and step of last computed implicit stages, zero step if there are no stages
+	nbcoord_t					m_stages_t;
+	nbcoord_t					m_stages_dt;
 public:
 	explicit nbody_solver_rk_butcher(nbody_butcher_table*);
+	/*!
+		Runge-Kutta-Nystrom solver, it can solve only second order ODE
+	 */
+	explicit nbody_solver_rk_butcher(nbody_butcher_table_rkn*);
 	~nbody_solver_rk_butcher();
 	void set_max_recursion(size_t);
 	void set_substep_subdivisions(size_t);
 	void set_error_threshold(nbcoord_t);
 	void set_refine_steps_count(size_t);
 	void set_correction(bool corr);
+	/*!
+		Implicit stages are iterated until max change of stage (scaled with step) is not greater than 'tolerance',
+		but not more than refine_steps_count sweeps. Stages start from collocation polynomial through
+		previous step stages, first step starts from f(t, y) at all stages.
+		Zero tolerance (default) gives exactly refine_steps_count sweeps from previous step stages.
+	 */
+	void set_implicit_tolerance(nbcoord_t tolerance);
+	//! Anderson acceleration of implicit iteration with tolerance, 'depth' previous sweeps are mixed, 0 - off
+	void set_anderson_depth(size_t depth);
+	/*!
+		With esc_pi embedded solver keeps its own step size between 'advise' calls.
+		Step is accepted if weighted RMS norm of error (absolute and relative tolerance
+		are error_threshold) is not greater than 1, otherwise it is rejected and repeated with smaller step.
+		Each 'advise(dt)' call ends exactly at t + dt, internal step is not greater than dt.
+	 */
+	void set_step_control(e_step_control control);
+	e_step_control get_step_control() const;
+	/*!
+		Solve y" = f(t, y) as second order ODE: stages keep only accelerations,
+		positions are expanded through velocities (y = [x, v], x' = v, v' = f).
+		Runge-Kutta table is converted to Runge-Kutta-Nystrom form (see nbody_butcher_table_rkn_induced),
+		result is the same as first order method applied to [x, v] system.
+		Must be called before set_engine.
+	 */
+	void set_ode_order(e_ode_order order);
 	const char* type_name() const override;
 	void advise(nbcoord_t dt) override;
 	void print_info() const override;
+	e_ode_order get_ode_order() const override;
 	void reset() override;
+	/*!
+		Explicit embedded Runge-Kutta tables have third order continuous extension
+		y(t + theta*dt) = y + dt*Sum(b[n](theta)*k[n]) with b[n](1) equal to step weights,
+		it is built from table and uses stage values of the step only.
+	 */
+	bool has_dense_output() const override;
 
+	//! Runge-Kutta table, nullptr for Runge-Kutta-Nystrom solvers
 	const nbody_butcher_table* table() const;
+	//! Runge-Kutta-Nystrom table used to solve second order ODE
+	const nbody_butcher_table_rkn* rkn_table() const;
 private:
+	size_t steps_count() const;
+	bool is_implicit() const;
+	bool is_embedded() const;
+	size_t error_order() const;
+	void create_stage_buffers();
 	void sub_step(size_t substeps_count, nbcoord_t t, nbcoord_t dt,
 				  nbody_engine::memory* y, size_t recursion_level);
-	void sub_step_implicit(size_t steps, const nbcoord_t** a,
-						   nbcoord_t* coeff,
+	void sub_step_implicit(size_t steps,
 						   const nbody_engine::memory* y,
 						   bool need_first_approach_k,
-						   const nbcoord_t* c, nbcoord_t t,
-						   nbcoord_t dt);
-	void sub_step_explicit(size_t steps, const nbcoord_t** a,
-						   nbcoord_t* coeff,
+						   nbcoord_t t, nbcoord_t dt);
+	//! Implicit stages iteration with set_implicit_tolerance
+	void iterate_implicit(size_t steps, const nbody_engine::memory* y, bool need_first_approach_k,
+						  nbcoord_t t, nbcoord_t dt);
+	//! Extrapolate last computed stages to stages of step [t, t + dt], false if table is not collocation one
+	bool predict_stages(size_t steps, nbcoord_t t, nbcoord_t dt);
+	//! Mix stages with previous sweeps (Anderson acceleration), residuals are in m_kdelta
+	void anderson_mixing(size_t steps, bool first_sweep);
+	void sub_step_explicit(size_t steps,
 						   const nbody_engine::memory* y,
-						   const nbcoord_t* c, nbcoord_t t,
-						   nbcoord_t dt);
+						   nbcoord_t t, nbcoord_t dt);
+	void compute_stages(size_t steps, const nbody_engine::memory* y, bool need_first_approach_k,
+						nbcoord_t t, nbcoord_t dt);
+	//! Embedded local error estimate dt*Sum((b2[n] - b1[n])*k[n]) of step to m_t
+	void error_estimate(nbcoord_t dt);
+	//! Update 'y' with accepted step
+	void apply_step(nbody_engine::memory* y, nbcoord_t t, nbcoord_t dt);
+	//! Advance 'y' from 't' to 't + dt' with PI step control
+	void pi_control_step(nbcoord_t t, nbcoord_t dt, nbody_engine::memory* y);
+	//! Build stage, step and error combinations from Butcher table
+	void build_combinations();
+	void build_combination(const nbcoord_t* x, const nbcoord_t* v, size_t count, combination& comb) const;
+	//! Build continuous extension weights, see has_dense_output
+	void build_dense_output();
+	//! Write stream frames with dump time within accepted step [t, t + dt]
+	void dense_output(const nbody_engine::memory* y, nbcoord_t t, nbcoord_t dt);
+	/*!
+		Stage state m_t = y + dt*Sum(x[n]*k[n]) of first order ODE, or
+		m_t = [x + c*dt*v + dt^2*Sum(x[n]*k[n]), v] of second order ODE
+	 */
+	void stage_state(combination& comb, const nbody_engine::memory* y, nbcoord_t c, nbcoord_t dt,
+					 bool correction);
 };
 
 #endif // NBODY_SOLVER_RK_BUTCHER_H
@@ -16,6 +16,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkck::nbody_butcher_table_rkck()
@@ -71,6 +72,11 @@ bool nbody_butcher_table_rkck::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkck::get_error_order() const
+{
+	return 4;
+}
+
 nbody_solver_rkck::nbody_solver_rkck() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkck)
 {
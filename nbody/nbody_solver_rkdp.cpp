@@ -16,6 +16,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkdp::nbody_butcher_table_rkdp()
@@ -72,6 +73,11 @@ bool nbody_butcher_table_rkdp::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkdp::get_error_order() const
+{
+	return 4;
+}
+
 nbody_solver_rkdp::nbody_solver_rkdp() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkdp)
 {
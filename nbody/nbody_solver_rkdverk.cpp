@@ -16,6 +16,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkdverk::nbody_butcher_table_rkdverk()
@@ -73,6 +74,11 @@ bool nbody_butcher_table_rkdverk::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkdverk::get_error_order() const
+{
+	return 5;
+}
+
 nbody_solver_rkdverk::nbody_solver_rkdverk() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkdverk)
 {
@@ -16,6 +16,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkf::nbody_butcher_table_rkf()
@@ -80,6 +81,11 @@ bool nbody_butcher_table_rkf::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkf::get_error_order() const
+{
+	return 7;
+}
+
 nbody_solver_rkf::nbody_solver_rkf() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkf)
 {
@@ -13,6 +13,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkfeagin10::nbody_butcher_table_rkfeagin10()
@@ -277,6 +278,11 @@ bool nbody_butcher_table_rkfeagin10::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkfeagin10::get_error_order() const
+{
+	return 8;
+}
+
 nbody_solver_rkfeagin10::nbody_solver_rkfeagin10() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkfeagin10)
 {
@@ -13,6 +13,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rkfeagin14::nbody_butcher_table_rkfeagin14()
@@ -780,6 +781,11 @@ bool nbody_butcher_table_rkfeagin14::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rkfeagin14::get_error_order() const
+{
+	return 12;
+}
+
 nbody_solver_rkfeagin14::nbody_solver_rkfeagin14() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rkfeagin14)
 {
@@ -15,6 +15,7 @@ public:
 	const nbcoord_t* get_c() const override;
 	bool is_implicit() const override;
 	bool is_embedded() const override;
+	size_t get_error_order() const override;
 };
 
 nbody_butcher_table_rklc::nbody_butcher_table_rklc()
@@ -67,6 +68,11 @@ bool nbody_butcher_table_rklc::is_embedded() const
 	return true;
 }
 
+size_t nbody_butcher_table_rklc::get_error_order() const
+{
+	return 2;
+}
+
 nbody_solver_rklc::nbody_solver_rklc() :
 	nbody_solver_rk_butcher(new nbody_butcher_table_rklc())
 {
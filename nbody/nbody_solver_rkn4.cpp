@@ -0,0 +1,95 @@
+#include "nbody_solver_rkn4.h"
+#include <QDebug>
+
+/*!
+   \brief Butcher table for classic three stages Runge-Kutta-Nystrom order 4 method
+*/
+class nbody_butcher_table_rkn4 : public nbody_butcher_table_rkn
+{
+public:
+	nbody_butcher_table_rkn4();
+
+	size_t get_steps() const override;
+	const nbcoord_t** get_a() const override;
+	const nbcoord_t* get_b1() const override;
+	const nbcoord_t* get_b2() const override;
+	const nbcoord_t* get_bv1() const override;
+	const nbcoord_t* get_bv2() const override;
+	const nbcoord_t* get_c() const override;
+	bool is_implicit() const override;
+	bool is_embedded() const override;
+};
+
+nbody_butcher_table_rkn4::nbody_butcher_table_rkn4()
+{
+}
+
+size_t nbody_butcher_table_rkn4::get_steps() const
+{
+	return 3;
+}
+
+const nbcoord_t** nbody_butcher_table_rkn4::get_a() const
+{
+	static const nbcoord_t	a1[] = { 0 };
+	static const nbcoord_t	a2[] = { 1_f / 8_f };
+	static const nbcoord_t	a3[] = { 0_f, 1_f / 2_f };
+	static const nbcoord_t*	a[] = { a1, a2, a3 };
+
+	return a;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn4::get_b1() const
+{
+	return get_b2();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn4::get_b2() const
+{
+	static const nbcoord_t	b2[] = { 1_f / 6_f, 1_f / 3_f, 0_f };
+
+	return b2;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn4::get_bv1() const
+{
+	return get_bv2();
+}
+
+const nbcoord_t* nbody_butcher_table_rkn4::get_bv2() const
+{
+	static const nbcoord_t	bv2[] = { 1_f / 6_f, 2_f / 3_f, 1_f / 6_f };
+
+	return bv2;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn4::get_c() const
+{
+	static const nbcoord_t	c[]  = { 0, 1_f / 2_f, 1_f };
+
+	return c;
+}
+
+bool nbody_butcher_table_rkn4::is_implicit() const
+{
+	return false;
+}
+
+bool nbody_butcher_table_rkn4::is_embedded() const
+{
+	return false;
+}
+
+nbody_solver_rkn4::nbody_solver_rkn4() :
+	nbody_solver_rk_butcher(new nbody_butcher_table_rkn4)
+{
+}
+
+nbody_solver_rkn4::~nbody_solver_rkn4()
+{
+}
+
+const char* nbody_solver_rkn4::type_name() const
+{
+	return "nbody_solver_rkn4";
+}
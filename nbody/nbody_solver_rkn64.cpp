@@ -0,0 +1,110 @@
+#include "nbody_solver_rkn64.h"
+#include <QDebug>
+
+/*!
+   \brief Butcher table for Dormand-El-Mikkawy-Prince Runge-Kutta-Nystrom 6(4) method
+
+   RKN6(4)6FM: six stages order 6 method with embedded order 4 method for error estimation
+*/
+class nbody_butcher_table_rkn64 : public nbody_butcher_table_rkn
+{
+public:
+	nbody_butcher_table_rkn64();
+
+	size_t get_steps() const override;
+	const nbcoord_t** get_a() const override;
+	const nbcoord_t* get_b1() const override;
+	const nbcoord_t* get_b2() const override;
+	const nbcoord_t* get_bv1() const override;
+	const nbcoord_t* get_bv2() const override;
+	const nbcoord_t* get_c() const override;
+	bool is_implicit() const override;
+	bool is_embedded() const override;
+	size_t get_error_order() const override;
+};
+
+nbody_butcher_table_rkn64::nbody_butcher_table_rkn64()
+{
+}
+
+size_t nbody_butcher_table_rkn64::get_steps() const
+{
+	return 6;
+}
+
+const nbcoord_t** nbody_butcher_table_rkn64::get_a() const
+{
+	static const nbcoord_t	a1[] = { 0 };
+	static const nbcoord_t	a2[] = { 1_f / 200_f };
+	static const nbcoord_t	a3[] = { -1_f / 2200_f, 1_f / 22_f };
+	static const nbcoord_t	a4[] = { 637_f / 6600_f, -7_f / 110_f, 7_f / 33_f };
+	static const nbcoord_t	a5[] = { 225437_f / 1968750_f, -30073_f / 281250_f, 65569_f / 281250_f, -9367_f / 984375_f };
+	static const nbcoord_t	a6[] = { 151_f / 2142_f, 5_f / 116_f, 385_f / 1368_f, 55_f / 168_f, -6250_f / 28101_f };
+	static const nbcoord_t*	a[] = { a1, a2, a3, a4, a5, a6 };
+
+	return a;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn64::get_b1() const
+{
+	static const nbcoord_t	b1[] = { 1349_f / 157500_f, 7873_f / 50000_f, 192199_f / 900000_f, 521683_f / 2100000_f, -16_f / 125_f, 0_f };
+
+	return b1;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn64::get_b2() const
+{
+	static const nbcoord_t	b2[] = { 151_f / 2142_f, 5_f / 116_f, 385_f / 1368_f, 55_f / 168_f, -6250_f / 28101_f, 0_f };
+
+	return b2;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn64::get_bv1() const
+{
+	static const nbcoord_t	bv1[] = { 1349_f / 157500_f, 7873_f / 45000_f, 27457_f / 90000_f, 521683_f / 630000_f, -2_f / 5_f, 1_f / 12_f };
+
+	return bv1;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn64::get_bv2() const
+{
+	static const nbcoord_t	bv2[] = { 151_f / 2142_f, 25_f / 522_f, 275_f / 684_f, 275_f / 252_f, -78125_f / 112404_f, 1_f / 12_f };
+
+	return bv2;
+}
+
+const nbcoord_t* nbody_butcher_table_rkn64::get_c() const
+{
+	static const nbcoord_t	c[]  = { 0, 1_f / 10_f, 3_f / 10_f, 7_f / 10_f, 17_f / 25_f, 1_f };
+
+	return c;
+}
+
+bool nbody_butcher_table_rkn64::is_implicit() const
+{
+	return false;
+}
+
+bool nbody_butcher_table_rkn64::is_embedded() const
+{
+	return true;
+}
+
+size_t nbody_butcher_table_rkn64::get_error_order() const
+{
+	return 4;
+}
+
+nbody_solver_rkn64::nbody_solver_rkn64() :
+	nbody_solver_rk_butcher(new nbody_butcher_table_rkn64)
+{
+}
+
+nbody_solver_rkn64::~nbody_solver_rkn64()
+{
+}
+
+const char* nbody_solver_rkn64::type_name() const
+{
+	return "nbody_solver_rkn64";
+}
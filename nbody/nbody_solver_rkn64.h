@@ -0,0 +1,14 @@
+#ifndef NBODY_SOLVER_RKN64_H
+#define NBODY_SOLVER_RKN64_H
+
+#include "nbody_solver_rk_butcher.h"
+
+class NBODY_DLL nbody_solver_rkn64 : public nbody_solver_rk_butcher
+{
+public:
+	nbody_solver_rkn64();
+	~nbody_solver_rkn64();
+	const char* type_name() const override;
+};
+
+#endif // NBODY_SOLVER_RKN64_H
@@ -0,0 +1,115 @@
+#include "nbody_solver_symplectic.h"
+#include <QDebug>
+
+nbody_solver_symplectic::nbody_solver_symplectic() :
+	nbody_solver(),
+	m_f(nullptr),
+	m_f_valid(false)
+{
+}
+
+nbody_solver_symplectic::~nbody_solver_symplectic()
+{
+	engine()->free_buffer(m_f);
+}
+
+const char* nbody_solver_symplectic::type_name() const
+{
+	return "nbody_solver_symplectic";
+}
+
+void nbody_solver_symplectic::advise(nbcoord_t dt)
+{
+	nbody_engine::memory*	y = engine()->get_y();
+	nbcoord_t				t = engine()->get_time();
+	const size_t			kicks = m_kick.size();
+
+	if(m_f == nullptr)
+	{
+		m_f = engine()->create_buffer(sizeof(nbcoord_t) * engine()->problem_size() / 2);
+		m_f_valid = false;
+	}
+
+	const nbody_engine::memory_array	f(1, m_f);
+	nbcoord_t							tau = m_drift[0];
+
+	if(m_drift[0] != 0)
+	{
+		engine()->fmaddn_second_order(y, y, nbody_engine::memory_array(), dt * m_drift[0], NULL, NULL, 0);
+		m_f_valid = false;
+	}
+
+	for(size_t i = 0; i != kicks; ++i)
+	{
+		if(!m_f_valid)
+		{
+			engine()->fcompute(t + tau * dt, y, m_f);
+		}
+		// Kick and the following drift at single pass:
+		// v += kick*dt*f, x += drift*dt*v = drift*dt*v_old + drift*kick*dt^2*f
+		const nbcoord_t	drift = dt * m_drift[i + 1];
+		const nbcoord_t	dv = dt * m_kick[i];
+		const nbcoord_t	dx = drift * dv;
+
+		engine()->fmaddn_second_order(y, y, f, drift, &dx, &dv, 1);
+		tau += m_drift[i + 1];
+		// Force is still valid while positions are not changed
+		m_f_valid = (m_drift[i + 1] == 0);
+	}
+
+	engine()->advise_time(dt);
+}
+
+void nbody_solver_symplectic::print_info() const
+{
+	nbody_solver::print_info();
+	qDebug() << "\tforce computations per step" << m_kick.size();
+}
+
+e_ode_order nbody_solver_symplectic::get_ode_order() const
+{
+	return eode_second_order;
+}
+
+void nbody_solver_symplectic::reset()
+{
+	m_f_valid = false;
+}
+
+const std::vector<nbcoord_t>& nbody_solver_symplectic::drift() const
+{
+	return m_drift;
+}
+
+const std::vector<nbcoord_t>& nbody_solver_symplectic::kick() const
+{
+	return m_kick;
+}
+
+void nbody_solver_symplectic::set_splitting(const std::vector<nbcoord_t>& drift,
+											const std::vector<nbcoord_t>& kick)
+{
+	if(drift.size() != kick.size() + 1)
+	{
+		qDebug() << "drift.size() must be kick.size() + 1";
+		return;
+	}
+	m_drift = drift;
+	m_kick = kick;
+	m_f_valid = false;
+}
+
+void nbody_solver_symplectic::set_leapfrog_composition(const std::vector<nbcoord_t>& w)
+{
+	std::vector<nbcoord_t>	drift(1, 0);
+	std::vector<nbcoord_t>	kick(1, 0);
+
+	for(size_t i = 0; i != w.size(); ++i)
+	{
+		kick.back() += w[i] / 2;
+		drift.push_back(w[i]);
+		kick.push_back(w[i] / 2);
+	}
+	drift.push_back(0);
+	set_splitting(drift, kick);
+}
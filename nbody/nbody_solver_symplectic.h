@@ -0,0 +1,40 @@
+#ifndef NBODY_SOLVER_SYMPLECTIC_H
+#define NBODY_SOLVER_SYMPLECTIC_H
+
+#include "nbody_solver.h"
+
+/*!
+   \brief Symplectic splitting method for second order ODE x" = f(x)
+
+   Step is a sequence of drifts x += drift[i]*dt*v and kicks v += kick[i]*dt*f(x):
+   drift[0], kick[0], drift[1], kick[1], ..., kick[n-1], drift[n].
+   When drift[0] and drift[n] are zero, the last force of a step is reused
+   as the first force of the next step.
+*/
+class NBODY_DLL nbody_solver_symplectic : public nbody_solver
+{
+	std::vector<nbcoord_t>	m_drift;
+	std::vector<nbcoord_t>	m_kick;
+	nbody_engine::memory*	m_f;
+	bool					m_f_valid;
+public:
+	nbody_solver_symplectic();
+	~nbody_solver_symplectic();
+	const char* type_name() const override;
+	void advise(nbcoord_t dt) override;
+	void print_info() const override;
+	e_ode_order get_ode_order() const override;
+	void reset() override;
+
+	const std::vector<nbcoord_t>& drift() const;
+	const std::vector<nbcoord_t>& kick() const;
+protected:
+	void set_splitting(const std::vector<nbcoord_t>& drift, const std::vector<nbcoord_t>& kick);
+	/*!
+		Composition of kick-drift-kick leapfrog substeps with weights 'w'
+		(Sum(w) = 1). Kicks of adjacent substeps are merged.
+	 */
+	void set_leapfrog_composition(const std::vector<nbcoord_t>& w);
+};
+
+#endif // NBODY_SOLVER_SYMPLECTIC_H
@@ -0,0 +1,340 @@
+#include "nbody_solver_wisdom_holman.h"
+#include "nbody_engine_simple.h"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace {
+nbvertex_t soa_vertex(const nbcoord_t* a, size_t stride, size_t n)
+{
+	return nbvertex_t(a[n], a[n + stride], a[n + 2 * stride]);
+}
+
+void soa_set_vertex(nbcoord_t* a, size_t stride, size_t n, const nbvertex_t& v)
+{
+	a[n] = v.x;
+	a[n + stride] = v.y;
+	a[n + 2 * stride] = v.z;
+}
+
+//! Stumpff functions c2(z) = (1 - cos(sqrt(z)))/z and c3(z) = (sqrt(z) - sin(sqrt(z)))/z^(3/2)
+void stumpff(nbcoord_t z, nbcoord_t& c2, nbcoord_t& c3)
+{
+	if(fabs(z) < 1)
+	{
+		// c2 = Sum((-z)^j/(2j + 2)!), c3 = Sum((-z)^j/(2j + 3)!), there is no cancellation at small z
+		c2 = 1;
+		c3 = 1;
+		for(size_t j = 10; j != 0; --j)
+		{
+			c2 = 1 - z * c2 / static_cast<nbcoord_t>((2 * j + 1) * (2 * j + 2));
+			c3 = 1 - z * c3 / static_cast<nbcoord_t>((2 * j + 2) * (2 * j + 3));
+		}
+		c2 /= 2;
+		c3 /= 6;
+	}
+	else if(z > 0)
+	{
+		const nbcoord_t	sz = sqrt(z);
+		c2 = (1 - cos(sz)) / z;
+		c3 = (sz - sin(sz)) / (z * sz);
+	}
+	else
+	{
+		const nbcoord_t	sz = sqrt(-z);
+		c2 = (cosh(sz) - 1) / (-z);
+		c3 = (sinh(sz) - sz) / (-z * sz);
+	}
+}
+
+/*!
+	Advance Keplerian orbits around central body with gravity parameter 'mu' for time 'dt'.
+	'q' is [x, y, z, vx, vy, vz] of 'count' bodies relative to central body.
+	Kepler equation r0*G1(s) + eta*G2(s) + mu*G3(s) = dt is solved for universal anomaly 's'
+	with Laguerre-Conway iterations, Gn(s) = s^n*cn(beta*s^2) (Danby, "Fundamentals of celestial mechanics", 6.9)
+*/
+void kepler_drift(nbcoord_t mu, nbcoord_t dt, size_t count, nbcoord_t* q)
+{
+	const nbcoord_t	pi = 3.14159265358979323846264338327950288_f;
+	const nbcoord_t	eps = 4 * std::numeric_limits<nbcoord_t>::epsilon();
+	const size_t	max_iterations = 32;
+
+	for(size_t n = 0; n < count; ++n)
+	{
+		const nbvertex_t	r0(soa_vertex(q, count, n));
+		const nbvertex_t	v0(soa_vertex(q + 3 * count, count, n));
+		const nbcoord_t		r0len = r0.length();
+		if(r0len == 0)
+		{
+			continue;
+		}
+		const nbcoord_t		eta = r0 * v0;
+		// beta = mu/a, it is positive for elliptic orbit
+		const nbcoord_t		beta = 2 * mu / r0len - v0.norm();
+		const nbcoord_t		zeta = mu - beta * r0len;
+
+		nbcoord_t	tau = dt;
+		if(beta > 0)
+		{
+			const nbcoord_t	period = 2 * pi * mu / (beta * sqrt(beta));
+			if(fabs(tau) > period)
+			{
+				tau = fmod(tau, period);
+			}
+		}
+
+		nbcoord_t	s = tau / r0len;
+		nbcoord_t	c2 = 0;
+		nbcoord_t	c3 = 0;
+		for(size_t iter = 0; iter != max_iterations; ++iter)
+		{
+			stumpff(beta * s * s, c2, c3);
+			const nbcoord_t	g0 = 1 - beta * s * s * c2;
+			const nbcoord_t	g1 = s * (1 - beta * s * s * c3);
+			const nbcoord_t	g2 = s * s * c2;
+			const nbcoord_t	g3 = s * s * s * c3;
+			const nbcoord_t	f = r0len * g1 + eta * g2 + mu * g3 - tau;
+			const nbcoord_t	fp = r0len * g0 + eta * g1 + mu * g2;
+			const nbcoord_t	fpp = eta * g0 + zeta * g1;
+			const nbcoord_t	root = sqrt(fabs(16 * fp * fp - 20 * f * fpp));
+			const nbcoord_t	ds = -5 * f / (fp >= 0 ? fp + root : fp - root);
+			s += ds;
+			if(fabs(ds) <= eps * fabs(s))
+			{
+				break;
+			}
+		}
+
+		stumpff(beta * s * s, c2, c3);
+		const nbcoord_t	g0 = 1 - beta * s * s * c2;
+		const nbcoord_t	g1 = s * (1 - beta * s * s * c3);
+		const nbcoord_t	g2 = s * s * c2;
+		const nbcoord_t	g3 = s * s * s * c3;
+		const nbcoord_t	r = r0len * g0 + eta * g1 + mu * g2;
+
+		// Gauss f and g functions
+		const nbcoord_t	f = 1 - mu * g2 / r0len;
+		const nbcoord_t	g = tau - mu * g3;
+		const nbcoord_t	fdot = -mu * g1 / (r * r0len);
+		const nbcoord_t	gdot = 1 - mu * g2 / r;
+
+		soa_set_vertex(q, count, n, r0 * f + v0 * g);
+		soa_set_vertex(q + 3 * count, count, n, r0 * fdot + v0 * gdot);
+	}
+}
+}// namespace
+
+nbody_solver_wisdom_holman::nbody_solver_wisdom_holman() :
+	nbody_solver(),
+	m_f(nullptr),
+	m_f_valid(false),
+	m_central(0)
+{
+}
+
+nbody_solver_wisdom_holman::~nbody_solver_wisdom_holman()
+{
+	engine()->free_buffer(m_f);
+}
+
+const char* nbody_solver_wisdom_holman::type_name() const
+{
+	return "nbody_solver_wisdom_holman";
+}
+
+bool nbody_solver_wisdom_holman::load_state()
+{
+	const nbody_engine::memory*	mass = engine()->get_mass();
+	if(mass == NULL)
+	{
+		qDebug() << "Engine" << engine()->type_name() << "does not provide masses";
+		return false;
+	}
+
+	const size_t	count = engine()->problem_size() / 6;
+	m_mass.resize(count);
+	m_y.resize(6 * count);
+	m_acc.resize(3 * count);
+	engine()->read_buffer(m_mass.data(), mass);
+	engine()->read_buffer(m_y.data(), engine()->get_y());
+
+	// Bodies may be reordered by engine between steps
+	m_central = static_cast<size_t>(std::max_element(m_mass.begin(), m_mass.end()) - m_mass.begin());
+	m_index.clear();
+	for(size_t n = 0; n != count; ++n)
+	{
+		if(n != m_central)
+		{
+			m_index.push_back(n);
+		}
+	}
+
+	const nbcoord_t*	x = m_y.data();
+	const nbcoord_t*	v = m_y.data() + 3 * count;
+	nbcoord_t			total_mass = 0;
+	m_mass_center = nbvertex_t();
+	m_mass_center_velosity = nbvertex_t();
+	for(size_t n = 0; n != count; ++n)
+	{
+		total_mass += m_mass[n];
+		m_mass_center += soa_vertex(x, count, n) * m_mass[n];
+		m_mass_center_velosity += soa_vertex(v, count, n) * m_mass[n];
+	}
+	m_mass_center /= total_mass;
+	m_mass_center_velosity /= total_mass;
+
+	const size_t		planets = m_index.size();
+	const nbvertex_t	central(soa_vertex(x, count, m_central));
+	m_q.resize(6 * planets);
+	for(size_t p = 0; p != planets; ++p)
+	{
+		const size_t	n = m_index[p];
+		soa_set_vertex(m_q.data(), planets, p, soa_vertex(x, count, n) - central);
+		soa_set_vertex(m_q.data() + 3 * planets, planets, p, soa_vertex(v, count, n) - m_mass_center_velosity);
+	}
+	return true;
+}
+
+void nbody_solver_wisdom_holman::store_state()
+{
+	const size_t	count = m_mass.size();
+	const size_t	planets = m_index.size();
+	nbcoord_t*		x = m_y.data();
+	nbcoord_t*		v = m_y.data() + 3 * count;
+	nbcoord_t		total_mass = m_mass[m_central];
+	nbvertex_t		mq;
+	nbvertex_t		mv;
+
+	for(size_t p = 0; p != planets; ++p)
+	{
+		const nbcoord_t	m = m_mass[m_index[p]];
+		total_mass += m;
+		mq += soa_vertex(m_q.data(), planets, p) * m;
+		mv += soa_vertex(m_q.data() + 3 * planets, planets, p) * m;
+	}
+
+	// Central body position follows from mass center, its barycentric momentum is opposite to total momentum of others
+	const nbvertex_t	central(m_mass_center - mq / total_mass);
+	soa_set_vertex(x, count, m_central, central);
+	soa_set_vertex(v, count, m_central, m_mass_center_velosity - mv / m_mass[m_central]);
+	for(size_t p = 0; p != planets; ++p)
+	{
+		const size_t	n = m_index[p];
+		soa_set_vertex(x, count, n, soa_vertex(m_q.data(), planets, p) + central);
+		soa_set_vertex(v, count, n, soa_vertex(m_q.data() + 3 * planets, planets, p) + m_mass_center_velosity);
+	}
+
+	engine()->write_buffer(engine()->get_y(), m_y.data());
+}
+
+void nbody_solver_wisdom_holman::kick(nbcoord_t t, nbcoord_t dt)
+{
+	if(!m_f_valid)
+	{
+		engine()->fcompute(t, engine()->get_y(), m_f);
+		m_f_valid = true;
+	}
+	engine()->read_buffer(m_acc.data(), m_f);
+
+	// Interaction acceleration is engine's acceleration without central body attraction
+	const size_t	count = m_mass.size();
+	const size_t	planets = m_index.size();
+	const nbcoord_t	mu = m_mass[m_central];
+	nbcoord_t*		q = m_q.data();
+	nbcoord_t*		v = m_q.data() + 3 * planets;
+	for(size_t p = 0; p != planets; ++p)
+	{
+		const nbvertex_t	r(soa_vertex(q, planets, p));
+		const nbcoord_t		r2 = std::max(r.norm(), nbody::MinDistance);
+		const nbvertex_t	a(soa_vertex(m_acc.data(), count, m_index[p]) + r * (mu / (r2 * sqrt(r2))));
+		soa_set_vertex(v, planets, p, soa_vertex(v, planets, p) + a * dt);
+	}
+}
+
+void nbody_solver_wisdom_holman::jump(nbcoord_t dt)
+{
+	const size_t		planets = m_index.size();
+	nbcoord_t*			q = m_q.data();
+	const nbcoord_t*	v = m_q.data() + 3 * planets;
+	nbvertex_t			mv;
+
+	for(size_t p = 0; p != planets; ++p)
+	{
+		mv += soa_vertex(v, planets, p) * m_mass[m_index[p]];
+	}
+	const nbvertex_t	dq(mv * (dt / m_mass[m_central]));
+	for(size_t p = 0; p != planets; ++p)
+	{
+		soa_set_vertex(q, planets, p, soa_vertex(q, planets, p) + dq);
+	}
+}
+
+void nbody_solver_wisdom_holman::advise(nbcoord_t dt)
+{
+	const nbcoord_t	t = engine()->get_time();
+
+	if(m_f == nullptr)
+	{
+		m_f = engine()->create_buffer(sizeof(nbcoord_t) * engine()->problem_size() / 2);
+		m_f_valid = false;
+	}
+
+	// Time is not advanced, bodies did not move
+	if(!load_state())
+	{
+		return;
+	}
+
+	kick(t, dt / 2);
+	jump(dt / 2);
+	kepler_drift(m_mass[m_central], dt, m_index.size(), m_q.data());
+	jump(dt / 2);
+	m_mass_center += m_mass_center_velosity * dt;
+
+	store_state();
+	// Force at the end of step is reused by the next step
+	m_f_valid = false;
+	kick(t + dt, dt / 2);
+	store_state();
+
+	engine()->advise_time(dt);
+}
+
+void nbody_solver_wisdom_holman::print_info() const
+{
+	nbody_solver::print_info();
+	qDebug() << "\tforce computations per step" << 1;
+}
+
+e_ode_order nbody_solver_wisdom_holman::get_ode_order() const
+{
+	return eode_second_order;
+}
+
+void nbody_solver_wisdom_holman::reset()
+{
+	m_f_valid = false;
+}
+
+bool nbody_solver_wisdom_holman::is_engine_supported(nbody_engine* e) const
+{
+	// Kick reads accelerations only output of second order ODE
+	if(!nbody_solver::is_engine_supported(e))
+	{
+		return false;
+	}
+	if(e->get_mass() == NULL)
+	{
+		qDebug() << "Engine" << e->type_name() << "does not provide masses";
+		return false;
+	}
+	// Only engines derived from nbody_engine_simple support softened force laws
+	const nbody_engine_simple*	simple = dynamic_cast<const nbody_engine_simple*>(e);
+	if(simple != NULL && simple->get_force_law() != efl_newton)
+	{
+		qDebug() << "Force law" << force_law_name(simple->get_force_law())
+				 << "is not supported, Kepler drift needs Newton gravity";
+		return false;
+	}
+	return true;
+}
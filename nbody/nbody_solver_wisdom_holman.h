@@ -0,0 +1,56 @@
+#ifndef NBODY_SOLVER_WISDOM_HOLMAN_H
+#define NBODY_SOLVER_WISDOM_HOLMAN_H
+
+#include "nbody_solver.h"
+
+/*!
+   \brief Wisdom-Holman symplectic map in democratic heliocentric coordinates (Duncan, Levison, Lee 1998)
+
+   For hierarchical systems with dominant central body (the heaviest one), e.g. planetary systems.
+   Hamiltonian is split to Keplerian motion of each body around central body,
+   interaction of non-central bodies and linear drift of central body ('jump'):
+   kick(dt/2), jump(dt/2), Kepler drift(dt), jump(dt/2), kick(dt/2).
+   Kepler drift is exact (universal variables), so step is limited by interactions only.
+   Interaction accelerations are engine's accelerations (nbody_engine::fcompute) without
+   central body attraction, so force law must be Newton gravity. The last force of a step
+   is reused by the next step, step costs one force computation.
+   Coordinates transform and Kepler drift are computed on host, engine must provide masses
+   (see nbody_engine::get_mass).
+*/
+class NBODY_DLL nbody_solver_wisdom_holman : public nbody_solver
+{
+	nbody_engine::memory*	m_f;
+	bool					m_f_valid;
+	//! Host copies of engine's masses, state y and accelerations
+	std::vector<nbcoord_t>	m_mass;
+	std::vector<nbcoord_t>	m_y;
+	std::vector<nbcoord_t>	m_acc;
+	//! Central body index and indices of other bodies
+	size_t					m_central;
+	std::vector<size_t>		m_index;
+	//! Heliocentric positions and barycentric velocities [qx, qy, qz, vx, vy, vz] of non-central bodies
+	std::vector<nbcoord_t>	m_q;
+	nbvertex_t				m_mass_center;
+	nbvertex_t				m_mass_center_velosity;
+public:
+	nbody_solver_wisdom_holman();
+	~nbody_solver_wisdom_holman();
+	const char* type_name() const override;
+	void advise(nbcoord_t dt) override;
+	void print_info() const override;
+	e_ode_order get_ode_order() const override;
+	void reset() override;
+	//! Engine must support second order ODE, provide masses and compute Newton gravity
+	bool is_engine_supported(nbody_engine* e) const override;
+private:
+	//! Read masses and state from engine and convert it to democratic heliocentric coordinates
+	bool load_state();
+	//! Convert democratic heliocentric coordinates to engine's state and write it to engine
+	void store_state();
+	//! Interaction kick of non-central bodies with accelerations computed at engine's state
+	void kick(nbcoord_t t, nbcoord_t dt);
+	//! Linear drift of heliocentric positions with total momentum of non-central bodies
+	void jump(nbcoord_t dt);
+};
+
+#endif // NBODY_SOLVER_WISDOM_HOLMAN_H
@@ -0,0 +1,64 @@
+#include "nbody_solver_yoshida.h"
+#include <QDebug>
+#include <cmath>
+
+//! Symmetric composition weights w[m], ..., w[1], w[0], w[1], ..., w[m] with w[0] = 1 - 2*Sum(w[1..m])
+static std::vector<nbcoord_t> symmetric_composition(const std::vector<nbcoord_t>& w)
+{
+	nbcoord_t				w0 = 1;
+	std::vector<nbcoord_t>	result(w.rbegin(), w.rend());
+
+	for(size_t i = 0; i != w.size(); ++i)
+	{
+		w0 -= 2 * w[i];
+	}
+	result.push_back(w0);
+	result.insert(result.end(), w.begin(), w.end());
+	return result;
+}
+
+nbody_solver_yoshida::nbody_solver_yoshida(size_t order) :
+	nbody_solver_symplectic(),
+	m_order(order)
+{
+	if(m_order == 6)
+	{
+		set_leapfrog_composition(symmetric_composition(
+		{
+			-1.17767998417887_f, 0.235573213359357_f, 0.784513610477560_f
+		}));
+	}
+	else if(m_order == 8)
+	{
+		set_leapfrog_composition(symmetric_composition(
+		{
+			0.102799849391985_f, -1.96061023297549_f, 1.93813913762276_f, -0.158240635368243_f,
+			-1.44485223686048_f, 0.253693336566229_f, 0.914844246229740_f
+		}));
+	}
+	else
+	{
+		if(m_order != 4)
+		{
+			qDebug() << "Unsupported Yoshida method order" << m_order << "Order 4 will be used";
+			m_order = 4;
+		}
+		set_leapfrog_composition(symmetric_composition({1_f / (2_f - cbrt(2_f))}));
+	}
+}
+
+const char* nbody_solver_yoshida::type_name() const
+{
+	return "nbody_solver_yoshida";
+}
+
+void nbody_solver_yoshida::print_info() const
+{
+	nbody_solver_symplectic::print_info();
+	qDebug() << "\torder" << m_order;
+}
+
+size_t nbody_solver_yoshida::get_order() const
+{
+	return m_order;
+}
@@ -0,0 +1,23 @@
+#ifndef NBODY_SOLVER_YOSHIDA_H
+#define NBODY_SOLVER_YOSHIDA_H
+
+#include "nbody_solver_symplectic.h"
+
+/*!
+   \brief Yoshida composition of leapfrog substeps
+
+   Order 4 is the triple jump, orders 6 and 8 use solutions A and D
+   from H. Yoshida, Construction of higher order symplectic integrators (1990).
+*/
+class NBODY_DLL nbody_solver_yoshida : public nbody_solver_symplectic
+{
+	size_t	m_order;
+public:
+	//! @param order - 4, 6 or 8
+	explicit nbody_solver_yoshida(size_t order);
+	const char* type_name() const override;
+	void print_info() const override;
+	size_t get_order() const;
+};
+
+#endif // NBODY_SOLVER_YOSHIDA_H
@@ -3,13 +3,73 @@
 template<class Solver>
 static nbody_solver* create_butcher_solver(const QVariantMap& param)
 {
+	const int	ode_order = param.value("ode_order", 1).toInt();
+	const bool	correction = param.value("correction", false).toBool();
+
+	if(ode_order != eode_first_order && ode_order != eode_second_order)
+	{
+		qDebug() << "Invalid ode_order" << ode_order << "Must be 1 or 2";
+		return NULL;
+	}
+	if(ode_order == eode_second_order && correction)
+	{
+		qDebug() << "correction is not supported for second order ODE";
+		return NULL;
+	}
+
+	const e_step_control	step_control = step_control_from_str(param.value("step_control", "subdivision").toString());
+	if(step_control == esc_unknown)
+	{
+		qDebug() << "Invalid step_control" << param.value("step_control") << "Must be subdivision or pi";
+		return NULL;
+	}
+
 	nbody_solver_rk_butcher*	solver = new Solver();
 
 	solver->set_error_threshold(param.value("error_threshold", 1e-4).toDouble());
 	solver->set_max_recursion(param.value("max_recursion", 8).toUInt());
-	solver->set_refine_steps_count(param.value("refine_steps_count", 1).toUInt());
+	solver->set_step_control(step_control);
+	const nbcoord_t	implicit_tolerance = param.value("implicit_tolerance", 0).toDouble();
+	// With tolerance sweeps count only limits iteration which does not converge
+	solver->set_refine_steps_count(param.value("refine_steps_count", implicit_tolerance > 0 ? 32 : 1).toUInt());
+	solver->set_implicit_tolerance(implicit_tolerance);
+	solver->set_anderson_depth(param.value("anderson_depth", 0).toUInt());
 	solver->set_substep_subdivisions(param.value("substep_subdivisions", 8).toUInt());
-	solver->set_correction(param.value("correction", false).toBool());
+	solver->set_correction(correction);
+	solver->set_ode_order(static_cast<e_ode_order>(ode_order));
+
+	return solver;
+}
+
+template<class Solver>
+static nbody_solver* create_rkn_solver(const QVariantMap& param)
+{
+	const int	ode_order = param.value("ode_order", 2).toInt();
+
+	if(ode_order != eode_second_order)
+	{
+		qDebug() << "Invalid ode_order" << ode_order << "Runge-Kutta-Nystrom solver supports only 2";
+		return NULL;
+	}
+	if(param.value("correction", false).toBool())
+	{
+		qDebug() << "correction is not supported for second order ODE";
+		return NULL;
+	}
+
+	const e_step_control	step_control = step_control_from_str(param.value("step_control", "subdivision").toString());
+	if(step_control == esc_unknown)
+	{
+		qDebug() << "Invalid step_control" << param.value("step_control") << "Must be subdivision or pi";
+		return NULL;
+	}
+
+	nbody_solver_rk_butcher*	solver = new Solver();
+
+	solver->set_error_threshold(param.value("error_threshold", 1e-4).toDouble());
+	solver->set_max_recursion(param.value("max_recursion", 8).toUInt());
+	solver->set_substep_subdivisions(param.value("substep_subdivisions", 8).toUInt());
+	solver->set_step_control(step_control);
 
 	return solver;
 }
@@ -18,7 +78,17 @@ nbody_solver* nbody_create_solver(const QVariantMap& param)
 {
 	const QString	type(param.value("solver").toString());
 	nbody_solver*	solver = NULL;
-	if(type == "adams")
+	if(type == "abm")
+	{
+		const size_t	max_order = param.value("max_order", 12).toUInt();
+		if(max_order < 1 || max_order > 12)
+		{
+			qDebug() << "Invalid max_order" << param.value("max_order") << "Must be 1...12";
+			return NULL;
+		}
+		solver = new nbody_solver_abm(max_order, param.value("error_threshold", 1e-10).toDouble());
+	}
+	else if(type == "adams")
 	{
 		QVariantMap	starter_param(param);
 		starter_param["solver"] = param.value("starter_solver", "euler");
@@ -30,16 +100,40 @@ nbody_solver* nbody_create_solver(const QVariantMap& param)
 		solver = new nbody_solver_adams(starter, param.value("rank", 1).toInt(),
 										param.value("correction", false).toBool());
 	}
+	else if(type == "block-step")
+	{
+		solver = new nbody_solver_block_step(param.value("eta", 0.005).toDouble());
+	}
 	else if(type == "bs")
 	{
-		solver = new nbody_solver_bulirsch_stoer(
+		const e_bs_control	control = bs_control_from_str(param.value("order_control", "fixed").toString());
+		if(control == ebsc_unknown)
+		{
+			qDebug() << "Invalid order_control" << param.value("order_control") << "Must be fixed or deuflhard";
+			return NULL;
+		}
+		nbody_solver_bulirsch_stoer*	bs = new nbody_solver_bulirsch_stoer(
 			param.value("max_level", 8).toUInt(),
 			param.value("error_threshold", 1e-11).toDouble());
+		bs->set_control(control);
+		solver = bs;
 	}
 	else if(type == "euler")
 	{
 		solver = new nbody_solver_euler();
 	}
+	else if(type == "forest-ruth")
+	{
+		solver = new nbody_solver_forest_ruth();
+	}
+	else if(type == "hermite")
+	{
+		solver = new nbody_solver_hermite();
+	}
+	else if(type == "leapfrog")
+	{
+		solver = new nbody_solver_leapfrog();
+	}
 	else if(type == "midpoint")
 	{
 		solver = new nbody_solver_midpoint();
@@ -88,17 +182,46 @@ nbody_solver* nbody_create_solver(const QVariantMap& param)
 	{
 		solver = create_butcher_solver<nbody_solver_rklc>(param);
 	}
+	else if(type == "rkn4")
+	{
+		solver = create_rkn_solver<nbody_solver_rkn4>(param);
+	}
+	else if(type == "rkn64")
+	{
+		solver = create_rkn_solver<nbody_solver_rkn64>(param);
+	}
 	else if(type == "trapeze")
 	{
 		nbody_solver_trapeze* trapeze =  new nbody_solver_trapeze();
 		trapeze->set_refine_steps_count(param.value("refine_steps_count", 1).toUInt());
 		solver = trapeze;
 	}
+	else if(type == "wisdom-holman")
+	{
+		solver = new nbody_solver_wisdom_holman();
+	}
+	else if(type == "yoshida4")
+	{
+		solver = new nbody_solver_yoshida(4);
+	}
+	else if(type == "yoshida6")
+	{
+		solver = new nbody_solver_yoshida(6);
+	}
+	else if(type == "yoshida8")
+	{
+		solver = new nbody_solver_yoshida(8);
+	}
 	else
 	{
 		return NULL;
 	}
 
+	if(solver == NULL)
+	{
+		return NULL;
+	}
+
 	nbcoord_t min_step = param.value("min_step", 1e-9).toDouble();
 	nbcoord_t max_step = param.value("max_step", 1e-2).toDouble();
 
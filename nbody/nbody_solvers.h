@@ -1,9 +1,14 @@
 #ifndef NBODY_SOLVERS_H
 #define NBODY_SOLVERS_H
 
+#include "nbody_solver_abm.h"
 #include "nbody_solver_adams.h"
+#include "nbody_solver_block_step.h"
 #include "nbody_solver_bulirsch_stoer.h"
 #include "nbody_solver_euler.h"
+#include "nbody_solver_forest_ruth.h"
+#include "nbody_solver_hermite.h"
+#include "nbody_solver_leapfrog.h"
 #include "nbody_solver_midpoint.h"
 #include "nbody_solver_midpoint_stetter.h"
 #include "nbody_solver_rk4.h"
@@ -16,8 +21,11 @@
 #include "nbody_solver_rkfeagin14.h"
 #include "nbody_solver_rkgl.h"
 #include "nbody_solver_rklc.h"
-#include "nbody_solver_stormer.h"
+#include "nbody_solver_rkn4.h"
+#include "nbody_solver_rkn64.h"
 #include "nbody_solver_trapeze.h"
+#include "nbody_solver_wisdom_holman.h"
+#include "nbody_solver_yoshida.h"
 
 /*!
    \brief Create solver from parameters
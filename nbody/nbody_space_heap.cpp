@@ -1,7 +1,8 @@
 #include "nbody_space_heap.h"
 
-nbody_space_heap::nbody_space_heap() :
-	m_distance_to_node_radius_ratio(0)
+nbody_space_heap::nbody_space_heap(size_t multipole_order) :
+	m_distance_to_node_radius_ratio(0),
+	m_multipole_order(multipole_order)
 {
 }
 
@@ -19,6 +20,15 @@ void nbody_space_heap::build(size_t count, const nbcoord_t* rx, const nbcoord_t*
 	m_mass_center.resize(heap_size);
 	m_mass.resize(heap_size);
 	m_radius_sqr.resize(heap_size);
+	if(m_multipole_order == 2)
+	{
+		// Leaves quadrupoles are always zero
+		m_quadrupole.assign(heap_size, space_quadrupole());
+	}
+	else
+	{
+		m_quadrupole.clear();
+	}
 	m_box_min.resize(heap_size);
 	m_box_max.resize(heap_size);
 	m_body_n.resize(heap_size);
@@ -29,18 +39,92 @@ void nbody_space_heap::build(size_t count, const nbcoord_t* rx, const nbcoord_t*
 	#pragma omp parallel
 	#pragma omp single
 	build(count, bodies_indites.data(), rx, ry, rz, mass, NBODY_HEAP_ROOT_INDEX, DIM_NUM_X);
+}
+
+bool nbody_space_heap::is_built() const
+{
+	return !m_body_n.empty();
+}
+
+void nbody_space_heap::refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+							 const nbcoord_t* mass)
+{
+	// Leaves are [count, 2*count), internal nodes are [1, count)
+	size_t	count = m_body_n.size() / 2;
 
-	nbcoord_t	distance_to_node_radius_ratio_sqr(distance_to_node_radius_ratio * distance_to_node_radius_ratio);
 	#pragma omp parallel for
-	for(size_t n = 0; n < m_radius_sqr.size(); ++n)
+	for(size_t idx = count; idx < 2 * count; ++idx)
+	{
+		size_t	body_n(m_body_n[idx]);
+		m_mass_center[idx] = nbvertex_t(rx[body_n], ry[body_n], rz[body_n]);
+		m_mass[idx] = mass[body_n];
+		m_box_min[idx] = m_mass_center[idx];
+		m_box_max[idx] = m_mass_center[idx];
+	}
+
+	// Children have greater indices than parent, so go level by level from the bottom
+	size_t	level_begin = NBODY_HEAP_ROOT_INDEX;
+	while(2 * level_begin < count)
+	{
+		level_begin *= 2;
+	}
+	for(; level_begin >= NBODY_HEAP_ROOT_INDEX; level_begin /= 2)
+	{
+		size_t	level_end = std::min(2 * level_begin, count);
+		#pragma omp parallel for if(level_end - level_begin > NBODY_DATA_BLOCK_SIZE)
+		for(size_t idx = level_begin; idx < level_end; ++idx)
+		{
+			update(idx);
+		}
+	}
+}
+
+nbcoord_t nbody_space_heap::overlap() const
+{
+	size_t		count = m_body_n.size() / 2;
+	nbcoord_t	total = 0;
+
+	for(size_t idx = NBODY_HEAP_ROOT_INDEX; idx < count; ++idx)
+	{
+		size_t	left(left_idx(idx));
+		size_t	rght(rght_idx(idx));
+		total += space_box_overlap(m_box_min[idx], m_box_max[idx], m_box_min[left], m_box_max[left],
+								   m_box_min[rght], m_box_max[rght]);
+	}
+
+	return count <= NBODY_HEAP_ROOT_INDEX ? 0 : total / static_cast<nbcoord_t>(count - NBODY_HEAP_ROOT_INDEX);
+}
+
+void nbody_space_heap::buckets(size_t idx, size_t bucket_size, std::vector<size_t>& buckets) const
+{
+	if(leaf_count(idx) <= bucket_size)
+	{
+		buckets.push_back(idx);
+		return;
+	}
+	this->buckets(left_idx(idx), bucket_size, buckets);
+	this->buckets(rght_idx(idx), bucket_size, buckets);
+}
+
+void nbody_space_heap::bodies(size_t idx, std::vector<size_t>& bodies) const
+{
+	if(idx >= m_body_n.size() / 2) // It is a leaf
 	{
-		m_radius_sqr[n] *= distance_to_node_radius_ratio_sqr;
+		bodies.push_back(m_body_n[idx]);
+		return;
 	}
+	this->bodies(left_idx(idx), bodies);
+	this->bodies(rght_idx(idx), bodies);
 }
 
-nbvertex_t nbody_space_heap::traverse(const nbody_data* data, const nbvertex_t& v1, const nbcoord_t mass1) const
+void nbody_space_heap::interaction_list(size_t bucket, space_interaction_list& list) const
 {
-	nbvertex_t			total_force;
+	const size_t		leaf_begin = m_body_n.size() / 2;
+	const bool			quadrupole = !m_quadrupole.empty();
+	const nbvertex_t&	bmin(m_box_min[bucket]);
+	const nbvertex_t&	bmax(m_box_max[bucket]);
+
+	list.clear();
 
 	size_t	stack_data[MAX_STACK_SIZE] = {};
 	size_t*	stack = stack_data;
@@ -49,28 +133,29 @@ nbvertex_t nbody_space_heap::traverse(const nbody_data* data, const nbvertex_t&
 	*stack++ = NBODY_HEAP_ROOT_INDEX;
 	while(stack != stack_head)
 	{
-		size_t				curr = *--stack;
-		const nbcoord_t		distance_sqr((v1 - m_mass_center[curr]).norm());
+		size_t	curr = *--stack;
 
-		if(distance_sqr > m_radius_sqr[curr])
+		if(curr >= leaf_begin)
 		{
-			total_force += data->force(v1, m_mass_center[curr], mass1, m_mass[curr]);
+			// Leaf is a single body, it is computed directly
+			list.add(m_mass_center[curr], m_mass[curr]);
 		}
-		else
+		else if(space_box_distance_sqr(m_mass_center[curr], bmin, bmax) > m_radius_sqr[curr])
 		{
-			size_t	left(left_idx(curr));
-			size_t	rght(rght_idx(curr));
-			if(rght < m_body_n.size())
-			{
-				*stack++ = rght;
-			}
-			if(left < m_body_n.size())
+			// Node is far enough from every body of the bucket
+			list.add(m_mass_center[curr], m_mass[curr]);
+			if(quadrupole)
 			{
-				*stack++ = left;
+				list.quadrupole_center.push_back(m_mass_center[curr]);
+				list.quadrupole.push_back(m_quadrupole[curr]);
 			}
 		}
+		else
+		{
+			*stack++ = rght_idx(curr);
+			*stack++ = left_idx(curr);
+		}
 	}
-	return total_force;
 }
 
 const std::vector<nbvertex_t>& nbody_space_heap::get_mass_center() const
@@ -103,10 +188,12 @@ void nbody_space_heap::build(size_t count, size_t* indites, const nbcoord_t* rx,
 		m_body_n[idx] = *indites;
 		m_box_min[idx] = m_mass_center[idx];
 		m_box_max[idx] = m_mass_center[idx];
+		m_radius_sqr[idx] = 0;
 		return;
 	}
 
-	size_t	left_size = count / 2;
+	// Leaves are [N, 2N), so left subtree size is defined by heap shape (count / 2 for power of 2 N)
+	size_t	left_size = leaf_count(left_idx(idx));
 	size_t	right_size = count - left_size;
 	size_t*	median = indites + left_size;
 	auto comparator_x = [rx](size_t a, size_t b) { return rx[a] < rx[b];};
@@ -147,9 +234,23 @@ void nbody_space_heap::build(size_t count, size_t* indites, const nbcoord_t* rx,
 		build(right_size, median, rx, ry, rz, mass, rght, next_dimension);
 	}
 
+	update(idx);
+}
+
+void nbody_space_heap::update(size_t idx)
+{
+	size_t	left(left_idx(idx));
+	size_t	rght(rght_idx(idx));
+
 	m_mass[idx] = m_mass[left] + m_mass[rght];
 	m_mass_center[idx] = (m_mass_center[left] * m_mass[left] +
 						  m_mass_center[rght] * m_mass[rght]) / m_mass[idx];
+	if(!m_quadrupole.empty())
+	{
+		m_quadrupole[idx] = space_quadrupole_merge(m_mass_center[idx],
+												   m_mass_center[left], m_mass[left], m_quadrupole[left],
+												   m_mass_center[rght], m_mass[rght], m_quadrupole[rght]);
+	}
 
 	m_box_min[idx] = nbvertex_t(std::min(m_box_min[left].x, m_box_min[rght].x),
 								std::min(m_box_min[left].y, m_box_min[rght].y),
@@ -159,5 +260,22 @@ void nbody_space_heap::build(size_t count, size_t* indites, const nbcoord_t* rx,
 								std::max(m_box_max[left].z, m_box_max[rght].z));
 	nbcoord_t	r = (m_box_max[idx] - m_box_min[idx]).length() * static_cast<nbcoord_t>(0.5) +
 					((m_box_max[idx] + m_box_min[idx]) / 2 - m_mass_center[idx]).length();
-	m_radius_sqr[idx] = r * r;
+	m_radius_sqr[idx] = r * r * (m_distance_to_node_radius_ratio * m_distance_to_node_radius_ratio);
+}
+
+size_t nbody_space_heap::leaf_count(size_t idx) const
+{
+	// Leaves are nodes [N, 2N), children of internal nodes [1, N) are always less than 2N
+	size_t	leaf_begin = m_body_n.size() / 2;
+	size_t	leaf_end = 2 * leaf_begin;
+	size_t	count = 0;
+
+	for(size_t begin = idx, end = idx + 1; begin < leaf_end; begin = left_idx(begin), end = left_idx(end))
+	{
+		if(end > leaf_begin)
+		{
+			count += std::min(end, leaf_end) - std::max(begin, leaf_begin);
+		}
+	}
+	return count;
 }
@@ -10,16 +10,68 @@ protected:
 	std::vector<nbvertex_t>	m_mass_center;
 	std::vector<nbcoord_t>	m_mass;
 	std::vector<nbcoord_t>	m_radius_sqr;
+	//! Empty if multipole order is 0
+	std::vector<space_quadrupole>	m_quadrupole;
 	std::vector<nbvertex_t>	m_box_min;
 	std::vector<nbvertex_t>	m_box_max;
 	std::vector<size_t>		m_body_n;
 	nbcoord_t				m_distance_to_node_radius_ratio;
+	size_t					m_multipole_order;
 public:
-	nbody_space_heap();
+	//! @param multipole_order - 0 (monopole) or 2 (quadrupole) node moments to use at traverse
+	explicit nbody_space_heap(size_t multipole_order = 0);
 	void build(size_t count, const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
 			   const nbcoord_t* mass, nbcoord_t distance_to_node_radius_ratio);
+	//! Tree was built at least once
+	bool is_built() const;
+	//! Update mass centers, boxes and radii bottom-up for new body positions, tree topology is kept
+	void refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz, const nbcoord_t* mass);
+	//! Mean relative overlap of children boxes. It is close to 0 just after build and grows with refits
+	nbcoord_t overlap() const;
 
-	nbvertex_t traverse(const nbody_data* data, const nbvertex_t& v1, const nbcoord_t mass1) const;
+	//! Acceleration at point 'v1' with pairwise force 'law' (see nbody_force_law.h)
+	template<class ForceLaw>
+	nbvertex_t traverse(const ForceLaw& law, const nbvertex_t& v1) const
+	{
+		nbvertex_t			total;
+		const bool			quadrupole = !m_quadrupole.empty();
+
+		size_t	stack_data[MAX_STACK_SIZE] = {};
+		size_t*	stack = stack_data;
+		size_t*	stack_head = stack;
+
+		*stack++ = NBODY_HEAP_ROOT_INDEX;
+		while(stack != stack_head)
+		{
+			size_t				curr = *--stack;
+			const nbvertex_t	dr(m_mass_center[curr] - v1);
+			const nbcoord_t		distance_sqr(dr.norm());
+
+			if(distance_sqr > m_radius_sqr[curr])
+			{
+				total += dr * (m_mass[curr] * law(distance_sqr));
+				// Leaves have zero radius and zero quadrupole
+				if(quadrupole && m_radius_sqr[curr] > 0)
+				{
+					total += space_quadrupole_force(v1, m_mass_center[curr], 1, m_quadrupole[curr]);
+				}
+			}
+			else
+			{
+				size_t	left(left_idx(curr));
+				size_t	rght(rght_idx(curr));
+				if(rght < m_body_n.size())
+				{
+					*stack++ = rght;
+				}
+				if(left < m_body_n.size())
+				{
+					*stack++ = left;
+				}
+			}
+		}
+		return total;
+	}
 	template<class Visitor>
 	void traverse(Visitor visit) const
 	{
@@ -31,13 +83,41 @@ public:
 			visit(body_n, m_mass_center[idx], m_mass[idx]);
 		}
 	}
+	//! Visit each leaf bucket with its bodies and shared interaction list
+	template<class Visitor>
+	void traverse_group(size_t bucket_size, Visitor visit) const
+	{
+		std::vector<size_t>	buckets;
+		this->buckets(NBODY_HEAP_ROOT_INDEX, bucket_size, buckets);
+
+		#pragma omp parallel
+		{
+			space_interaction_list	list;
+			std::vector<size_t>		bodies;
+
+			#pragma omp for schedule(dynamic, 1)
+			for(size_t n = 0; n < buckets.size(); ++n)
+			{
+				bodies.clear();
+				this->bodies(buckets[n], bodies);
+				interaction_list(buckets[n], list);
+				visit(bodies, list);
+			}
+		}
+	}
 	const std::vector<nbvertex_t>& get_mass_center() const;
 	const std::vector<nbcoord_t>& get_mass() const;
 	const std::vector<nbcoord_t>& get_radius_sqr() const;
 	const std::vector<size_t>&	get_body_n() const;
+	//! Count of bodies (leaves) at subtree 'idx'
+	size_t leaf_count(size_t idx) const;
 private:
 	void build(size_t count, size_t* indites, const nbcoord_t* rx, const nbcoord_t* ry,
 			   const nbcoord_t* rz, const nbcoord_t* mass, size_t idx, size_t dimension);
+	void update(size_t idx);
+	void buckets(size_t idx, size_t bucket_size, std::vector<size_t>& buckets) const;
+	void bodies(size_t idx, std::vector<size_t>& bodies) const;
+	void interaction_list(size_t bucket, space_interaction_list& list) const;
 };
 
 #endif //NBODY_SPACE_HEAP_H
@@ -6,7 +6,41 @@
 class nbody_space_heap_stackless : public nbody_space_heap
 {
 public:
-	nbvertex_t traverse(const nbody_data* data, const nbvertex_t& v1, const nbcoord_t mass1) const;
+	explicit nbody_space_heap_stackless(size_t multipole_order = 0);
+	//! Acceleration at point 'v1' with pairwise force 'law' (see nbody_force_law.h)
+	template<class ForceLaw>
+	nbvertex_t traverse(const ForceLaw& law, const nbvertex_t& v1) const
+	{
+		nbvertex_t	total;
+		size_t		curr = NBODY_HEAP_ROOT_INDEX;
+		size_t		tree_size = m_mass_center.size();
+		const bool	quadrupole = !m_quadrupole.empty();
+
+		do
+		{
+			Q_ASSERT(curr < tree_size);
+			const nbvertex_t	dr(m_mass_center[curr] - v1);
+			const nbcoord_t		distance_sqr(dr.norm());
+
+			if(distance_sqr > m_radius_sqr[curr])
+			{
+				total += dr * (m_mass[curr] * law(distance_sqr));
+				// Leaves have zero radius and zero quadrupole
+				if(quadrupole && m_radius_sqr[curr] > 0)
+				{
+					total += space_quadrupole_force(v1, m_mass_center[curr], 1, m_quadrupole[curr]);
+				}
+				curr = skip_idx(curr);
+			}
+			else
+			{
+				curr = next_up(curr, tree_size);
+			}
+		}
+		while(curr != NBODY_HEAP_ROOT_INDEX);//NOLINT
+
+		return total;
+	}
 	template<class Visitor>
 	void traverse(Visitor visit) const
 	{
@@ -0,0 +1,161 @@
+#include "nbody_space_order.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+static constexpr uint32_t	CURVE_BITS = 21;
+
+//! Spread lower 21 bits of x to every third bit
+uint64_t morton_spread(uint64_t x)
+{
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffff;
+	x = (x | x << 16) & 0x1f0000ff0000ff;
+	x = (x | x << 8) & 0x100f00f00f00f00f;
+	x = (x | x << 4) & 0x10c30c30c30c30c3;
+	x = (x | x << 2) & 0x1249249249249249;
+	return x;
+}
+
+uint64_t morton_key(uint32_t x, uint32_t y, uint32_t z)
+{
+	return (morton_spread(x) << 2) | (morton_spread(y) << 1) | morton_spread(z);
+}
+
+/*!
+	Hilbert curve index
+	J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707, 381 (2004)
+ */
+uint64_t hilbert_key(uint32_t x, uint32_t y, uint32_t z)
+{
+	uint32_t	X[3] = {x, y, z};
+	uint32_t	M = 1U << (CURVE_BITS - 1);
+
+	// Inverse undo
+	for(uint32_t Q = M; Q > 1; Q >>= 1)
+	{
+		uint32_t	P = Q - 1;
+		for(size_t i = 0; i != 3; ++i)
+		{
+			if(X[i] & Q)
+			{
+				X[0] ^= P;
+			}
+			else
+			{
+				uint32_t	t = (X[0] ^ X[i]) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+
+	// Gray encode
+	for(size_t i = 1; i != 3; ++i)
+	{
+		X[i] ^= X[i - 1];
+	}
+	uint32_t	t = 0;
+	for(uint32_t Q = M; Q > 1; Q >>= 1)
+	{
+		if(X[2] & Q)
+		{
+			t ^= Q - 1;
+		}
+	}
+	for(size_t i = 0; i != 3; ++i)
+	{
+		X[i] ^= t;
+	}
+
+	// Transposed form to index: take bits from most significant
+	uint64_t	key = 0;
+	for(uint32_t b = CURVE_BITS; b-- > 0;)
+	{
+		for(size_t i = 0; i != 3; ++i)
+		{
+			key = (key << 1) | ((X[i] >> b) & 1);
+		}
+	}
+	return key;
+}
+
+}//namespace
+
+const char* body_order_name(e_body_order order)
+{
+	switch(order)
+	{
+	case ebo_none:
+		return "none";
+	case ebo_morton:
+		return "morton";
+	case ebo_hilbert:
+		return "hilbert";
+	default:
+		return "";
+	}
+	return "";
+}
+
+e_body_order body_order_from_str(const QString& name)
+{
+	if(name == "none")
+	{
+		return ebo_none;
+	}
+	else if(name == "morton")
+	{
+		return ebo_morton;
+	}
+	else if(name == "hilbert")
+	{
+		return ebo_hilbert;
+	}
+
+	return ebo_unknown;
+}
+
+void space_order(e_body_order type, size_t count,
+				 const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+				 std::vector<size_t>& order)
+{
+	order.resize(count);
+	for(size_t i = 0; i != count; ++i)
+	{
+		order[i] = i;
+	}
+
+	if(count == 0 || (type != ebo_morton && type != ebo_hilbert))
+	{
+		return;
+	}
+
+	nbvertex_t	bmin(rx[0], ry[0], rz[0]);
+	nbvertex_t	bmax(bmin);
+	for(size_t i = 0; i != count; ++i)
+	{
+		bmin = nbvertex_t(std::min(bmin.x, rx[i]), std::min(bmin.y, ry[i]), std::min(bmin.z, rz[i]));
+		bmax = nbvertex_t(std::max(bmax.x, rx[i]), std::max(bmax.y, ry[i]), std::max(bmax.z, rz[i]));
+	}
+
+	const nbcoord_t		cells = static_cast<nbcoord_t>((1U << CURVE_BITS) - 1);
+	const nbvertex_t	size(bmax - bmin);
+	const nbcoord_t		max_size = std::max(size.x, std::max(size.y, size.z));
+	// Same scale for all axes, so curve cells stay cubic
+	const nbcoord_t		scale = (max_size > 0) ? cells / max_size : 0;
+	std::vector<uint64_t>	keys(count);
+
+	#pragma omp parallel for
+	for(size_t i = 0; i < count; ++i)
+	{
+		uint32_t	x = static_cast<uint32_t>((rx[i] - bmin.x) * scale);
+		uint32_t	y = static_cast<uint32_t>((ry[i] - bmin.y) * scale);
+		uint32_t	z = static_cast<uint32_t>((rz[i] - bmin.z) * scale);
+		keys[i] = (type == ebo_morton) ? morton_key(x, y, z) : hilbert_key(x, y, z);
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+					 [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+}
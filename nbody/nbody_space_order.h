@@ -0,0 +1,30 @@
+#ifndef NBODY_SPACE_ORDER_H
+#define NBODY_SPACE_ORDER_H
+
+#include <vector>
+#include "nbtype_info.h"
+#include "nbody_export.h"
+
+//! Order of bodies at engine memory
+enum e_body_order
+{
+	ebo_none,		// Bodies are kept at load order
+	ebo_morton,		// Z-order curve
+	ebo_hilbert,	// Hilbert curve
+
+	ebo_unknown = 0xffffffff
+};
+
+const char NBODY_DLL* body_order_name(e_body_order order);
+e_body_order NBODY_DLL body_order_from_str(const QString& name);
+
+/*!
+	Sort bodies along space filling curve.
+	Body coordinates are quantized to 21 bits per dimension inside bodies bounding box.
+	@param order - resulting permutation, order[new_index] = old_index
+ */
+void NBODY_DLL space_order(e_body_order type, size_t count,
+						   const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+						   std::vector<size_t>& order);
+
+#endif //NBODY_SPACE_ORDER_H
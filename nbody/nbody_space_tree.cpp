@@ -1,13 +1,11 @@
 #include "nbody_space_tree.h"
 
-nbody_space_tree::nbody_space_tree() :
-	m_root(nullptr)
-{
-}
+static constexpr size_t MAX_TASK_DEPTH = 8;
 
-nbody_space_tree::~nbody_space_tree()
+nbody_space_tree::nbody_space_tree(size_t multipole_order) :
+	m_distance_to_node_radius_ratio_sqr(0),
+	m_multipole_order(multipole_order)
 {
-	delete m_root;
 }
 
 nbody_space_tree::node::node() :
@@ -15,14 +13,9 @@ nbody_space_tree::node::node() :
 	m_right(nullptr),
 	m_mass(0),
 	m_radius_sqr(0),
-	m_body_n(std::numeric_limits<size_t>::max())
-{
-}
-
-nbody_space_tree::node::~node()
+	m_body_n(std::numeric_limits<size_t>::max()),
+	m_count(0)
 {
-	delete m_left;
-	delete m_right;
 }
 
 void nbody_space_tree::node::build(size_t count, size_t* indites,
@@ -30,10 +23,16 @@ void nbody_space_tree::node::build(size_t count, size_t* indites,
 								   const nbcoord_t* mass, size_t dimension,
 								   nbcoord_t distance_to_node_radius_ratio_sqr)
 {
+	m_count = count;
 	if(count == 1) // It is a leaf
 	{
+		// Node may be reused from previous build, so reset all fields
+		m_left = nullptr;
+		m_right = nullptr;
 		m_mass_center = nbvertex_t(rx[*indites], ry[*indites], rz[*indites]);
 		m_mass = mass[*indites];
+		m_radius_sqr = 0;
+		m_quadrupole = space_quadrupole();
 		m_body_n = *indites;
 		m_bmin = m_mass_center;
 		m_bmax = m_mass_center;
@@ -64,8 +63,10 @@ void nbody_space_tree::node::build(size_t count, size_t* indites,
 	}
 
 	size_t next_dimension((dimension + 1) % SPACE_DIMENSIONS);
-	m_left = new node();
-	m_right = new node();
+	// Depth-first layout: left subtree takes 2 * left_size - 1 nodes just after this one
+	m_left = this + 1;
+	m_right = this + 2 * left_size;
+	m_body_n = std::numeric_limits<size_t>::max();
 
 	if(count > NBODY_DATA_BLOCK_SIZE)
 	{
@@ -81,9 +82,48 @@ void nbody_space_tree::node::build(size_t count, size_t* indites,
 		m_right->build(right_size, median, rx, ry, rz, mass, next_dimension, distance_to_node_radius_ratio_sqr);
 	}
 
+	update(distance_to_node_radius_ratio_sqr);
+}
+
+void nbody_space_tree::node::refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+								   const nbcoord_t* mass, size_t depth,
+								   nbcoord_t distance_to_node_radius_ratio_sqr)
+{
+	if(m_left == nullptr) // It is a leaf
+	{
+		m_mass_center = nbvertex_t(rx[m_body_n], ry[m_body_n], rz[m_body_n]);
+		m_mass = mass[m_body_n];
+		m_bmin = m_mass_center;
+		m_bmax = m_mass_center;
+		return;
+	}
+
+	// Tree is balanced, so first levels have enough work for tasks
+	if(depth < MAX_TASK_DEPTH)
+	{
+		#pragma omp task
+		m_left->refit(rx, ry, rz, mass, depth + 1, distance_to_node_radius_ratio_sqr);
+		#pragma omp task
+		m_right->refit(rx, ry, rz, mass, depth + 1, distance_to_node_radius_ratio_sqr);
+		#pragma omp taskwait
+	}
+	else
+	{
+		m_left->refit(rx, ry, rz, mass, depth + 1, distance_to_node_radius_ratio_sqr);
+		m_right->refit(rx, ry, rz, mass, depth + 1, distance_to_node_radius_ratio_sqr);
+	}
+
+	update(distance_to_node_radius_ratio_sqr);
+}
+
+void nbody_space_tree::node::update(nbcoord_t distance_to_node_radius_ratio_sqr)
+{
 	m_mass = m_left->m_mass + m_right->m_mass;
 	m_mass_center = (m_left->m_mass_center * m_left->m_mass +
 					 m_right->m_mass_center * m_right->m_mass) / m_mass;
+	m_quadrupole = space_quadrupole_merge(m_mass_center,
+										  m_left->m_mass_center, m_left->m_mass, m_left->m_quadrupole,
+										  m_right->m_mass_center, m_right->m_mass, m_right->m_quadrupole);
 	m_bmin = nbvertex_t(std::min(m_left->m_bmin.x, m_right->m_bmin.x),
 						std::min(m_left->m_bmin.y, m_right->m_bmin.y),
 						std::min(m_left->m_bmin.z, m_right->m_bmin.z));
@@ -95,39 +135,77 @@ void nbody_space_tree::node::build(size_t count, size_t* indites,
 	m_radius_sqr = m_radius_sqr * m_radius_sqr * distance_to_node_radius_ratio_sqr;
 }
 
-nbvertex_t nbody_space_tree::traverse(const nbody_data* data,
-									  const nbvertex_t& v1,
-									  const nbcoord_t mass1) const
+void nbody_space_tree::node::overlap(nbcoord_t& total, size_t& count) const
+{
+	if(m_left == nullptr)
+	{
+		return;
+	}
+	total += space_box_overlap(m_bmin, m_bmax, m_left->m_bmin, m_left->m_bmax,
+							   m_right->m_bmin, m_right->m_bmax);
+	++count;
+	m_left->overlap(total, count);
+	m_right->overlap(total, count);
+}
+
+void nbody_space_tree::node::buckets(size_t bucket_size, std::vector<const node*>& buckets) const
+{
+	if(m_count <= bucket_size)
+	{
+		buckets.push_back(this);
+		return;
+	}
+	m_left->buckets(bucket_size, buckets);
+	m_right->buckets(bucket_size, buckets);
+}
+
+void nbody_space_tree::node::bodies(std::vector<size_t>& bodies) const
 {
-	nbvertex_t			total_force;
+	if(m_left == nullptr)
+	{
+		bodies.push_back(m_body_n);
+		return;
+	}
+	m_left->bodies(bodies);
+	m_right->bodies(bodies);
+}
 
-	node*	stack_data[MAX_STACK_SIZE] = {};
-	node**	stack = stack_data;
-	node**	stack_head = stack;
+void nbody_space_tree::interaction_list(const node* bucket, space_interaction_list& list) const
+{
+	const bool	quadrupole = (m_multipole_order == 2);
+
+	list.clear();
 
-	*stack++ = m_root;
+	const node*		stack_data[MAX_STACK_SIZE] = {};
+	const node**	stack = stack_data;
+	const node**	stack_head = stack;
+
+	*stack++ = root();
 	while(stack != stack_head)
 	{
-		node*				curr = *--stack;
-		const nbcoord_t		distance_sqr((v1 - curr->m_mass_center).norm());
+		const node*		curr = *--stack;
 
-		if(distance_sqr > curr->m_radius_sqr)
+		if(curr->m_left == nullptr)
 		{
-			total_force += data->force(v1, curr->m_mass_center, mass1, curr->m_mass);
+			// Leaf is a single body, it is computed directly
+			list.add(curr->m_mass_center, curr->m_mass);
 		}
-		else
+		else if(space_box_distance_sqr(curr->m_mass_center, bucket->m_bmin, bucket->m_bmax) > curr->m_radius_sqr)
 		{
-			if(curr->m_right != NULL)
+			// Node is far enough from every body of the bucket
+			list.add(curr->m_mass_center, curr->m_mass);
+			if(quadrupole)
 			{
-				*stack++ = curr->m_right;
-			}
-			if(curr->m_left != NULL)
-			{
-				*stack++ = curr->m_left;
+				list.quadrupole_center.push_back(curr->m_mass_center);
+				list.quadrupole.push_back(curr->m_quadrupole);
 			}
 		}
+		else
+		{
+			*stack++ = curr->m_right;
+			*stack++ = curr->m_left;
+		}
 	}
-	return total_force;
 }
 
 void nbody_space_tree::build(size_t count, const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
@@ -141,9 +219,39 @@ void nbody_space_tree::build(size_t count, const nbcoord_t* rx, const nbcoord_t*
 		bodies_indites[i] = i;
 	}
 
-	m_root = new node();
+	// Arena is kept between builds, all nodes are rewritten by build
+	m_nodes.resize(2 * count - 1);
+	m_distance_to_node_radius_ratio_sqr = distance_to_node_radius_ratio * distance_to_node_radius_ratio;
+	#pragma omp parallel
+	#pragma omp single
+	m_nodes.front().build(count, bodies_indites.data(), rx, ry, rz, mass, 0,
+				  m_distance_to_node_radius_ratio_sqr);
+}
+
+bool nbody_space_tree::is_built() const
+{
+	return !m_nodes.empty();
+}
+
+void nbody_space_tree::refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+							 const nbcoord_t* mass)
+{
 	#pragma omp parallel
 	#pragma omp single
-	m_root->build(count, bodies_indites.data(), rx, ry, rz, mass, 0,
-				  distance_to_node_radius_ratio * distance_to_node_radius_ratio);
+	m_nodes.front().refit(rx, ry, rz, mass, 0, m_distance_to_node_radius_ratio_sqr);
+}
+
+nbcoord_t nbody_space_tree::overlap() const
+{
+	nbcoord_t	total = 0;
+	size_t		count = 0;
+
+	root()->overlap(total, count);
+
+	return count == 0 ? 0 : total / static_cast<nbcoord_t>(count);
+}
+
+const nbody_space_tree::node* nbody_space_tree::root() const
+{
+	return m_nodes.data();
 }
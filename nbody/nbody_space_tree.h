@@ -3,6 +3,12 @@
 
 #include "nbody_engine_simple_bh.h"
 
+/*!
+	Binary tree with nodes stored in a single arena in depth-first order.
+	Subtree with N bodies takes exactly 2N - 1 consecutive nodes, so left child
+	immediately follows its parent and right child follows the left subtree.
+	Arena is reused between builds with the same bodies count.
+ */
 class nbody_space_tree
 {
 	class node
@@ -13,36 +19,52 @@ class nbody_space_tree
 		nbvertex_t				m_mass_center;
 		nbcoord_t				m_mass;
 		nbcoord_t				m_radius_sqr;
+		space_quadrupole		m_quadrupole;
 		nbvertex_t				m_bmin;
 		nbvertex_t				m_bmax;
 		size_t					m_body_n;
+		size_t					m_count;
 	public:
 		node();
-		~node();
 		void build(size_t count, size_t* indites,
 				   const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
 				   const nbcoord_t* mass, size_t dimension,
 				   nbcoord_t distance_to_node_radius_ratio_sqr);
+		void refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
+				   const nbcoord_t* mass, size_t depth,
+				   nbcoord_t distance_to_node_radius_ratio_sqr);
+		void update(nbcoord_t distance_to_node_radius_ratio_sqr);
+		void overlap(nbcoord_t& total, size_t& count) const;
+		void buckets(size_t bucket_size, std::vector<const node*>& buckets) const;
+		void bodies(std::vector<size_t>& bodies) const;
 	};
-	node*		m_root;
+	std::vector<node>	m_nodes;
+	nbcoord_t	m_distance_to_node_radius_ratio_sqr;
+	size_t		m_multipole_order;
 public:
-	nbody_space_tree();
-	~nbody_space_tree();
+	//! @param multipole_order - 0 (monopole) or 2 (quadrupole) node moments to use at traverse
+	explicit nbody_space_tree(size_t multipole_order = 0);
 
 	void build(size_t count, const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz,
 			   const nbcoord_t* mass, nbcoord_t distance_to_node_radius_ratio);
+	//! Tree was built at least once
+	bool is_built() const;
+	//! Update mass centers, boxes and radii bottom-up for new body positions, tree topology is kept
+	void refit(const nbcoord_t* rx, const nbcoord_t* ry, const nbcoord_t* rz, const nbcoord_t* mass);
+	//! Mean relative overlap of children boxes. It is close to 0 just after build and grows with refits
+	nbcoord_t overlap() const;
 
 	template<class Visitor>
 	void traverse(Visitor visit) const
 	{
-		node*	stack_data[MAX_STACK_SIZE] = {};
-		node**	stack = stack_data;
-		node**	stack_head = stack;
+		const node*		stack_data[MAX_STACK_SIZE] = {};
+		const node**	stack = stack_data;
+		const node**	stack_head = stack;
 
-		*stack++ = m_root;
+		*stack++ = root();
 		while(stack != stack_head)
 		{
-			node*				curr = *--stack;
+			const node*			curr = *--stack;
 			if(curr->m_radius_sqr > 0)
 			{
 				if(curr->m_left != NULL)
@@ -61,7 +83,73 @@ public:
 		}
 	}
 
-	nbvertex_t traverse(const nbody_data* data, const nbvertex_t& v1, const nbcoord_t mass1) const;
+	//! Acceleration at point 'v1' with pairwise force 'law' (see nbody_force_law.h)
+	template<class ForceLaw>
+	nbvertex_t traverse(const ForceLaw& law, const nbvertex_t& v1) const
+	{
+		nbvertex_t			total;
+		const bool			quadrupole = (m_multipole_order == 2);
+
+		const node*		stack_data[MAX_STACK_SIZE] = {};
+		const node**	stack = stack_data;
+		const node**	stack_head = stack;
+
+		*stack++ = root();
+		while(stack != stack_head)
+		{
+			const node*			curr = *--stack;
+			const nbvertex_t	dr(curr->m_mass_center - v1);
+			const nbcoord_t		distance_sqr(dr.norm());
+
+			if(distance_sqr > curr->m_radius_sqr)
+			{
+				total += dr * (curr->m_mass * law(distance_sqr));
+				// Leaves have zero radius and zero quadrupole
+				if(quadrupole && curr->m_radius_sqr > 0)
+				{
+					total += space_quadrupole_force(v1, curr->m_mass_center, 1, curr->m_quadrupole);
+				}
+			}
+			else
+			{
+				if(curr->m_right != NULL)
+				{
+					*stack++ = curr->m_right;
+				}
+				if(curr->m_left != NULL)
+				{
+					*stack++ = curr->m_left;
+				}
+			}
+		}
+		return total;
+	}
+
+	//! Visit each leaf bucket with its bodies and shared interaction list
+	template<class Visitor>
+	void traverse_group(size_t bucket_size, Visitor visit) const
+	{
+		std::vector<const node*>	buckets;
+		root()->buckets(bucket_size, buckets);
+
+		#pragma omp parallel
+		{
+			space_interaction_list	list;
+			std::vector<size_t>		bodies;
+
+			#pragma omp for schedule(dynamic, 1)
+			for(size_t n = 0; n < buckets.size(); ++n)
+			{
+				bodies.clear();
+				buckets[n]->bodies(bodies);
+				interaction_list(buckets[n], list);
+				visit(bodies, list);
+			}
+		}
+	}
+private:
+	const node* root() const;
+	void interaction_list(const node* bucket, space_interaction_list& list) const;
 };
 
 
@@ -40,11 +40,41 @@ inline __float128 sqrt(__float128 x)
 	return sqrtq(x);
 }
 
+inline __float128 cbrt(__float128 x)
+{
+	return cbrtq(x);
+}
+
 inline __float128 fabs(__float128 x)
 {
 	return fabsq(x);
 }
 
+inline __float128 sin(__float128 x)
+{
+	return sinq(x);
+}
+
+inline __float128 cos(__float128 x)
+{
+	return cosq(x);
+}
+
+inline __float128 sinh(__float128 x)
+{
+	return sinhq(x);
+}
+
+inline __float128 cosh(__float128 x)
+{
+	return coshq(x);
+}
+
+inline __float128 fmod(__float128 x, __float128 y)
+{
+	return fmodq(x, y);
+}
+
 inline QDebug operator << (QDebug g, __float128 v)
 {
 	char	buf[256] = {0};
@@ -1,7 +1,12 @@
 unix{
 	!clang {
 		NBODY_FLAGS += -ftree-vectorizer-verbose=1
-		NBODY_FLAGS += -O3 -mavx -ftree-vectorize
+		NBODY_FLAGS += -O3 -ftree-vectorize -fno-math-errno -fno-trapping-math
+	}
+	# ISA specific code (nbody_engine_simd) is dispatched at runtime,
+	# so target ISA is only raised on explicit request: qmake CONFIG+=native
+	native {
+		NBODY_FLAGS += -march=native
 	}
 	QMAKE_CFLAGS_RELEASE -= -O2
 	QMAKE_CXXFLAGS_RELEASE -= -O2
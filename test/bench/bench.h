@@ -59,7 +59,12 @@ QVariantMap run(const QVariantMap& param,
 	{
 		size_t		stars_count = param.value("stars_count", "1024").toUInt();
 		nbcoord_t	box_size = 100;
+		size_t		body_count = param.value("body_count", "0").toUInt();
 		data.make_universe(stars_count / 2, box_size, box_size, box_size);
+		if(body_count != 0 && body_count < data.get_count())
+		{
+			data.resize(body_count);
+		}
 	}
 	else
 	{
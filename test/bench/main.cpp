@@ -23,8 +23,18 @@ void bench_cpu(const QString& format)
 		{"engine", "block"},
 		{"solver", "euler"}
 	}));
+	QVariantMap param4(std::map<QString, QVariant>(
+	{
+		{"engine", "simd"},
+		{"solver", "euler"}
+	}));
+	QVariantMap param5(std::map<QString, QVariant>(
+	{
+		{"engine", "tiled"},
+		{"solver", "euler"}
+	}));
 
-	std::vector<QVariantMap>				params = {param1, param2, param3};
+	std::vector<QVariantMap>				params = {param1, param2, param3, param4, param5};
 	std::vector<QVariant>					stars_counts = {1024, 2048, 4096, 8192};
 	QString									variable_field = "stars_count";
 	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(stars_counts.size()));
@@ -33,6 +43,33 @@ void bench_cpu(const QString& format)
 	print_table(params, stars_counts, result, "engine", QStringList() << "time", QStringList(), format);
 }
 
+void bench_cpu_odd(const QString& format)
+{
+	QVariantMap param1(std::map<QString, QVariant>(
+	{
+		{"name", "block"},
+		{"engine", "block"},
+		{"solver", "euler"},
+		{"stars_count", 8192}
+	}));
+	QVariantMap param2(std::map<QString, QVariant>(
+	{
+		{"name", "block_mixed"},
+		{"engine", "block"},
+		{"mixed_precision", 1},
+		{"solver", "euler"},
+		{"stars_count", 8192}
+	}));
+
+	std::vector<QVariantMap>				params = {param1, param2};
+	std::vector<QVariant>					body_counts = {4031, 4032, 4033, 4095, 4096, 4097, 4159, 4160};
+	QString									variable_field = "body_count";
+	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(body_counts.size()));
+
+	run_bench(params, body_counts, result, variable_field, QString(), 1);
+	print_table(params, body_counts, result, "name", QStringList() << "time", QStringList(), format);
+}
+
 void bench_gpu(const QString& format)
 {
 	QVariantMap param1(std::map<QString, QVariant>(
@@ -336,14 +373,96 @@ void bench_solver(const QString& format)
 		{"min_step", "-1"}
 	}));
 	QVariantMap param15(std::map<QString, QVariant>(
+	{
+		{"name", "rkdp_ode2"},
+		{"engine", engine},
+		{"solver", "rkdp"},
+		{"ode_order", 2},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+	QVariantMap param16(std::map<QString, QVariant>(
+	{
+		{"name", "rkn4"},
+		{"engine", engine},
+		{"solver", "rkn4"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param17(std::map<QString, QVariant>(
+	{
+		{"name", "rkn64"},
+		{"engine", engine},
+		{"solver", "rkn64"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+	QVariantMap param18(std::map<QString, QVariant>(
 	{
 		{"name", "trapeze"},
 		{"engine", engine},
 		{"solver", "trapeze"},
 		{"stars_count", stars_count}
 	}));
+	QVariantMap param19(std::map<QString, QVariant>(
+	{
+		{"name", "leapfrog"},
+		{"engine", engine},
+		{"solver", "leapfrog"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param20(std::map<QString, QVariant>(
+	{
+		{"name", "yoshida4"},
+		{"engine", engine},
+		{"solver", "yoshida4"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param21(std::map<QString, QVariant>(
+	{
+		{"name", "yoshida6"},
+		{"engine", engine},
+		{"solver", "yoshida6"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param22(std::map<QString, QVariant>(
+	{
+		{"name", "yoshida8"},
+		{"engine", engine},
+		{"solver", "yoshida8"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param23(std::map<QString, QVariant>(
+	{
+		{"name", "forest-ruth"},
+		{"engine", engine},
+		{"solver", "forest-ruth"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param24(std::map<QString, QVariant>(
+	{
+		{"name", "block-step"},
+		{"engine", engine},
+		{"solver", "block-step"},
+		{"stars_count", stars_count},
+		{"min_step", 1e-5}
+	}));
+	QVariantMap param25(std::map<QString, QVariant>(
+	{
+		{"name", "hermite"},
+		{"engine", engine},
+		{"solver", "hermite"},
+		{"stars_count", stars_count}
+	}));
+	QVariantMap param26(std::map<QString, QVariant>(
+	{
+		{"name", "abm"},
+		{"engine", engine},
+		{"solver", "abm"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
 
-	std::vector<QVariantMap>				params = {param01, param02, param03, param04, param05, param06, param07, param08, param09, param10, param11, param12, param13, param14, param15};
+	std::vector<QVariantMap>				params = {param01, param02, param03, param04, param05, param06, param07, param08, param09, param10, param11, param12, param13, param14, param15, param16, param17, param18, param19, param20, param21, param22, param23, param24, param25, param26};
 	std::vector<QVariant>					steps = {0.1, 0.1 / 8, 0.1 / (8 * 8), 0.1 / (8 * 8 * 8), 0.1 / (8 * 8 * 8 * 8), 0.1 / (8 * 8 * 8 * 8 * 8)};
 	QString									variable_field = "max_step";
 	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(steps.size()));
@@ -357,6 +476,56 @@ void bench_solver(const QString& format)
 				QStringList() << "$f_n$ compute count" << "$dP/P_0$", format);
 }
 
+void bench_mixed_precision(const QString& format)
+{
+	int		stars_count = 512;
+	QVariantMap param1(std::map<QString, QVariant>(
+	{
+		{"name", "openmp"},
+		{"engine", "openmp"},
+		{"solver", "rkdp"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+	QVariantMap param2(std::map<QString, QVariant>(
+	{
+		{"name", "openmp_mixed"},
+		{"engine", "openmp"},
+		{"mixed_precision", 1},
+		{"solver", "rkdp"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+	QVariantMap param3(std::map<QString, QVariant>(
+	{
+		{"name", "block"},
+		{"engine", "block"},
+		{"solver", "rkdp"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+	QVariantMap param4(std::map<QString, QVariant>(
+	{
+		{"name", "block_mixed"},
+		{"engine", "block"},
+		{"mixed_precision", 1},
+		{"solver", "rkdp"},
+		{"stars_count", stars_count},
+		{"min_step", "-1"}
+	}));
+
+	std::vector<QVariantMap>				params = {param1, param2, param3, param4};
+	std::vector<QVariant>					steps = {0.1, 0.1 / 8, 0.1 / (8 * 8), 0.1 / (8 * 8 * 8)};
+	QString									variable_field = "max_step";
+	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(steps.size()));
+
+	run_bench(params, steps, result, variable_field, "PLVE", 2.5);
+	print_table(params, steps, result, "name", QStringList() << "time" << "dE",
+				QStringList() << "Step time (s)" << "$dE/E_0$", format);
+	print_table(params, steps, result, "name", QStringList() << "time" << "dP",
+				QStringList() << "Step time (s)" << "$dP/P_0$", format);
+}
+
 void bench_solver_quad(const QString& format)
 {
 	int		stars_count = 512;
@@ -494,6 +663,49 @@ void bench_cpu_tree(const QString& format)
 		{"max_step", "0.01"}
 	}));
 	QVariantMap param07(std::map<QString, QVariant>(
+	{
+		{"name", "cycle+heap+quadrupole"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "cycle"},
+		{"tree_layout", "heap"},
+		{"multipole_order", 2},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param08(std::map<QString, QVariant>(
+	{
+		{"name", "cycle+heap stackless+quadrupole"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "cycle"},
+		{"tree_layout", "heap_stackless"},
+		{"multipole_order", 2},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param09(std::map<QString, QVariant>(
+	{
+		{"name", "group+heap"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "group"},
+		{"tree_layout", "heap"},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param10(std::map<QString, QVariant>(
+	{
+		{"name", "group+heap+quadrupole"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "group"},
+		{"tree_layout", "heap"},
+		{"multipole_order", 2},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param11(std::map<QString, QVariant>(
 	{
 		{"name", "openmp+block+optimization"},
 		{"engine", "block"},
@@ -501,7 +713,7 @@ void bench_cpu_tree(const QString& format)
 		{"stars_count", stars_count},
 		{"max_step", "0.01"}
 	}));
-	std::vector<QVariantMap>				params = {param01, param02, param03, param04, param05, param06, param07};
+	std::vector<QVariantMap>				params = {param01, param02, param03, param04, param05, param06, param07, param08, param09, param10, param11};
 	std::vector<QVariant>					ratio = {0.1, 0.5, 1, 2, 4, 16, 64, 256, 1024};
 	QString									variable_field = "distance_to_node_radius_ratio";
 	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(ratio.size()));
@@ -514,6 +726,266 @@ void bench_cpu_tree(const QString& format)
 				QStringList() << "$\\lambda_{crit}$" << "Step time (s)", format);
 }
 
+void bench_cpu_fmm(const QString& format)
+{
+	int		stars_count = 1024 * 32;
+
+	QVariantMap param01(std::map<QString, QVariant>(
+	{
+		{"name", "fmm p=2"},
+		{"engine", "fmm"},
+		{"fmm_order", 2},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param02(std::map<QString, QVariant>(
+	{
+		{"name", "fmm p=4"},
+		{"engine", "fmm"},
+		{"fmm_order", 4},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param03(std::map<QString, QVariant>(
+	{
+		{"name", "fmm p=6"},
+		{"engine", "fmm"},
+		{"fmm_order", 6},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param04(std::map<QString, QVariant>(
+	{
+		{"name", "fmm p=8"},
+		{"engine", "fmm"},
+		{"fmm_order", 8},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param05(std::map<QString, QVariant>(
+	{
+		{"name", "cycle+heap"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "cycle"},
+		{"tree_layout", "heap"},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param06(std::map<QString, QVariant>(
+	{
+		{"name", "openmp+block+optimization"},
+		{"engine", "block"},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	std::vector<QVariantMap>				params = {param01, param02, param03, param04, param05, param06};
+	std::vector<QVariant>					ratio = {1, 1.5, 2, 3, 4, 8, 16};
+	QString									variable_field = "distance_to_node_radius_ratio";
+	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(ratio.size()));
+
+	run_bench(params, ratio, result, variable_field, "PLVE", 1);
+	print_table(params, ratio, result, "name", QStringList() << "distance_to_node_radius_ratio" << "dE",
+				QStringList() << "$\\lambda_{crit}$" << "$dE/E_0$", format);
+	run_bench(params, ratio, result, variable_field, QString(), 1);
+	print_table(params, ratio, result, "name", QStringList() << "distance_to_node_radius_ratio" << "time",
+				QStringList() << "$\\lambda_{crit}$" << "Step time (s)", format);
+}
+
+void bench_body_order(const QString& format)
+{
+	int		stars_count = 1024 * 32;
+
+	QVariantMap param1(std::map<QString, QVariant>(
+	{
+		{"name", "cycle+heap"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "cycle"},
+		{"tree_layout", "heap"},
+		{"distance_to_node_radius_ratio", 4},
+		{"reorder_rate", 1},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param2(std::map<QString, QVariant>(
+	{
+		{"name", "nested tree+tree"},
+		{"engine", "simple_bh"},
+		{"traverse_type", "nested_tree"},
+		{"tree_layout", "tree"},
+		{"distance_to_node_radius_ratio", 4},
+		{"reorder_rate", 1},
+		{"solver", "euler"},
+		{"stars_count", stars_count},
+		{"max_step", "0.01"}
+	}));
+	QVariantMap param3(std::map<QString, QVariant>(
+	{
+		{"name", "ah"},
+		{"engine", "ah"},
+		{"reorder_rate", 1},
+		{"solver", "euler"},
+		{"stars_count", stars_count / 4},
+		{"max_step", "0.01"}
+	}));
+
+	std::vector<QVariantMap>				params = {param1, param2, param3};
+	std::vector<QVariant>					body_order = {"none", "morton", "hilbert"};
+	QString									variable_field = "body_order";
+	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(body_order.size()));
+
+	run_bench(params, body_order, result, variable_field, QString(), 1);
+	print_table(params, body_order, result, "name", QStringList() << "time", QStringList(), format);
+}
+
+void bench_step_control(const QString& format)
+{
+	int		stars_count = 512;
+	QString	engine("block");
+	QVariantMap param1(std::map<QString, QVariant>(
+	{
+		{"name", "rkdp+subdivision"},
+		{"engine", engine},
+		{"solver", "rkdp"},
+		{"step_control", "subdivision"},
+		{"stars_count", stars_count},
+		{"min_step", 1e-6},
+		{"max_step", 0.1}
+	}));
+	QVariantMap param2(std::map<QString, QVariant>(
+	{
+		{"name", "rkdp+pi"},
+		{"engine", engine},
+		{"solver", "rkdp"},
+		{"step_control", "pi"},
+		{"stars_count", stars_count},
+		{"min_step", 1e-6},
+		{"max_step", 0.1}
+	}));
+	QVariantMap param3(std::map<QString, QVariant>(
+	{
+		{"name", "rkf+subdivision"},
+		{"engine", engine},
+		{"solver", "rkf"},
+		{"step_control", "subdivision"},
+		{"stars_count", stars_count},
+		{"min_step", 1e-6},
+		{"max_step", 0.1}
+	}));
+	QVariantMap param4(std::map<QString, QVariant>(
+	{
+		{"name", "rkf+pi"},
+		{"engine", engine},
+		{"solver", "rkf"},
+		{"step_control", "pi"},
+		{"stars_count", stars_count},
+		{"min_step", 1e-6},
+		{"max_step", 0.1}
+	}));
+
+	std::vector<QVariantMap>				params = {param1, param2, param3, param4};
+	std::vector<QVariant>					error_thresholds = {1e-4, 1e-6, 1e-8, 1e-10, 1e-12};
+	QString									variable_field = "error_threshold";
+	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(error_thresholds.size()));
+
+	run_bench(params, error_thresholds, result, variable_field, "PLVE", 2.5);
+	print_table(params, error_thresholds, result, "name", QStringList() << "CC" << "dE",
+				QStringList() << "$f_n$ compute count" << "$dE/E_0$", format);
+	print_table(params, error_thresholds, result, "name", QStringList() << "CC" << "dL",
+				QStringList() << "$f_n$ compute count" << "$dL/L_0$", format);
+}
+
+/*!
+	Single pass fmaddn/fmaddn_inplace of CPU engines compared to
+	sequence of fmadd calls (one pass over 'a' per term)
+ */
+void bench_vector_ops(const QString& format, const QVariantMap& param)
+{
+	size_t		stars_count = param.value("stars_count", 1024 * 1024).toUInt();
+	size_t		repeat = param.value("repeat", 16).toUInt();
+	nbody_data	data;
+	data.make_universe(stars_count / 2, 100, 100, 100);
+
+	std::vector<QVariantMap>				params;
+	std::vector<QVariant>					term_counts = {1, 2, 4, 7, 13};
+	std::vector<std::vector<QVariantMap>>	result;
+	const QStringList						engines(QStringList() << "simple" << "openmp");
+
+	for(const QString& engine_type : engines)
+	{
+		nbody_engine*	engine = nbody_create_engine(QVariantMap(std::map<QString, QVariant>({{"engine", engine_type}})));
+		if(engine == NULL)
+		{
+			qDebug() << "Can't create engine" << engine_type;
+			return;
+		}
+		engine->init(&data);
+
+		size_t								ps(engine->problem_size());
+		nbody_engine::memory*				a = engine->create_buffer(sizeof(nbcoord_t) * ps);
+		nbody_engine::memory_array			k = engine->create_buffers(sizeof(nbcoord_t) * ps,
+																		 term_counts.back().toUInt());
+		std::vector<nbcoord_t>				coeff(k.size(), 1e-3_f);
+		std::vector<QVariantMap>			row_fmadd(term_counts.size());
+		std::vector<QVariantMap>			row_fmaddn(term_counts.size());
+		std::vector<QVariantMap>			row_fmaddn_inplace(term_counts.size());
+
+		for(size_t n = 0; n != k.size(); ++n)
+		{
+			engine->copy_buffer(k[n], engine->get_y());
+		}
+
+		for(size_t j = 0; j != term_counts.size(); ++j)
+		{
+			size_t	terms = term_counts[j].toUInt();
+			double	wtime = omp_get_wtime();
+			for(size_t r = 0; r != repeat; ++r)
+			{
+				engine->fmadd(a, engine->get_y(), k[0], coeff[0]);
+				for(size_t n = 1; n < terms; ++n)
+				{
+					engine->fmadd(a, a, k[n], coeff[n]);
+				}
+			}
+			row_fmadd[j]["time"] = (omp_get_wtime() - wtime) / repeat;
+
+			wtime = omp_get_wtime();
+			for(size_t r = 0; r != repeat; ++r)
+			{
+				engine->fmaddn(a, engine->get_y(), k, coeff.data(), terms);
+			}
+			row_fmaddn[j]["time"] = (omp_get_wtime() - wtime) / repeat;
+
+			wtime = omp_get_wtime();
+			for(size_t r = 0; r != repeat; ++r)
+			{
+				engine->fmaddn_inplace(a, k, coeff.data(), terms);
+			}
+			row_fmaddn_inplace[j]["time"] = (omp_get_wtime() - wtime) / repeat;
+		}
+
+		params.push_back(QVariantMap(std::map<QString, QVariant>({{"name", QVariant(engine_type + "+fmadd")}})));
+		params.push_back(QVariantMap(std::map<QString, QVariant>({{"name", QVariant(engine_type + "+fmaddn")}})));
+		params.push_back(QVariantMap(std::map<QString, QVariant>({{"name", QVariant(engine_type + "+fmaddn_inplace")}})));
+		result.push_back(row_fmadd);
+		result.push_back(row_fmaddn);
+		result.push_back(row_fmaddn_inplace);
+
+		engine->free_buffers(k);
+		engine->free_buffer(a);
+		delete engine;
+	}
+
+	std::cout << "%% stars_count = " << stars_count << std::endl;
+	print_table(params, term_counts, result, "name", QStringList() << "time", QStringList(), format);
+}
+
 int main(int argc, char* argv[])
 {
 	QCoreApplication	a(argc, argv);
@@ -525,6 +997,10 @@ int main(int argc, char* argv[])
 	{
 		bench_cpu(format);
 	}
+	else if(bench == "cpu_odd")
+	{
+		bench_cpu_odd(format);
+	}
 	else if(bench == "gpu")
 	{
 		bench_gpu(format);
@@ -541,6 +1017,10 @@ int main(int argc, char* argv[])
 	{
 		bench_solver(format);
 	}
+	else if(bench == "mixed_precision")
+	{
+		bench_mixed_precision(format);
+	}
 	else if(bench == "solver_quad")
 	{
 		bench_solver_quad(format);
@@ -549,6 +1029,22 @@ int main(int argc, char* argv[])
 	{
 		bench_cpu_tree(format);
 	}
+	else if(bench == "cpu_fmm")
+	{
+		bench_cpu_fmm(format);
+	}
+	else if(bench == "body_order")
+	{
+		bench_body_order(format);
+	}
+	else if(bench == "step_control")
+	{
+		bench_step_control(format);
+	}
+	else if(bench == "vector_ops")
+	{
+		bench_vector_ops(format, param);
+	}
 
 	return 0;
 }
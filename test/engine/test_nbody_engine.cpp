@@ -5,6 +5,7 @@
 #include <omp.h>
 
 #include "nbody_engines.h"
+#include "nbody_force_law.h"
 #include "nbody_space_heap_func.h"
 
 bool test_mem(nbody_engine* e)
@@ -454,36 +455,84 @@ bool test_fmaxabs(nbody_engine* e)
 	return ret;
 }
 
-bool test_fcompute(nbody_engine* e0, nbody_engine* e, nbody_data* data, const nbcoord_t eps)
+bool test_fdot(nbody_engine* e)
 {
-	std::vector<nbcoord_t>	f0(e0->problem_size());
+	std::vector<nbcoord_t>	a(e->problem_size());
+	std::vector<nbcoord_t>	b(e->problem_size());
 
+	if(a.empty())
 	{
-		double					tbegin = omp_get_wtime();
-		nbody_engine::memory*	fbuff;
-		fbuff = e0->create_buffer(sizeof(nbcoord_t) * e0->problem_size());
-		e0->fill_buffer(fbuff, 1e10);
-		e0->fcompute(0, e0->get_y(), fbuff);
-
-		e0->read_buffer(f0.data(), fbuff);
-		e0->free_buffer(fbuff);
-		qDebug() << "Time" << e0->type_name() << omp_get_wtime() - tbegin;
+		return false;
 	}
 
-	std::vector<nbcoord_t>	f(e->problem_size());
+	nbody_engine::memory*	mem_a = e->create_buffer(sizeof(nbcoord_t) * a.size());
+	nbody_engine::memory*	mem_b = e->create_buffer(sizeof(nbcoord_t) * b.size());
+	nbcoord_t				result = 2878767678687;//Garbage
+	nbcoord_t				testdot = 0;
 
+	for(size_t n = 0; n != a.size(); ++n)
 	{
-		double					tbegin = omp_get_wtime();
-		nbody_engine::memory*	fbuff;
-		fbuff = e->create_buffer(sizeof(nbcoord_t) * e->problem_size());
-		e->fill_buffer(fbuff, -1e10);
-		e->fcompute(0, e->get_y(), fbuff);
-
-		e->read_buffer(f.data(), fbuff);
-		e->free_buffer(fbuff);
-		qDebug() << "Time" << e->type_name() << omp_get_wtime() - tbegin;
+		a[n] = rand() % 10000 - 9000;
+		b[n] = rand() % 10000 - 9000;
+		testdot += a[n] * b[n];
 	}
 
+	e->write_buffer(mem_a, a.data());
+	e->write_buffer(mem_b, b.data());
+
+	//! @result = sum( a[k]*b[k], k=[0...asize) )
+	e->fdot(mem_a, mem_b, result);
+
+	// Integer products are summed exactly in any order
+	bool	ret = (result == testdot);
+
+	e->free_buffer(mem_a);
+	e->free_buffer(mem_b);
+
+	return ret;
+}
+
+/*!
+	Compute f for engine state y. If 'shift_dt' is not 0, f is computed second time at y + shift_dt * f,
+	so engines keeping data between fcompute calls (space trees etc.) are tested with moved bodies.
+ */
+void compute_f(nbody_engine* e, nbcoord_t fill_value, nbcoord_t shift_dt, std::vector<nbcoord_t>& f)
+{
+	double					tbegin = omp_get_wtime();
+	nbody_engine::memory*	fbuff;
+	fbuff = e->create_buffer(sizeof(nbcoord_t) * e->problem_size());
+	e->fill_buffer(fbuff, fill_value);
+	e->fcompute(0, e->get_y(), fbuff);
+
+	if(shift_dt != 0)
+	{
+		nbody_engine::memory*	ybuff;
+		ybuff = e->create_buffer(sizeof(nbcoord_t) * e->problem_size());
+		e->fmadd(ybuff, e->get_y(), fbuff, shift_dt);
+		e->fill_buffer(fbuff, fill_value);
+		e->fcompute(0, ybuff, fbuff);
+		e->free_buffer(ybuff);
+	}
+
+	f.resize(e->problem_size());
+	e->read_buffer(f.data(), fbuff);
+	e->free_buffer(fbuff);
+	qDebug() << "Time" << e->type_name() << omp_get_wtime() - tbegin;
+}
+
+/*!
+	Compare f of engines 'e0' and 'e'. With 'shift_dt' f is compared at moved state (see compute_f),
+	moved states of engines differ by rounding errors of f, so 'eps' is relative to max(1, |f|) there.
+ */
+bool test_fcompute(nbody_engine* e0, nbody_engine* e, nbody_data* data, const nbcoord_t eps,
+				   nbcoord_t shift_dt = 0)
+{
+	std::vector<nbcoord_t>	f0;
+	std::vector<nbcoord_t>	f;
+
+	compute_f(e0, 1e10, shift_dt, f0);
+	compute_f(e, -1e10, shift_dt, f);
+
 	bool		ret = true;
 	nbcoord_t	total_err = 0;
 	nbcoord_t	total_relative_err = 0;
@@ -494,7 +543,8 @@ bool test_fcompute(nbody_engine* e0, nbody_engine* e, nbody_data* data, const nb
 		total_err += fabs(f[i] - f0[i]);
 		total_relative_err += 2.0 * (fabs(f[i] - f0[i]) + err_smooth) /
 							  (fabs(f[i]) + fabs(f0[i]) + err_smooth);
-		if(fabs(f[i] - f0[i]) > eps)
+		const nbcoord_t	tolerance = (shift_dt == 0) ? eps : eps * std::max(static_cast<nbcoord_t>(1), fabs(f0[i]));
+		if(fabs(f[i] - f0[i]) > tolerance)
 		{
 			++outliers_count;
 			ret = false;
@@ -523,6 +573,132 @@ bool test_fcompute(nbody_engine* e, nbody_data* data, const nbcoord_t eps)
 	return test_fcompute(&e0, e, data, eps);
 }
 
+/*!
+	Accelerations of active bodies computed with fcompute_active must be equal to fcompute ones,
+	accelerations of other bodies must not be changed.
+ */
+bool test_fcompute_active(nbody_engine* e, const nbcoord_t eps)
+{
+	const nbcoord_t			fill_value = 1e10;
+	const size_t			count = e->problem_size() / 6;
+	std::vector<size_t>		active;
+	std::vector<nbcoord_t>	f0(3 * count);
+	std::vector<nbcoord_t>	f(3 * count);
+
+	for(size_t i = 0; i < count; i += 3)
+	{
+		active.push_back(i);
+	}
+
+	e->set_ode_order(eode_second_order);
+
+	nbody_engine::memory*	fbuff = e->create_buffer(sizeof(nbcoord_t) * 3 * count);
+	e->fcompute(0, e->get_y(), fbuff);
+	e->read_buffer(f0.data(), fbuff);
+	e->fill_buffer(fbuff, fill_value);
+	e->fcompute_active(0, e->get_y(), fbuff, active);
+	e->read_buffer(f.data(), fbuff);
+	e->free_buffer(fbuff);
+
+	e->set_ode_order(eode_first_order);
+
+	bool	ret = true;
+	for(size_t i = 0; i != count; ++i)
+	{
+		const bool	is_active = (i % 3 == 0);
+		for(size_t d = 0; d != 3; ++d)
+		{
+			const size_t	idx = i + d * count;
+			if(is_active ? (fabs(f[idx] - f0[idx]) > eps) : (f[idx] != fill_value))
+			{
+				ret = false;
+			}
+		}
+	}
+
+	return ret;
+}
+
+/*!
+	Accelerations computed with fcompute_with_jerk must be equal to fcompute ones,
+	jerks must be equal to direct sum ones computed by simple engine.
+ */
+bool test_fcompute_with_jerk(nbody_engine* e, nbody_data* data, const nbcoord_t eps)
+{
+	nbody_engine_simple		e0;
+	e0.init(data);
+
+	const size_t			size = e->problem_size() / 2;
+	std::vector<nbcoord_t>	f0(size);
+	std::vector<nbcoord_t>	f(size);
+	std::vector<nbcoord_t>	jerk0(size);
+	std::vector<nbcoord_t>	jerk(size);
+
+	e->set_ode_order(eode_second_order);
+
+	nbody_engine::memory*	fbuff = e->create_buffer(sizeof(nbcoord_t) * size);
+	nbody_engine::memory*	jbuff = e->create_buffer(sizeof(nbcoord_t) * size);
+	e->fcompute(0, e->get_y(), fbuff);
+	e->read_buffer(f0.data(), fbuff);
+	e->fcompute_with_jerk(0, e->get_y(), fbuff, jbuff);
+	e->read_buffer(f.data(), fbuff);
+	e->read_buffer(jerk.data(), jbuff);
+	e->free_buffer(fbuff);
+	e->free_buffer(jbuff);
+
+	e->set_ode_order(eode_first_order);
+
+	nbody_engine::memory*	f0buff = e0.create_buffer(sizeof(nbcoord_t) * size);
+	nbody_engine::memory*	j0buff = e0.create_buffer(sizeof(nbcoord_t) * size);
+	e0.fcompute_with_jerk(0, e0.get_y(), f0buff, j0buff);
+	e0.read_buffer(jerk0.data(), j0buff);
+	e0.free_buffer(f0buff);
+	e0.free_buffer(j0buff);
+
+	bool	ret = true;
+	for(size_t i = 0; i != size; ++i)
+	{
+		if(fabs(f[i] - f0[i]) > eps || fabs(jerk[i] - jerk0[i]) > eps)
+		{
+			ret = false;
+		}
+	}
+
+	return ret;
+}
+
+bool test_clone(nbody_engine* e, nbody_engine* clone, const nbcoord_t eps)
+{
+	const nbcoord_t	time = e->get_time();
+	bool			ret = true;
+
+	// Clone has private time and state
+	clone->set_time(time + 1);
+	ret = ret && (e->get_time() == time);
+
+	std::vector<nbcoord_t>	f0;
+	std::vector<nbcoord_t>	f;
+
+	compute_f(e, 1e10, 0, f0);
+	compute_f(clone, -1e10, 0, f);
+	for(size_t i = 0; i != f.size(); ++i)
+	{
+		if(fabs(f[i] - f0[i]) > eps)
+		{
+			ret = false;
+		}
+	}
+
+	std::vector<nbcoord_t>	y0(e->problem_size());
+	std::vector<nbcoord_t>	y(e->problem_size());
+	e->read_buffer(y0.data(), e->get_y());
+	clone->fill_buffer(clone->get_y(), 0);
+	e->read_buffer(y.data(), e->get_y());
+	ret = ret && (y == y0);
+
+	return ret;
+}
+
 class test_nbody_engine : public QObject
 {
 	Q_OBJECT
@@ -549,7 +725,11 @@ private slots:
 	void test_fmaddn3();
 	void test_fmaddn_corr();
 	void test_fmaxabs();
+	void test_fdot();
 	void test_fcompute();
+	void test_fcompute_active();
+	void test_fcompute_with_jerk();
+	void test_clone();
 	void test_negative_branches();
 };
 
@@ -643,6 +823,11 @@ void test_nbody_engine::test_fmaxabs()
 	QVERIFY(::test_fmaxabs(m_e));
 }
 
+void test_nbody_engine::test_fdot()
+{
+	QVERIFY(::test_fdot(m_e));
+}
+
 void test_nbody_engine::test_fcompute()
 {
 	QVERIFY(::test_fcompute(m_e, &m_data, m_eps));
@@ -650,6 +835,38 @@ void test_nbody_engine::test_fcompute()
 	QVERIFY(::test_fcompute(m_e, &m_data, m_eps));
 }
 
+void test_nbody_engine::test_fcompute_active()
+{
+	if(dynamic_cast<nbody_engine_simple*>(m_e) == nullptr)
+	{
+		qDebug() << "Skip" << m_e->type_name();
+		return;
+	}
+	QVERIFY(::test_fcompute_active(m_e, m_eps));
+}
+
+void test_nbody_engine::test_fcompute_with_jerk()
+{
+	if(dynamic_cast<nbody_engine_simple*>(m_e) == nullptr)
+	{
+		qDebug() << "Skip" << m_e->type_name();
+		return;
+	}
+	QVERIFY(::test_fcompute_with_jerk(m_e, &m_data, m_eps));
+}
+
+void test_nbody_engine::test_clone()
+{
+	nbody_engine*	clone = m_e->clone();
+	if(clone == nullptr)
+	{
+		qDebug() << "Skip" << m_e->type_name();
+		return;
+	}
+	QVERIFY(::test_clone(m_e, clone, m_eps));
+	delete clone;
+}
+
 class nbody_engine_memory_fake : public nbody_engine::memory
 {
 	size_t m_size;
@@ -890,20 +1107,25 @@ class test_nbody_engine_compare : public QObject
 	nbody_engine*	m_e2;
 	size_t			m_problem_size;
 	nbcoord_t		m_eps;
+	size_t			m_body_count;
 public:
-	test_nbody_engine_compare(nbody_engine* e1, nbody_engine* e2, size_t problen_size = 64, nbcoord_t eps = 1e-13);
+	//! @param body_count - if not 0, truncate generated universe to exactly 'body_count' bodies
+	test_nbody_engine_compare(nbody_engine* e1, nbody_engine* e2, size_t problen_size = 64, nbcoord_t eps = 1e-13,
+							  size_t body_count = 0);
 	~test_nbody_engine_compare();
 private slots:
 	void initTestCase();
 	void compare();
+	void compare_moved();
 };
 
 test_nbody_engine_compare::test_nbody_engine_compare(nbody_engine* e1, nbody_engine* e2,
-													 size_t problen_size, nbcoord_t eps) :
+													 size_t problen_size, nbcoord_t eps, size_t body_count) :
 	m_e1(e1),
 	m_e2(e2),
 	m_problem_size(problen_size),
-	m_eps(eps)
+	m_eps(eps),
+	m_body_count(body_count)
 {
 }
 
@@ -923,6 +1145,10 @@ void test_nbody_engine_compare::initTestCase()
 	qDebug() << "Engine2" << m_e2->type_name();
 	m_e2->print_info();
 	m_data.make_universe(m_problem_size, box_size, box_size, box_size);
+	if(m_body_count != 0)
+	{
+		m_data.resize(m_body_count);
+	}
 	m_e1->init(&m_data);
 	m_e2->init(&m_data);
 }
@@ -932,6 +1158,11 @@ void test_nbody_engine_compare::compare()
 	QVERIFY(::test_fcompute(m_e1, m_e2, &m_data, m_eps));
 }
 
+void test_nbody_engine_compare::compare_moved()
+{
+	QVERIFY(::test_fcompute(m_e1, m_e2, &m_data, m_eps, 1e-2));
+}
+
 class test_nbody_heap_func : public QObject
 {
 	Q_OBJECT
@@ -1011,6 +1242,103 @@ private slots:
 	}
 };
 
+/*!
+	Force law policies are checked with formulas, not with other engines
+ */
+class test_nbody_force_law : public QObject
+{
+	Q_OBJECT
+	//! Relative difference of law.derivative(r2) and central difference of law(r2)
+	template<class Law>
+	static nbcoord_t derivative_error(const Law& law, nbcoord_t r2)
+	{
+		const nbcoord_t	dr2 = r2 * 1e-5;
+		const nbcoord_t	d = (law(r2 + dr2) - law(r2 - dr2)) / (2 * dr2);
+		return fabs(d - law.derivative(r2)) / fabs(law.derivative(r2));
+	}
+	//! Mass of cubic spline kernel with radius h inside sphere of radius r
+	static nbcoord_t spline_mass(nbcoord_t h, nbcoord_t r)
+	{
+		// Simpson rule for 4*pi*Integral(W(s)*s^2, s=[0...r])
+		const nbcoord_t	pi = 3.14159265358979323846_f;
+		const size_t	steps = 1000;
+		const nbcoord_t	ds = r / steps;
+		nbcoord_t		sum = 0;
+		for(size_t i = 0; i <= steps; ++i)
+		{
+			const nbcoord_t	x = ds * static_cast<nbcoord_t>(i);
+			const nbcoord_t	u = x / h;
+			const nbcoord_t	w = (u < 0.5_f) ? (1 - 6 * u * u + 6 * u * u * u) : 2 * (1 - u) * (1 - u) * (1 - u);
+			const nbcoord_t	weight = (i == 0 || i == steps) ? 1 : ((i % 2 == 0) ? 2 : 4);
+			sum += weight * w * 8 / (pi * h * h * h) * x * x;
+		}
+		return 4 * pi * sum * ds / 3;
+	}
+
+public:
+	test_nbody_force_law() {}
+	~test_nbody_force_law() {}
+
+private slots:
+	void newton()
+	{
+		const nbody_force_newton	law;
+		const nbcoord_t				eps = 4 * std::numeric_limits<nbcoord_t>::epsilon();
+		for(nbcoord_t r = 0.125_f; r < 100; r *= 2)
+		{
+			QVERIFY(fabs(law(r * r) * r * r * r - 1) < eps);
+			QVERIFY(derivative_error(law, r * r) < 1e-8);
+		}
+		QCOMPARE(law(0), law(nbody::MinDistance));
+	}
+	void plummer()
+	{
+		const nbcoord_t				h = 0.5_f;
+		const nbody_force_plummer	law(h);
+		const nbcoord_t				eps = 4 * std::numeric_limits<nbcoord_t>::epsilon();
+		QVERIFY(fabs(law(0) * h * h * h - 1) < eps);
+		for(nbcoord_t r = 0.125_f; r < 100; r *= 2)
+		{
+			const nbcoord_t	s = sqrt(r * r + h * h);
+			QVERIFY(fabs(law(r * r) * s * s * s - 1) < eps);
+			QVERIFY(derivative_error(law, r * r) < 1e-8);
+		}
+		// Newton at r >> h, relative difference is about 1.5*(h/r)^2
+		const nbcoord_t	r = 1000 * h;
+		QVERIFY(fabs(law(r * r) * r * r * r - 1) < 2e-6);
+	}
+	void spline()
+	{
+		const nbcoord_t				h = 2;
+		const nbody_force_spline	law(h);
+		const nbody_force_newton	newton;
+		const nbcoord_t				eps = 4 * std::numeric_limits<nbcoord_t>::epsilon();
+		// Exactly Newton outside of kernel
+		for(nbcoord_t r = h; r < 100; r *= 1.5_f)
+		{
+			QVERIFY(fabs(law(r * r) - newton(r * r)) <= eps * newton(r * r));
+			QVERIFY(fabs(law.derivative(r * r) - newton.derivative(r * r)) <= eps * fabs(newton.derivative(r * r)));
+		}
+		// Force at r = 0 is finite, law(0) = 32/(3*h^3)
+		QVERIFY(fabs(law(0) * h * h * h * 3 / 32 - 1) < eps);
+		// Inside kernel law(r^2) = M(r)/r^3, M(r) is kernel mass inside r
+		for(nbcoord_t u = 0.05_f; u < 1; u += 0.1_f)
+		{
+			const nbcoord_t	r = u * h;
+			QVERIFY(fabs(law(r * r) * r * r * r / spline_mass(h, r) - 1) < 1e-10);
+			QVERIFY(derivative_error(law, r * r) < 1e-6);
+		}
+		// Continuous at branch points u = 0.5 and u = 1
+		const nbcoord_t	du = 1e-9_f;
+		for(nbcoord_t u : {0.5_f, 1.0_f})
+		{
+			const nbcoord_t	r1 = (u - du) * h;
+			const nbcoord_t	r2 = (u + du) * h;
+			QVERIFY(fabs(law(r1 * r1) - law(r2 * r2)) < 1e-7 * law(r2 * r2));
+		}
+	}
+};
+
 int main(int argc, char* argv[])
 {
 	int res = 0;
@@ -1026,7 +1354,8 @@ int main(int argc, char* argv[])
 	}
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"engine", "ah"},
-			{"full_recompute_rate", 5}, {"max_dist", 7}, {"min_force", 1e-6}
+			{"full_recompute_rate", 5}, {"max_dist", 7}, {"min_force", 1e-6},
+			{"verlet_skin", 1}
 		}));
 		test_nbody_engine	tc1(nbody_create_engine(param));
 		res += QTest::qExec(&tc1, argc, argv);
@@ -1130,18 +1459,150 @@ int main(int argc, char* argv[])
 	}
 #endif // HAVE_OPENCL
 
+	{
+		// Only P2P interactions between leaf buckets
+		QVariantMap param(std::map<QString, QVariant>({{"engine", "fmm"},
+			{"distance_to_node_radius_ratio", 1e8}
+		}));
+		test_nbody_engine tc1(nbody_create_engine(param), 128, 1e-11);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		// Body counts not divisible by leaf size and not power of 2
+		const size_t	body_count[] = {1, 63, 65, 1000};
+		for(size_t n = 0; n != sizeof(body_count) / sizeof(body_count[0]); ++n)
+		{
+			QVariantMap param1(std::map<QString, QVariant>({{"engine", "fmm"},
+				{"distance_to_node_radius_ratio", 1e8}, {"leaf_size", 8}
+			}));
+			QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple"}}));
+			test_nbody_engine_compare tc1(nbody_create_engine(param1),
+										  nbody_create_engine(param2),
+										  1024, 1e-12, body_count[n]);
+			res += QTest::qExec(&tc1, argc, argv);
+		}
+	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "fmm"},
+			{"fmm_order", 6}, {"distance_to_node_radius_ratio", 3}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  1024, 1e-5);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap		param(std::map<QString, QVariant>({{"engine", "fmm"}, {"fmm_order", 0}}));
+		nbody_engine*	e(nbody_create_engine(param));
+		if(e != NULL)
+		{
+			qDebug() << "Created engine with invalid fmm_order" << param;
+			res += 1;
+			delete e;
+		}
+	}
+
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"engine", "openmp"}}));
 		test_nbody_engine	tc1(nbody_create_engine(param));
 		res += QTest::qExec(&tc1, argc, argv);
 	}
 
+	{
+		// Body counts not divisible by NBODY_DATA_BLOCK_SIZE
+		const size_t	body_count[] = {1, 63, 65, 1000};
+		for(size_t n = 0; n != sizeof(body_count) / sizeof(body_count[0]); ++n)
+		{
+			QVariantMap param1(std::map<QString, QVariant>({{"engine", "block"}}));
+			QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple"}}));
+			test_nbody_engine_compare tc1(nbody_create_engine(param1),
+										  nbody_create_engine(param2),
+										  1024, 1e-12, body_count[n]);
+			res += QTest::qExec(&tc1, argc, argv);
+		}
+	}
+
+	{
+		const char*	engine[] = {"block", "openmp"};
+		for(size_t n = 0; n != sizeof(engine) / sizeof(engine[0]); ++n)
+		{
+			QVariantMap param1(std::map<QString, QVariant>({{"engine", engine[n]}, {"mixed_precision", 1}}));
+			QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+			test_nbody_engine_compare tc1(nbody_create_engine(param1),
+										  nbody_create_engine(param2),
+										  1024, 1e-3);
+			res += QTest::qExec(&tc1, argc, argv);
+		}
+	}
+
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"engine", "simd"}}));
+		test_nbody_engine	tc1(nbody_create_engine(param));
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+
+	{
+		const char*	isa[] = {"scalar", "sse2", "avx2", "avx512"};
+		for(size_t n = 0; n != sizeof(isa) / sizeof(isa[0]); ++n)
+		{
+			QVariantMap param1(std::map<QString, QVariant>({{"engine", "simd"}, {"simd_isa", isa[n]}}));
+			QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+			test_nbody_engine_compare tc1(nbody_create_engine(param1),
+										  nbody_create_engine(param2),
+										  1024, 1e-13);
+			res += QTest::qExec(&tc1, argc, argv);
+		}
+	}
+
+	{
+		QVariantMap		param(std::map<QString, QVariant>({{"engine", "simd"}, {"simd_isa", "mmx"}}));
+		nbody_engine*	e(nbody_create_engine(param));
+		if(e != NULL)
+		{
+			qDebug() << "Created engine with invalid simd_isa" << param;
+			res += 1;
+			delete e;
+		}
+	}
+
+	{
+		QVariantMap		param(std::map<QString, QVariant>({{"engine", "block"}, {"body_order", "peano"}}));
+		nbody_engine*	e(nbody_create_engine(param));
+		if(e != NULL)
+		{
+			qDebug() << "Created engine with invalid body_order" << param;
+			res += 1;
+			delete e;
+		}
+	}
+
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"engine", "simple"}}));
 		test_nbody_engine	tc1(nbody_create_engine(param));
 		res += QTest::qExec(&tc1, argc, argv);
 	}
 
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"engine", "tiled"}}));
+		test_nbody_engine	tc1(nbody_create_engine(param));
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+
+	{
+		// Several tiles with partial last tile
+		const size_t	body_count[] = {63, 65, 1000};
+		for(size_t n = 0; n != sizeof(body_count) / sizeof(body_count[0]); ++n)
+		{
+			QVariantMap param1(std::map<QString, QVariant>({{"engine", "tiled"}, {"tile_size", 32}}));
+			QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple"}}));
+			test_nbody_engine_compare tc1(nbody_create_engine(param1),
+										  nbody_create_engine(param2),
+										  1024, 1e-12, body_count[n]);
+			res += QTest::qExec(&tc1, argc, argv);
+		}
+	}
+
 	{
 		QVariantMap param(std::map<QString, QVariant>({{"engine", "simple_bh"},
 			{"distance_to_node_radius_ratio", 1e8},
@@ -1178,6 +1639,42 @@ int main(int argc, char* argv[])
 		test_nbody_engine tc1(nbody_create_engine(param), 128, 1e-11);
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 1e8},
+			{"traverse_type", "cycle"},
+			{"tree_layout", "tree"},
+			{"tree_rebuild_rate", 0}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 1e8},
+			{"traverse_type", "cycle"},
+			{"tree_layout", "tree"},
+			{"tree_rebuild_rate", 100}
+		}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  512, 1e-11);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 1e8},
+			{"traverse_type", "nested_tree"},
+			{"tree_layout", "heap"},
+			{"tree_rebuild_rate", 0}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 1e8},
+			{"traverse_type", "nested_tree"},
+			{"tree_layout", "heap"},
+			{"tree_rebuild_rate", 100}
+		}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  512, 1e-11);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	{
 		QVariantMap param(std::map<QString, QVariant>({{"engine", "simple_bh"},
 			{"distance_to_node_radius_ratio", 3.1623},
@@ -1276,6 +1773,101 @@ int main(int argc, char* argv[])
 									  1024, 1e-16);
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 3.1623},
+			{"traverse_type", "cycle"},
+			{"tree_layout", "tree"},
+			{"multipole_order", 2}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 3.1623},
+			{"traverse_type", "nested_tree"},
+			{"tree_layout", "heap_stackless"},
+			{"multipole_order", 2}
+		}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  1024, 1e-14);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		// Quadrupole moments at ratio 4 are more accurate than mass centers only (~5e-5)
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 4},
+			{"traverse_type", "cycle"},
+			{"tree_layout", "heap"},
+			{"multipole_order", 2}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  1024, 1e-5);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		// Direct sum over opened leaves, body counts not divisible by bucket size
+		const size_t	body_count[] = {1, 63, 65, 1000};
+		const char*		tree_layout[] = {"tree", "heap", "heap_stackless"};
+		for(size_t n = 0; n != sizeof(body_count) / sizeof(body_count[0]); ++n)
+		{
+			for(size_t l = 0; l != sizeof(tree_layout) / sizeof(tree_layout[0]); ++l)
+			{
+				QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+					{"distance_to_node_radius_ratio", 1e8},
+					{"traverse_type", "group"},
+					{"tree_layout", tree_layout[l]},
+					{"bucket_size", 16}
+				}));
+				QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+				test_nbody_engine_compare tc1(nbody_create_engine(param1),
+											  nbody_create_engine(param2),
+											  1024, 1e-12, body_count[n]);
+				res += QTest::qExec(&tc1, argc, argv);
+			}
+		}
+	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 3.1623},
+			{"traverse_type", "group"},
+			{"tree_layout", "tree"},
+			{"multipole_order", 2}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 3.1623},
+			{"traverse_type", "group"},
+			{"tree_layout", "heap"},
+			{"multipole_order", 2}
+		}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  1024, 1e-14);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		// Bucket box criterion is not weaker than per-body one (~5e-5 for 'cycle' traverse)
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
+			{"distance_to_node_radius_ratio", 3.1623},
+			{"traverse_type", "group"},
+			{"tree_layout", "heap"}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "block"}}));
+		test_nbody_engine_compare tc1(nbody_create_engine(param1),
+									  nbody_create_engine(param2),
+									  1024, 5e-5);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap		param(std::map<QString, QVariant>({{"engine", "simple_bh"}, {"multipole_order", 1}}));
+		nbody_engine*	e(nbody_create_engine(param));
+		if(e != NULL)
+		{
+			qDebug() << "Created engine with invalid multipole_order" << param;
+			res += 1;
+			delete e;
+		}
+	}
 #ifdef HAVE_CUDA
 	{
 		QVariantMap param1(std::map<QString, QVariant>({{"engine", "simple_bh"},
@@ -1400,10 +1992,61 @@ int main(int argc, char* argv[])
 			delete e2;
 		}
 	}
+	{
+		// Softened force laws of all CPU engines that support them
+		const char*	softening[] = {"plummer", "spline"};
+		for(size_t n = 0; n != sizeof(softening) / sizeof(softening[0]); ++n)
+		{
+			QVariantMap	param0(std::map<QString, QVariant>({{"engine", "simple"},
+				{"softening", softening[n]}, {"softening_length", 5}
+			}));
+			std::vector<QVariantMap>	params(3, param0);
+			params[0]["engine"] = "openmp";
+			params[1]["engine"] = "ah";
+			// All bodies are neighbours, so moved bodies are computed exactly without full recompute
+			params[1]["max_dist"] = 1e3;
+			params[2]["engine"] = "simple_bh";
+			params[2]["distance_to_node_radius_ratio"] = 1e8;
+			params[2]["traverse_type"] = "group";
+			for(size_t i = 0; i != params.size(); ++i)
+			{
+				test_nbody_engine_compare tc1(nbody_create_engine(params[i]),
+											  nbody_create_engine(param0),
+											  128, 1e-12);
+				res += QTest::qExec(&tc1, argc, argv);
+			}
+		}
+	}
+	{
+		QVariantMap param1(std::map<QString, QVariant>({{"engine", "block"},
+			{"softening", "plummer"}, {"softening_length", 1}
+		}));
+		QVariantMap param2(std::map<QString, QVariant>({{"engine", "openmp"},
+			{"softening", "invalid"}
+		}));
+		nbody_engine*	e1(nbody_create_engine(param1));
+		if(e1 != NULL)
+		{
+			qDebug() << "Created engine with unsupported softening" << param1;
+			res += 1;
+			delete e1;
+		}
+		nbody_engine*	e2(nbody_create_engine(param2));
+		if(e2 != NULL)
+		{
+			qDebug() << "Created engine with invalid softening" << param2;
+			res += 1;
+			delete e2;
+		}
+	}
 	{
 		test_nbody_heap_func	tc1;
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		test_nbody_force_law	tc1;
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	return res;
 }
 
@@ -123,6 +123,27 @@ void bench_solver(const QString& format,
 		{"expected_state", expected_state},
 		{"min_step", "-1"}
 	}));
+	QVariantMap param08a(std::map<QString, QVariant>(
+	{
+		{"name", "bs16-deuflhard"},
+		{"engine", engine},
+		{"solver", "bs"},
+		{"max_level", 16},
+		{"order_control", "deuflhard"},
+		{"error_threshold", 1e-14},
+		{"initial_state", initial_state},
+		{"expected_state", expected_state}
+	}));
+	QVariantMap param08b(std::map<QString, QVariant>(
+	{
+		{"name", "abm12"},
+		{"engine", engine},
+		{"solver", "abm"},
+		{"max_order", 12},
+		{"error_threshold", 1e-14},
+		{"initial_state", initial_state},
+		{"expected_state", expected_state}
+	}));
 	QVariantMap param09(std::map<QString, QVariant>(
 	{
 		{"name", "rkdverk-fixed-step"},
@@ -183,9 +204,19 @@ void bench_solver(const QString& format,
 		{"expected_state", expected_state},
 		{"min_step", "-1"}
 	}));
+	QVariantMap param15(std::map<QString, QVariant>(
+	{
+		{"name", "wisdom-holman"},
+		{"engine", engine},
+		{"solver", "wisdom-holman"},
+		{"initial_state", initial_state},
+		{"expected_state", expected_state},
+		{"min_step", "-1"}
+	}));
 
-	std::vector<QVariantMap>				params = {param01};//, param02, param03, param04, param05a, param05b, param06, param07, param08, param09, param10, param11, param12, param13, param14};
+	std::vector<QVariantMap>				params = {param01};//, param02, param03, param04, param05a, param05b, param06, param07, param08, param08a, param08b, param09, param10, param11, param12, param13, param14, param15};
 //	std::vector<QVariantMap>				params = {param12, param13, param14};
+//	std::vector<QVariantMap>				params = {param08a, param09, param15};
 	std::vector<QVariant>					steps = {1.0};//, 16.0, 4.0, 1.0, 1.0 / 4.0, 1.0 / 16.0, 1.0 / 64.0};//, 1.0 / 256.0};
 	QString									variable_field = "max_step";
 	std::vector<std::vector<QVariantMap>>	result(params.size(), std::vector<QVariantMap>(steps.size()));
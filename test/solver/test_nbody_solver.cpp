@@ -23,6 +23,8 @@ private Q_SLOTS:
 	void cleanupTestCase();
 	void run();
 	void butcher_table_check();
+private:
+	void rkn_table_check(const nbody_butcher_table_rkn* table);
 };
 
 test_nbody_solver::test_nbody_solver(const QString& apppath, nbody_engine* _e,
@@ -92,7 +94,11 @@ void test_nbody_solver::butcher_table_check()
 		return;
 	}
 	const nbody_butcher_table*	table = rk_butcher->table();
-	QVERIFY(table != nullptr);
+	if(table == nullptr)
+	{
+		rkn_table_check(rk_butcher->rkn_table());
+		return;
+	}
 
 	nbcoord_t	b1 = 0_f;
 	nbcoord_t	b2 = 0_f;
@@ -128,8 +134,222 @@ void test_nbody_solver::butcher_table_check()
 	}
 }
 
+void test_nbody_solver::rkn_table_check(const nbody_butcher_table_rkn* table)
+{
+	QVERIFY(table != nullptr);
+
+	nbcoord_t	b1 = 0_f;
+	nbcoord_t	b2 = 0_f;
+	nbcoord_t	bv1 = 0_f;
+	nbcoord_t	bv2 = 0_f;
+	for(size_t i = 0; i != table->get_steps(); ++i)
+	{
+		b1 += table->get_b1()[i];
+		b2 += table->get_b2()[i];
+		bv1 += table->get_bv1()[i];
+		bv2 += table->get_bv2()[i];
+	}
+	nbcoord_t	eps(10 * std::numeric_limits<nbcoord_t>::epsilon());
+	qDebug() << "(b1 - 1/2) =" << b1 - 0.5_f << "(b2 - 1/2) =" << b2 - 0.5_f << "eps =" << eps;
+	qDebug() << "(bv1 - 1) =" << bv1 - 1_f << "(bv2 - 1) =" << bv2 - 1_f << "eps =" << eps;
+	QVERIFY(fabs(b1 - 0.5_f) < eps);
+	QVERIFY(fabs(b2 - 0.5_f) < eps);
+	QVERIFY(fabs(bv1 - 1_f) < eps);
+	QVERIFY(fabs(bv2 - 1_f) < eps);
+
+	for(size_t i = 0; i != table->get_steps(); ++i)
+	{
+		nbcoord_t	a_absmax = 0_f;
+		nbcoord_t	a_sum = 0_f;
+		nbcoord_t	a_corr = 0_f;
+		nbcoord_t	c = table->get_c()[i];
+		size_t		jmax = (table->is_implicit() ? table->get_steps() : i);
+		if(jmax == 0) { a_absmax = 1_f; }
+		for(size_t j = 0; j != jmax; ++j)
+		{
+			nbcoord_t a = table->get_a()[i][j];
+			a_sum = summation_k(a_sum, a, a_corr);
+			a_absmax = std::max(a_absmax, static_cast<nbcoord_t>(fabs(a)));
+		}
+		qDebug() << i << "Sum{a[i]} =" << a_sum << "c = " << c
+				 << "(Sum{a[i]} - c[i]^2/2) =" << (a_sum - c * c / 2)
+				 << "eps =" << eps << "max(|a|) =" << a_absmax;
+		QVERIFY(fabs(a_sum - c * c / 2) / a_absmax < eps);
+	}
+}
+
+class test_nbody_solver_accuracy : public QObject
+{
+	Q_OBJECT
+	QString			m_apppath;
+	nbody_data		m_expected;
+public:
+	explicit test_nbody_solver_accuracy(const QString& apppath);
+private Q_SLOTS:
+	void initTestCase();
+	void step_control();
+	void step_control_last_step();
+	void implicit_tolerance();
+private:
+	nbody_data solve(const QVariantMap& param, nbcoord_t min_step, nbcoord_t max_step,
+					 size_t* compute_count = NULL) const;
+};
+
+namespace {
+const nbcoord_t	accuracy_max_time = 0.3;
+
+nbcoord_t max_difference(const nbody_data& a, const nbody_data& b)
+{
+	nbcoord_t	diff = 0;
+	for(size_t n = 0; n != a.get_count(); ++n)
+	{
+		diff = std::max(diff, (a.get_vertites()[n] - b.get_vertites()[n]).length());
+		diff = std::max(diff, (a.get_velosites()[n] - b.get_velosites()[n]).length());
+	}
+	return diff;
+}
+}// namespace
+
+test_nbody_solver_accuracy::test_nbody_solver_accuracy(const QString& apppath) :
+	m_apppath(QFileInfo(apppath).absolutePath())
+{
+}
+
+nbody_data test_nbody_solver_accuracy::solve(const QVariantMap& param, nbcoord_t min_step, nbcoord_t max_step,
+											 size_t* compute_count) const
+{
+	QVariantMap		eparam(std::map<QString, QVariant>({{"engine", "simple"}}));
+	nbody_data		data;
+	nbody_engine*	e = nbody_create_engine(eparam);
+	nbody_solver*	s = nbody_create_solver(param);
+
+	if(!data.load(m_apppath + "/../data/initial_state.txt") || e == NULL || s == NULL)
+	{
+		delete s;
+		delete e;
+		return nbody_data();
+	}
+
+	e->init(&data);
+	s->set_time_step(min_step, max_step);
+	s->set_engine(e);
+	s->run(&data, NULL, accuracy_max_time, 0, 0);
+	e->get_data(&data);
+	if(compute_count != NULL)
+	{
+		*compute_count = e->get_compute_count();
+	}
+	qDebug() << param << "time" << e->get_time() << "compute count" << e->get_compute_count();
+
+	delete s;
+	delete e;
+	return data;
+}
+
+void test_nbody_solver_accuracy::initTestCase()
+{
+	// Fixed step 14th order solution is exact up to rounding
+	QVariantMap	param(std::map<QString, QVariant>({{"solver", "rkfeagin14"}, {"max_recursion", 0}}));
+	m_expected = solve(param, 1e-3, 1e-3);
+	QVERIFY(m_expected.get_count() > 0);
+}
+
+void test_nbody_solver_accuracy::step_control()
+{
+	for(int order = 1; order <= 2; ++order)
+	{
+		nbcoord_t	error[2] = {};
+		size_t		compute_count[2] = {};
+		nbcoord_t	threshold[2] = {1e-8, 1e-11};
+		for(size_t i = 0; i != 2; ++i)
+		{
+			QVariantMap	param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"step_control", "pi"},
+				{"error_threshold", threshold[i]}, {"ode_order", order}
+			}));
+			nbody_data	data(solve(param, 1e-9, accuracy_max_time, compute_count + i));
+			QCOMPARE(data.get_count(), m_expected.get_count());
+			error[i] = max_difference(data, m_expected);
+			qDebug() << "ODE order" << order << "error_threshold" << threshold[i] << "error" << error[i];
+		}
+		// Tolerance is relative to coordinates of order 100, global error follows tolerance
+		// and tighter tolerance takes more steps
+		QVERIFY(error[0] < 1e3 * threshold[0]);
+		QVERIFY(error[1] < 1e3 * threshold[1]);
+		QVERIFY(error[0] / error[1] > 100);
+		QVERIFY(compute_count[1] > compute_count[0]);
+	}
+}
+
+void test_nbody_solver_accuracy::step_control_last_step()
+{
+	// Step can not be shortened below min_step, so it is accepted with any error
+	const QVariantMap	params[] =
+	{
+		QVariantMap(std::map<QString, QVariant>({{"solver", "rkdp"}, {"step_control", "pi"},
+			{"error_threshold", 1e-10}
+		})),
+		QVariantMap(std::map<QString, QVariant>({{"solver", "bs"}, {"order_control", "deuflhard"},
+			{"max_level", 3}, {"error_threshold", 1e-15}
+		})),
+		QVariantMap(std::map<QString, QVariant>({{"solver", "abm"}, {"error_threshold", 1e-8}}))
+	};
+	for(const QVariantMap& param : params)
+	{
+		nbody_data	data(solve(param, 0.05, 0.05));
+		QCOMPARE(data.get_count(), m_expected.get_count());
+		QVERIFY(max_difference(data, m_expected) < 1e-2);
+	}
+}
+
+void test_nbody_solver_accuracy::implicit_tolerance()
+{
+	// Fixed sweeps count large enough to converge, runs with tolerance use default sweeps limit
+	QVariantMap	converged_param(std::map<QString, QVariant>({{"solver", "rkgl"}, {"refine_steps_count", 64}}));
+	size_t		converged_count = 0;
+	nbody_data	converged(solve(converged_param, 1e-3, 3e-2, &converged_count));
+	QCOMPARE(converged.get_count(), m_expected.get_count());
+
+	for(int depth : {0, 3})
+	{
+		QVariantMap	param(std::map<QString, QVariant>({{"solver", "rkgl"}, {"implicit_tolerance", 1e-13},
+			{"anderson_depth", depth}
+		}));
+		size_t		compute_count = 0;
+		nbody_data	data(solve(param, 1e-3, 3e-2, &compute_count));
+		QCOMPARE(data.get_count(), m_expected.get_count());
+		const nbcoord_t	error = max_difference(data, converged);
+		qDebug() << "anderson_depth" << depth << "difference with converged" << error;
+		QVERIFY(error < 1e-10);
+		QVERIFY(compute_count < converged_count);
+	}
+}
+
 typedef nbody_engine_simple	nbody_engine_active;
 
+namespace {
+//! Run must fail and keep engine's time, 1 if it does not
+int run_unsupported_engine(const QVariantMap& eparam, const QVariantMap& param)
+{
+	nbody_data		data;
+	nbody_engine*	e(nbody_create_engine(eparam));
+	nbody_solver*	s(nbody_create_solver(param));
+	int				res = 0;
+
+	data.make_universe(8, 100, 100, 100);
+	e->init(&data);
+	s->set_time_step(1e-2, 1e-2);
+	s->set_engine(e);
+	if(s->run(&data, NULL, 0.1, 0, 0) == 0 || e->get_time() != 0)
+	{
+		qDebug() << "Solver run with unsupported engine" << param << eparam;
+		res = 1;
+	}
+	delete s;
+	delete e;
+	return res;
+}
+}// namespace
+
 int main(int argc, char* argv[])
 {
 	int res = 0;
@@ -154,6 +374,102 @@ int main(int argc, char* argv[])
 			delete s;
 		}
 	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"ode_order", 3}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created solver with invalid ODE order" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"ode_order", 2}, {"correction", true}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created second order solver with correction" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"step_control", "invalid"}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created solver with invalid step control" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "bs"}, {"order_control", "invalid"}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created solver with invalid order control" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "abm"}, {"max_order", 0}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created solver with invalid max order" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkn64"}, {"ode_order", 1}}));
+		nbody_solver*		s(nbody_create_solver(param));
+		if(s != NULL)
+		{
+			qDebug() << "Created Runge-Kutta-Nystrom solver for first order ODE" << param;
+			res += 1;
+			delete s;
+		}
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "simple"},
+			{"softening", "plummer"}, {"softening_length", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "wisdom-holman"}}));
+		res += run_unsupported_engine(eparam, param);
+	}
+#ifdef HAVE_CUDA
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "cuda"}}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "wisdom-holman"}}));
+		res += run_unsupported_engine(eparam, param);
+	}
+#endif // HAVE_CUDA
+#ifdef HAVE_OPENCL
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "opencl"}}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "wisdom-holman"}}));
+		res += run_unsupported_engine(eparam, param);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "opencl"}}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "leapfrog"}}));
+		res += run_unsupported_engine(eparam, param);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "opencl"}}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"ode_order", 2}}));
+		res += run_unsupported_engine(eparam, param);
+	}
+#endif // HAVE_OPENCL
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "abm"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "abm");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"solver", "adams"}, {"rank", 5}}));
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "adams5");
@@ -164,6 +480,11 @@ int main(int argc, char* argv[])
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "adams5-corr");
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "block-step"}, {"eta", 0.001}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "block-step");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"solver", "bs"}, {"max_level", 4}, {"min_step", 1e-5}}));
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "bulirsch-stoer");
@@ -174,6 +495,21 @@ int main(int argc, char* argv[])
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "euler");
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "forest-ruth"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "forest-ruth");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "hermite"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "hermite");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "leapfrog"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "leapfrog");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"solver", "midpoint"}}));
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "midpoint");
@@ -244,11 +580,102 @@ int main(int argc, char* argv[])
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "rklc");
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkn4"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "rkn4");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkn64"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "rkn64");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	{
 		QVariantMap			param(std::map<QString, QVariant>({{"solver", "trapeze"}, {"refine_steps_count", 2}}));
 		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "trapeze2");
 		res += QTest::qExec(&tc1, argc, argv);
 	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "wisdom-holman"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "wisdom-holman");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "yoshida4"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "yoshida4");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "yoshida6"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "yoshida6");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "yoshida8"}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "yoshida8");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "simple"},
+			{"body_order", "hilbert"}, {"reorder_rate", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "adams"}, {"rank", 5}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "adams5");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "simple"},
+			{"body_order", "morton"}, {"reorder_rate", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "rkdp");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "openmp"},
+			{"body_order", "morton"}, {"reorder_rate", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "leapfrog"}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "leapfrog");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "openmp"},
+			{"body_order", "morton"}, {"reorder_rate", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "block-step"}, {"eta", 0.001}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "block-step");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "block"}}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "hermite"}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "hermite");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	// Explicit methods give the same result for second order ODE
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdp"}, {"ode_order", 2}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "rkdp");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkfeagin10"}, {"ode_order", 2}}));
+		test_nbody_solver	tc1(argv[0], new nbody_engine_active(), nbody_create_solver(param), "rkfeagin10");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		QVariantMap			eparam(std::map<QString, QVariant>({{"engine", "openmp"},
+			{"body_order", "morton"}, {"reorder_rate", 1}
+		}));
+		QVariantMap			param(std::map<QString, QVariant>({{"solver", "rkdverk"}, {"ode_order", 2}}));
+		test_nbody_solver	tc1(argv[0], nbody_create_engine(eparam), nbody_create_solver(param), "rkdverk");
+		res += QTest::qExec(&tc1, argc, argv);
+	}
+	{
+		test_nbody_solver_accuracy	tc1(argv[0]);
+		res += QTest::qExec(&tc1, argc, argv);
+	}
 	return res;
 }
 
@@ -25,6 +25,8 @@ private Q_SLOTS:
 	void initTestCase();
 	void cleanupTestCase();
 	void run();
+	void run_dense_output();
+	void dense_output_accuracy();
 	void negative_branch();
 };
 
@@ -132,6 +134,129 @@ void test_nbody_stream::run()
 	}
 }
 
+void test_nbody_stream::run_dense_output()
+{
+	nbody_data			data;
+	nbody_engine_simple	engine;
+	nbody_solver_rkdp	solver;
+	nbody_data_stream	stream;
+
+	data.make_universe(64, 100, 100, 100);
+	engine.init(&data);
+	solver.set_time_step(0.1, 0.1);
+	solver.set_engine(&engine);
+
+	QVERIFY(solver.has_dense_output());
+	//Dump step is less than solver step, frames are interpolated within steps
+	QVERIFY(0 == stream.open(m_tmp + "/stream-test/dense", 1 << 30));
+	QVERIFY(0 == solver.run(&data, &stream, 0.2, 0.05, 0));
+	stream.close();
+
+	nbody_data_stream_reader	reader;
+	nbody_data					frame, expected;
+
+	frame.resize(data.get_count());
+	expected = data;
+	engine.get_data(&expected);
+
+	QVERIFY(0 == reader.load(m_tmp + "/stream-test/dense"));
+	QVERIFY(5 == reader.get_frame_count());
+	QVERIFY(fabs(reader.get_max_time() - 0.2) < 1e-12);
+
+	QVERIFY(0 == reader.seek(1));
+	QVERIFY(0 == reader.read(&frame));
+	QVERIFY(0.05 == frame.get_time());
+	QVERIFY(!frame.is_equal(expected, 1e-12));
+
+	//Continuous extension at the end of step is the step result
+	QVERIFY(0 == reader.seek(reader.get_frame_count() - 1));
+	QVERIFY(0 == reader.read(&frame));
+	QVERIFY(frame.is_equal(expected, 1e-12));
+}
+
+namespace {
+//! Max coordinate and velocity difference of bodies
+nbcoord_t max_difference(const nbody_data& a, const nbody_data& b)
+{
+	nbcoord_t	diff = 0;
+	for(size_t n = 0; n != a.get_count(); ++n)
+	{
+		diff = std::max(diff, (a.get_vertites()[n] - b.get_vertites()[n]).length());
+		diff = std::max(diff, (a.get_velosites()[n] - b.get_velosites()[n]).length());
+	}
+	return diff;
+}
+
+/*!
+	Max difference of frames interpolated within steps 'step' and frames of direct integration
+	with step 'step/4', both are dumped with step 'step/4'
+ */
+nbcoord_t dense_output_error(const QString& path, nbcoord_t step)
+{
+	const nbcoord_t	max_time = 2 * step;
+	const nbcoord_t	dump_step = step / 4;
+	const QString	names[2] = {path + "-dense", path + "-direct"};
+	const nbcoord_t	steps[2] = {step, dump_step};
+	nbody_data		initial;
+
+	initial.make_universe(64, 100, 100, 100);
+	for(size_t i = 0; i != 2; ++i)
+	{
+		nbody_data			data(initial);
+		nbody_engine_simple	engine;
+		nbody_solver_rkdp	solver;
+		nbody_data_stream	stream;
+
+		engine.init(&data);
+		// Fixed step, there is no subdivision when step is equal to min_step
+		solver.set_time_step(steps[i], steps[i]);
+		solver.set_engine(&engine);
+		if(0 != stream.open(names[i], 1 << 30) ||
+		   0 != solver.run(&data, &stream, max_time, dump_step, 0))
+		{
+			return -1;
+		}
+		stream.close();
+	}
+
+	nbody_data_stream_reader	readers[2];
+	nbody_data					frames[2];
+	nbcoord_t					error = 0;
+	for(size_t i = 0; i != 2; ++i)
+	{
+		frames[i].resize(initial.get_count());
+		if(0 != readers[i].load(names[i]) || 9 != readers[i].get_frame_count())
+		{
+			return -1;
+		}
+	}
+	for(size_t frame = 0; frame != readers[0].get_frame_count(); ++frame)
+	{
+		if(0 != readers[0].read(&frames[0]) || 0 != readers[1].read(&frames[1]) ||
+		   fabs(frames[0].get_time() - frames[1].get_time()) > 1e-12)
+		{
+			return -1;
+		}
+		error = std::max(error, max_difference(frames[0], frames[1]));
+	}
+	return error;
+}
+}// namespace
+
+void test_nbody_stream::dense_output_accuracy()
+{
+	// Continuous extension is third order, so error of interpolated frames decreases as step^4.
+	// Steps are powers of 2, so frame times of both runs are exact.
+	const nbcoord_t	step = 0.0625;
+	const nbcoord_t	error1 = dense_output_error(m_tmp + "/stream-test/accuracy1", step);
+	const nbcoord_t	error2 = dense_output_error(m_tmp + "/stream-test/accuracy2", step / 2);
+
+	qDebug() << "Dense output error" << error1 << "with step" << step << "and" << error2 << "with step" << step / 2;
+	QVERIFY(error1 > 0 && error2 > 0);
+	QVERIFY(error1 < 1e-4);
+	QVERIFY(error1 / error2 > 12);
+}
+
 void test_nbody_stream::negative_branch()
 {
 	{
@@ -345,10 +470,10 @@ void test_nbody_data_io::save_load()
 {
 	nbody_data	data1;
 	QVERIFY(data1.load(m_apppath + "/../data/initial_state.txt"));
-	QVERIFY(data1.save(m_apppath + "/../data/test_save.txt"));
+	QVERIFY(data1.save(QDir::tempPath() + "/test_save.txt"));
 
 	nbody_data	data2;
-	QVERIFY(data2.load(m_apppath + "/../data/test_save.txt"));
+	QVERIFY(data2.load(QDir::tempPath() + "/test_save.txt"));
 	QVERIFY(data2.is_equal(data1, 1e-16));
 }
 